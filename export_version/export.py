@@ -8,6 +8,11 @@ import itertools
 import argparse
 import signal
 import subprocess
+import json
+import hashlib
+import re
+import random
+import shlex
 import os
 import sys
 
@@ -115,10 +120,160 @@ parser.add_argument(
     help=
     "set to store output function in specialized template class. If specified template name will be \"func\" and memory sort will be \"sort\" and vec will be \"sort_vec\". The default template name will be \"vsort\""
 )
+parser.add_argument(
+    "--mca",
+    action="store_true",
+    default=False,
+    help=
+    "set to output an llvm-mca static throughput report for the generated kernel instead of the kernel itself"
+)
+parser.add_argument(
+    "--mca-cpus",
+    action="store",
+    default="",
+    help=
+    "comma separated list of -mcpu targets for the \"mca\" report. The default is whichever of skylake-avx512, icelake-server and znver3 implement the kernel's instruction sets. Targets known not to implement them are skipped"
+)
+parser.add_argument(
+    "--llvm-mca",
+    action="store",
+    default="llvm-mca",
+    help=
+    "Set executable path for llvm-mca, default will use whats in your PATH")
+parser.add_argument(
+    "--compiler",
+    action="store",
+    default="g++",
+    help=
+    "Set compiler used to build the kernel for the \"mca\" report, default will use whats in your PATH"
+)
+parser.add_argument(
+    "--bulk",
+    action="store",
+    nargs="?",
+    const="",
+    default=None,
+    help=
+    "set to generate every kernel into one output with a dispatcher keyed by N for each type. \"T\" can be a comma separated list of types and \"N\" a comma separated list of sizes / ranges (i.e \"4-16,32\"). Optionally takes a file where each line is a set of flags (N, T, algorithm, optimization, extra-memory, int-aligned, aligned, constraint, uarch, payload-type, vertical, name) to export"
+)
+parser.add_argument(
+    "--cache",
+    action="store",
+    default="",
+    help=
+    "set file to keep transformed networks and instruction selections in between runs. It is ignored if export.py or the machine's instruction sets have changed"
+)
+parser.add_argument(
+    "--payload-type",
+    action="store",
+    default="",
+    help=
+    "set to generate key / value kernels that apply every exchange to a second array of this type (same size as the sorted type). \"index\" generates argsort kernels that write the original index of each sorted element"
+)
+parser.add_argument(
+    "--vertical",
+    action="store_true",
+    default=False,
+    help=
+    "set to generate kernels that sort W arrays of N at once (W is the number of lanes of the largest register). Arrays are contiguous, each is transposed into one lane of N registers so the network is only min / max"
+)
+parser.add_argument(
+    "--batch",
+    action="store",
+    nargs="?",
+    type=int,
+    const=2,
+    default=0,
+    help=
+    "set to also generate \"<name>_batch(T * base, size_t count, size_t stride)\" which sorts count arrays stride elements apart. Optionally takes the number of arrays sorted together per iteration (default 2)"
+)
+parser.add_argument(
+    "--asm",
+    action="store",
+    nargs="?",
+    const="att",
+    default="",
+    help=
+    "set to also compile the kernel(s) into a standalone assembly file next to \"outfile\" (same name with a .S extension). Either \"att\" (default) or \"intel\" syntax. Entry points are extern \"C\" with the same signature as the memory sort / dispatcher"
+)
+parser.add_argument(
+    "--asm-align",
+    action="store",
+    type=int,
+    default=0,
+    help=
+    "set alignment in bytes of the functions / loop heads in the \"asm\" output. Default keeps what the compiler emitted"
+)
+parser.add_argument(
+    "--no-vzeroupper",
+    action="store_false",
+    default=True,
+    help=
+    "set to not emit vzeroupper before returning from the \"asm\" output. Only safe if the caller never runs legacy SSE code with dirty upper halves"
+)
+parser.add_argument(
+    "--verify",
+    action="store_true",
+    default=False,
+    help=
+    "set to check each kernel before it is written: its network on every 0-1 input (random 0-1 inputs past 24 elements) and the generated code by interpreting it on 0-1 and random inputs. Errors if either doesn't sort"
+)
+parser.add_argument(
+    "--search",
+    action="store",
+    nargs="?",
+    type=int,
+    const=200,
+    default=0,
+    help=
+    "set to instead search for a network for N (up to 24) that is cheap for the selected instructions (lane crossing permutes, blends, depth) and output it as a minimum_network<N> specialization. Optionally takes the number of iterations (default 200)"
+)
+parser.add_argument(
+    "--bias-unsigned",
+    action="store_true",
+    default=False,
+    help=
+    "set to sort uint64_t without AVX512 min / max as int64_t: the sign bit of every key is flipped once after the load and once before the store instead of in every compare"
+)
+parser.add_argument(
+    "--no-zmm",
+    action="store_true",
+    default=False,
+    help=
+    "set to never use zmm registers (AVX512 instructions are still used on xmm / ymm registers). N that doesn't fit a ymm register is sorted in multiple ymm registers. Avoids the frequency drop of 512 bit instructions for code that sorts occasionally"
+)
+parser.add_argument(
+    "--const-table",
+    action="store_true",
+    default=False,
+    help=
+    "set to load the constant vectors (permute / blend / mask control) of each output function from one aligned table instead of building each with _mm*_set_epi*"
+)
+parser.add_argument(
+    "--uarch",
+    action="store",
+    default="",
+    help=
+    "set microarchitecture cost model used for instruction selection and \"best\". Either one of the tables in uarch/ (skx, icl, zen3, zen4) or a path to a table in the same format. Default uses the hand assigned instruction weights"
+)
+
+
+class Speculative_Error(Exception):
+    pass
+
+
+# raised instead of exiting while a kernel of a "bulk" run is generated
+# so one (T, N) that can't be generated doesn't abort the whole run
+class Kernel_Error(Exception):
+    pass
 
 
 def err_assert(check, msg):
     if check is False:
+        if SPECULATIVE is True:
+            raise Speculative_Error(msg)
+        if BULK_KERNEL is True:
+            raise Kernel_Error(msg)
         print("Error: " + msg)
         traceback.print_stack()
         exit(-1)
@@ -142,6 +297,22 @@ EXTRA_MEMORY = False
 DO_FORMAT = False
 CLANG_FORMAT_EXE = ""
 USER_TYPE = None
+UARCH = None
+SPECULATIVE = False
+BULK_KERNEL = False
+MCA_CPUS = []
+LLVM_MCA_EXE = ""
+COMPILER_EXE = ""
+PAYLOAD = ""
+ASM_SYNTAX = ""
+ASM_ALIGN = 0
+ASM_VZEROUPPER = True
+BATCH = 0
+VERTICAL = False
+VERIFY = False
+BIAS_UNSIGNED = False
+NO_ZMM = False
+CONST_TABLE = False
 
 MIN_MAX_COUNT = 0
 
@@ -203,6 +374,7 @@ class Headers():
         self.xmmintrin = False
         self.immintrin = False
         self.stdint = True
+        self.stddef = False
 
     def reset(self):
         self.aliasing_m64 = False
@@ -210,8 +382,28 @@ class Headers():
         self.xmmintrin = False
         self.immintrin = False
         self.stdint = True
-
-    def get_headers(self, sort_type):
+        self.stddef = False
+
+    def merge(self, other):
+        self.aliasing_m64 = self.aliasing_m64 or other.aliasing_m64
+        self.aliasing_int16 = self.aliasing_int16 or other.aliasing_int16
+        self.xmmintrin = self.xmmintrin or other.xmmintrin
+        self.immintrin = self.immintrin or other.immintrin
+        self.stdint = self.stdint or other.stdint
+        self.stddef = self.stddef or other.stddef
+
+    def m64_alignment(self, sort_type):
+        if ALIGNED_ACCESS is True:
+            return 8
+        return sort_type.sizeof()
+
+    def int16_alignment(self, sort_type):
+        alignment = sort_type.sizeof()
+        if ALIGNED_ACCESS is True:
+            alignment = max(alignment, 2)
+        return alignment
+
+    def get_includes(self):
         ret = ""
         if self.xmmintrin is True:
             ret += "#include <xmmintrin.h>"
@@ -222,27 +414,235 @@ class Headers():
         if self.stdint is True:
             ret += "#include <stdint.h>"
             ret += "\n"
+        if self.stddef is True:
+            ret += "#include <stddef.h>"
+            ret += "\n"
         ret += "\n"
+        return ret
 
+    def get_typedefs(self, m64_alignment, int16_alignment):
+        ret = ""
         if self.aliasing_m64 is True:
-            alignment = sort_type.sizeof()
-            if ALIGNED_ACCESS is True:
-                alignment = 8
             ret += "typedef __m64 _aliasing_m64_ __attribute__((aligned({}), may_alias));".format(
-                alignment)
+                m64_alignment)
             ret += "\n"
         if self.aliasing_int16 is True:
-            alignment = sort_type.sizeof()
-            if ALIGNED_ACCESS is True:
-                alignment = max(alignment, 2)
             ret += "typedef uint16_t _aliasing_int16_t_ __attribute__((aligned({}), may_alias));".format(
-                alignment)
+                int16_alignment)
             ret += "\n"
         return ret
 
+    def get_headers(self, sort_type):
+        return self.get_includes() + self.get_typedefs(
+            self.m64_alignment(sort_type), self.int16_alignment(sort_type))
+
 
 header = Headers()
 
+######################################################################
+# Cost Model
+
+# Optional replacement for the hand assigned instruction weights. A
+# table (see uarch/*.json) gives latency, reciprocal throughput, uops
+# and ports for each intrinsic family per register width.
+#
+# The latency of a generated instruction is the longest chain of
+# dependent intrinsics in it (a call waits for its arguments,
+# temporaries carry the latency of their value). set*() constants are
+# hoisted out of the dependency chain. Candidates with the same
+# latency are ordered by their summed reciprocal throughput.
+#
+# A kernel's estimate is the larger of its dependency depth (the
+# compare exchanges are chained, registers of multi register sorts
+# run in parallel) and its port pressure: the uops of every intrinsic
+# in the kernel are spread evenly over the ports that can execute them
+# and the busiest port bounds the cycles. Table entries without ports
+# share one unit.
+######################################################################
+
+UARCH_DIR = os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                         "uarch")
+
+
+class Uarch_Table():
+    def __init__(self, uarch):
+        path = uarch
+        if os.path.isfile(path) is False:
+            path = os.path.join(UARCH_DIR, "{}.json".format(uarch.lower()))
+        err_assert(
+            os.path.isfile(path),
+            "No microarchitecture table for \"{}\" (have: {})".format(
+                uarch, arr_to_csv(self.available())))
+
+        try:
+            with open(path) as f:
+                raw_table = f.read()
+            table = json.loads(raw_table)
+        except (IOError, ValueError):
+            err_assert(False, "Error reading uarch table: {}".format(path))
+
+        self.digest = hashlib.sha1(raw_table.encode()).hexdigest()
+
+        self.name = table["name"]
+        self.columns = table["columns"]
+        self.excluded = table["excluded"]
+        self.default = self.to_entry(table["default"])
+        self.instructions = table["instructions"]
+
+        self.intrinsic_re = re.compile(r"(_mm(?:256|512)?)_([a-z0-9_]+)\(")
+        self.epi_re = re.compile(r"_(epi|epu|pi|pu|si|ps)[0-9x]*$")
+        self.call_re = re.compile(r"(_mm(?:256|512)?)_([a-z0-9_]+)\s*\(")
+        self.tmp_re = re.compile(r"\[([A-Za-z0-9_]+)\]")
+        self.assign_re = re.compile(r"^[^=\[]*\[([A-Za-z0-9_]+)\]\s*=\s*(.*)$",
+                                    re.DOTALL)
+        self.ports_re = re.compile(r"^(?:([0-9]+)\*)?([A-Za-z]+)([0-9]*)$")
+
+    def available(self):
+        if os.path.isdir(UARCH_DIR) is False:
+            return []
+        return sorted(
+            [f[:-len(".json")] for f in os.listdir(UARCH_DIR) if f.endswith(".json")])
+
+    # instruction sets the microarchitecture doesn't implement, matched
+    # the same way as the "constraint" flag
+    def excludes(self, field):
+        for e in self.excluded:
+            if e in field:
+                return True
+        return False
+
+    def to_entry(self, values):
+        return dict(zip(self.columns, values))
+
+    def width(self, prefix, op):
+        if prefix == "_mm512":
+            return "zmm"
+        elif prefix == "_mm256":
+            return "ymm"
+        elif self.epi_re.search(op) is not None and (
+                op.endswith("si64") or "_pi" in op or "_pu" in op):
+            return "mmx"
+        return "xmm"
+
+    def lookup(self, prefix, op):
+        width = self.width(prefix, op)
+        keys = [op, self.epi_re.sub("_*", op)]
+        for key in keys:
+            if key in self.instructions and width in self.instructions[key]:
+                return self.to_entry(self.instructions[key][width])
+        return self.default
+
+    # returns (dependency depth, summed reciprocal throughput)
+    def cost(self, instruction_str):
+        throughput = 0.0
+        for prefix, op in self.intrinsic_re.findall(instruction_str):
+            if op.startswith("cast") is False:
+                throughput += self.lookup(prefix, op)["throughput"]
+        return self.depth(instruction_str), throughput
+
+    # longest latency chain through the statements of code
+    def depth(self, code):
+        tmps = {}
+        depth = 0
+        for statement in code.split(";"):
+            m = self.assign_re.match(statement.strip())
+            if m is not None:
+                tmps[m.group(1)] = self.expr_depth(m.group(2), 0, tmps)[0]
+                depth = max(depth, tmps[m.group(1)])
+            else:
+                depth = max(depth, self.expr_depth(statement, 0, tmps)[0])
+        return depth
+
+    # returns (max depth of the terms in expr[pos:] up to the closing
+    # ')', position after it)
+    def expr_depth(self, expr, pos, tmps):
+        depth = 0
+        while pos < len(expr):
+            if expr[pos] == ")":
+                return depth, pos + 1
+
+            m = self.call_re.match(expr, pos)
+            if m is not None:
+                args_depth, pos = self.expr_depth(expr, m.end(), tmps)
+                prefix, op = m.group(1), m.group(2)
+                if op.startswith("set"):
+                    continue
+                if op.startswith("cast") is False:
+                    args_depth += self.lookup(prefix, op)["latency"]
+                depth = max(depth, args_depth)
+                continue
+
+            m = self.tmp_re.match(expr, pos)
+            if m is not None:
+                depth = max(depth, tmps.get(m.group(1), 0))
+                pos = m.end()
+            elif expr[pos] == "(":
+                group_depth, pos = self.expr_depth(expr, pos + 1, tmps)
+                depth = max(depth, group_depth)
+            else:
+                pos += 1
+        return depth, pos
+
+    # [(ports, uops)] for an entry. "2*p5+p015" is 2 uops on port 5
+    # and 1 on any of ports 0, 1, 5. "FP12" is all of the entry's uops
+    # on FP1 / FP2.
+    def port_uops(self, entry):
+        if entry["ports"] == "":
+            return [(["?"], entry["uops"])]
+        terms = []
+        for term in entry["ports"].split("+"):
+            m = self.ports_re.match(term)
+            err_assert(m is not None,
+                       "Invalid ports in uarch table: {}".format(term))
+            count = 1 if m.group(1) is None else int(m.group(1))
+            ports = [m.group(2) + d for d in m.group(3)]
+            if len(ports) == 0:
+                ports = [m.group(2)]
+            terms.append((ports, count))
+        total = sum([count for _, count in terms])
+        return [(ports, entry["uops"] * count / total)
+                for ports, count in terms]
+
+    # uops on the busiest port for all the intrinsics in code
+    def port_pressure(self, code):
+        pressure = {}
+        for prefix, op in self.intrinsic_re.findall(code):
+            if op.startswith("cast"):
+                continue
+            for ports, uops in self.port_uops(self.lookup(prefix, op)):
+                for port in ports:
+                    pressure[port] = pressure.get(port, 0.0) + uops / len(ports)
+        return max(pressure.values(), default=0.0)
+
+
+# generate_instruction() is not free of side effects (MIN_MAX_COUNT and
+# header flags) so they are restored after costing a candidate. Some
+# candidates pass match() but can't actually be generated, those are
+# given infinite cost.
+def uarch_cost(instruction):
+    global MIN_MAX_COUNT
+    global SPECULATIVE
+    saved_min_max_count = MIN_MAX_COUNT
+    saved_header = copy.copy(header.__dict__)
+
+    SPECULATIVE = True
+    try:
+        latency, throughput = UARCH.cost(instruction.generate_instruction())
+    except Speculative_Error:
+        latency, throughput = float("inf"), float("inf")
+    SPECULATIVE = False
+
+    MIN_MAX_COUNT = saved_min_max_count
+    header.__dict__.update(saved_header)
+    return latency, throughput
+
+
+def instruction_latency(instruction):
+    if UARCH is None:
+        return 0
+    return uarch_cost(instruction)[0]
+
+
 ######################################################################
 # Instruction Generation
 ######################################################################
@@ -250,7 +650,7 @@ header = Headers()
 
 class SIMD_Constraints():
     def __init__(self, constraints):
-        self.constraints = copy.deepcopy(constraints)
+        self.constraints = list(constraints)
 
     def has_support(self):
         for field in self.constraints:
@@ -260,6 +660,8 @@ class SIMD_Constraints():
                 return False
             if SIMD_RESTRICTIONS != "" and SIMD_RESTRICTIONS in field:
                 return False
+            if UARCH is not None and UARCH.excludes(field):
+                return False
         return True
 
 
@@ -340,7 +742,7 @@ class SIMD_m512():
         return 64
 
     def has_support(self):
-        return self.SIMD_constraints.has_support()
+        return NO_ZMM is False and self.SIMD_constraints.has_support()
 
 
 def get_simd_type(sort_bytes):
@@ -439,6 +841,25 @@ class Sort_Type():
         err_assert(False, "was unable to find match")
 
 
+# Type of the payload array ("payload-type") or None. For argsort it
+# is the unsigned type of the same size as the sort type.
+def get_payload_type(sort_type):
+    if PAYLOAD == "":
+        return None
+    if PAYLOAD == "index":
+        return Sort_Type(sort_type.sizeof(), Sign.UNSIGNED)
+
+    err_assert(
+        Sort_Type(1, Sign.SIGNED).is_valid(PAYLOAD) is True,
+        "\"payload-type\" must be a sort type or \"index\"")
+    payload_type = Sort_Type(1, Sign.SIGNED).string_to_T(PAYLOAD)
+    err_assert(
+        payload_type.sizeof() == sort_type.sizeof(),
+        "\"payload-type\" {} is not the same size as {}".format(
+            payload_type.to_string(), sort_type.to_string()))
+    return payload_type
+
+
 class Match_Info():
     def __init__(self, sort_type, simd_type, aligned=None, full=None):
         self.simd_type = simd_type
@@ -766,7 +1187,7 @@ class SIMD_Max_Blend(SIMD_Instruction):
         super().__init__(iname, sign, T_size, simd_type, constraints,
                          weight)
         self.is_blending = False
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
         if is_2 is False and is_mask_blend is True and is_avx512 is True:
             self.is_blending = True
 
@@ -908,7 +1329,7 @@ class SIMD_Max():
                              SIMD_m512(), ["AVX512f"], 1),
             SIMD_Instruction("_mm512_max_epi64([V1], [V2])", Sign.SIGNED, 8,
                              SIMD_m512(), ["AVX512f"], 1),
-            SIMD_Instruction("_mm512_mask_max_epu64([V1], [V2])", Sign.UNSIGNED, 8,
+            SIMD_Instruction("_mm512_max_epu64([V1], [V2])", Sign.UNSIGNED, 8,
                              SIMD_m512(), ["AVX512f"], 1),
 
             SIMD_Max_Blend("_mm512_mask_max_epi8([V0], [BLEND_MASK], [V1], [V2])",
@@ -940,6 +1361,44 @@ class SIMD_Max():
         ]
 
 
+######################################################################
+# Unsigned Bias
+
+# Without AVX512 there is no epu64 min / max and the fallback flips the
+# sign bit of both operands before every compare. With --bias-unsigned
+# such kernels flip the sign bit of every key once after the load and
+# once before the store and sort as int64_t in between (x ^ 2^63
+# orders as signed the same way x orders as unsigned). Loads / stores
+# keep the unsigned type so the max fill is still the largest key.
+######################################################################
+
+
+# Type the compare exchanges are selected for
+def compare_type(sort_type, simd_type):
+    if BIAS_UNSIGNED is False or sort_type.sign != Sign.UNSIGNED or sort_type.sizeof(
+    ) != 8:
+        return sort_type
+
+    SIMD_min = [
+        op for op in SIMD_Min().instructions
+        if op.match(Match_Info(sort_type, simd_type)) is True
+    ]
+    if len(SIMD_min) == 0 or isinstance(best_instruction(SIMD_min),
+                                        SIMD_Min_Fallback_u64) is False:
+        return sort_type
+    return Sort_Type(8, Sign.SIGNED)
+
+
+def bias_instruction(simd_type):
+    constraints = ["SSE2"]
+    if simd_type.sizeof() == 32:
+        constraints = ["AVX", "AVX2"]
+    return SIMD_Instruction(
+        "{}_xor_{}([V], {}_set1_epi64x((1UL) << 63))".format(
+            simd_type.prefix(), simd_type.postfix(), simd_type.prefix()),
+        Sign.UNSIGNED, 8, simd_type, constraints, 0)
+
+
 ######################################################################
 # Blend
 
@@ -1013,7 +1472,7 @@ class SIMD_Blend_Generator(SIMD_Instruction):
                          constraints, weight)
 
         self.T_target = T_target
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
         self.is_mask_blend = False
         for c in constraints:
             if "AVX512" in c:
@@ -1072,7 +1531,7 @@ class SIMD_Blend_As_Epi16_Generator(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -1127,7 +1586,7 @@ class SIMD_Blend_As_Epi8_Generator(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def blend_vec(self):
         N = len(self.perm)
@@ -1172,7 +1631,7 @@ class SIMD_Blend_m64_Generator(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def blend_mask(self):
         N = len(self.perm)
@@ -1446,7 +1905,7 @@ class SIMD_Shuffle_As_Epi64(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -1488,7 +1947,7 @@ class SIMD_Shuffle_As_si128(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -1526,8 +1985,8 @@ class SIMD_Shuffle2_As_PS(SIMD_Instruction):
                          weight)
 
         self.shuf_mask = int(-1)
-        self.perm = copy.deepcopy(perm)
-        self.prev_perm = copy.deepcopy(prev_perm)
+        self.perm = list(perm)
+        self.prev_perm = list(prev_perm)
         self.vargs = ["", ""]
 
     def carry_over(self):
@@ -1621,7 +2080,7 @@ class SIMD_Shuffle_As_Epi32(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -1667,7 +2126,7 @@ class SIMD_Shuffle_As_Epi16(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
         self.adjusted_weight = False
 
     def match(self, match_info):
@@ -1748,7 +2207,7 @@ class SIMD_Shuffle_As_Epi8(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -1777,8 +2236,8 @@ class SIMD_Alignr_1_or_2(SIMD_Instruction):
                          weight)
         self.perm_2x_bias = perm_2x_bias
         self.weight = weight
-        self.prev_perm = copy.deepcopy(prev_perm)
-        self.perm = copy.deepcopy(perm)
+        self.prev_perm = list(prev_perm)
+        self.perm = list(perm)
         self.shift_width = None
         self.adjusted_weight = False
         self.ll = False
@@ -1862,7 +2321,7 @@ class SIMD_rotate(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
         self.use_vec = False
         self.distances = None
         self.group_size = None
@@ -1912,7 +2371,7 @@ class SIMD_rotate(SIMD_Instruction):
                     self.weight += 1
 
         self.group_size = group_size
-        self.distances = copy.deepcopy(distances)
+        self.distances = list(distances)
         return True
 
     def build_rotate_tail(self):
@@ -1942,7 +2401,7 @@ class SIMD_Shuffle_Rotate(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
         self.smask = None
         self.r_ins = ""
         self.adjusted_weight = False
@@ -2045,8 +2504,8 @@ class SIMD_Permute_Move_Lanes_Shuffle_1_or_2(SIMD_Instruction):
         self.perm_2x_bias = perm_2x_bias
         self.tmp_vargs = ["", ""]
         self.vargs = ["", ""]
-        self.prev_perm = copy.deepcopy(prev_perm)
-        self.perm = copy.deepcopy(perm)
+        self.prev_perm = list(prev_perm)
+        self.perm = list(perm)
         self.to_use = None
         self.perm_mask = None
         self.instruction_base = ""
@@ -2356,7 +2815,7 @@ class SIMD_Permutex_Fallback(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def build_lanes_vec(self, cross_lane):
         lane_size = 16
@@ -2414,7 +2873,7 @@ class SIMD_Shuffle_m64(SIMD_Instruction):
         super().__init__("Override Error: " + self.__class__.__name__,
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def match(self, match_info):
         return self.has_support() and self.match_sort_type(
@@ -2440,7 +2899,7 @@ class SIMD_Permutex_Generate(SIMD_Instruction):
     def __init__(self, iname, T_size, perm, simd_type, constraints, weight):
         super().__init__(iname, Sign.NOT_SIGNED, T_size, simd_type,
                          constraints, weight)
-        self.perm = copy.deepcopy(perm)
+        self.perm = list(perm)
 
     def generate_instruction(self):
         return self.iname.replace("[PERM_LIST]", arr_to_csv(self.perm))
@@ -2453,8 +2912,8 @@ class SIMD_Shuffle2_Blend(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
-        self.prev_perm = copy.deepcopy(prev_perm)
+        self.perm = list(perm)
+        self.prev_perm = list(prev_perm)
 
         self.vargs = ["", ""]
 
@@ -2541,8 +3000,8 @@ class SIMD_Permutex2_Blend(SIMD_Instruction):
                          Sign.NOT_SIGNED, T_size, simd_type, constraints,
                          weight)
 
-        self.perm = copy.deepcopy(perm)
-        self.prev_perm = copy.deepcopy(prev_perm)
+        self.perm = list(perm)
+        self.prev_perm = list(prev_perm)
 
         self.using_T_size = self.T_size
 
@@ -2854,6 +3313,86 @@ class SIMD_Permute():
         ]
 
 
+######################################################################
+# Payload
+
+# Key / value and argsort kernels carry a second register through
+# every compare exchange. The payload is permuted with the same
+# instruction as the keys, then a lane keeps its own payload if its
+# key didn't change and takes the permuted payload if it did. So the
+# keys keep the min / max / blend that was selected for them and the
+# payload costs one compare and one blend. With equal keys neither
+# lane changes so the pairing of keys and payloads is never broken.
+#
+# [K0] is the new keys, [K1] the old keys, [P0] the permuted payload
+# and [P1] the old payload.
+######################################################################
+class SIMD_Payload_Select():
+    def __init__(self):
+        self.instructions = []
+
+        ###################################################################
+        for T_size in [1, 2, 4]:
+            self.instructions.append(
+                SIMD_Instruction(
+                    "__m64 [TMP0] = _mm_cmpeq_pi{}([K0], [K1]);\n_mm_or_si64(_mm_and_si64([TMP0], [P1]), _mm_andnot_si64([TMP0], [P0]))"
+                    .format(8 * T_size), Sign.NOT_SIGNED, T_size, SIMD_m64(),
+                    ["MMX"], 0))
+
+        ###################################################################
+        for T_size in [1, 2, 4, 8]:
+            bits = 8 * T_size
+            mask_constraints = ["AVX512vl", "AVX512f"]
+            if T_size < 4:
+                mask_constraints = ["AVX512vl", "AVX512bw"]
+            cmpeq_constraints = ["SSE2"]
+            if T_size == 8:
+                cmpeq_constraints = ["SSE4.1"]
+
+            self.instructions += [
+                SIMD_Instruction(
+                    "_mm_mask_blend_epi{0}(_mm_cmpeq_epi{0}_mask([K0], [K1]), [P0], [P1])"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m128(),
+                    mask_constraints, 0),
+                SIMD_Instruction(
+                    "_mm_blendv_epi8([P0], [P1], _mm_cmpeq_epi{}([K0], [K1]))"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m128(),
+                    ["SSE4.1"], 1),
+                SIMD_Instruction(
+                    "__m128i [TMP0] = _mm_cmpeq_epi{}([K0], [K1]);\n_mm_or_si128(_mm_and_si128([TMP0], [P1]), _mm_andnot_si128([TMP0], [P0]))"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m128(),
+                    cmpeq_constraints, 2),
+                ###############################################################
+                SIMD_Instruction(
+                    "_mm256_mask_blend_epi{0}(_mm256_cmpeq_epi{0}_mask([K0], [K1]), [P0], [P1])"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m256(),
+                    mask_constraints, 0),
+                SIMD_Instruction(
+                    "_mm256_blendv_epi8([P0], [P1], _mm256_cmpeq_epi{}([K0], [K1]))"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m256(),
+                    ["AVX2"], 1),
+                ###############################################################
+                SIMD_Instruction(
+                    "_mm512_mask_blend_epi{0}(_mm512_cmpeq_epi{0}_mask([K0], [K1]), [P0], [P1])"
+                    .format(bits), Sign.NOT_SIGNED, T_size, SIMD_m512(),
+                    mask_constraints[1:], 0)
+            ]
+
+
+def get_index_set_vec(sort_type, simd_type):
+    indexes = list(range(int(simd_type.sizeof() / sort_type.sizeof()) - 1,
+                         -1, -1))
+    if simd_type.sizeof() == 8:
+        return "_mm_set_pi{}({})".format(sort_type.sizeof_bits(),
+                                        arr_to_csv(indexes, False))
+
+    epi_postfix = str(sort_type.sizeof_bits())
+    if simd_type.sizeof() != 64 and sort_type.sizeof() == 8:
+        epi_postfix += "x"
+    return "{}_set_epi{}({})".format(simd_type.prefix(), epi_postfix,
+                                     arr_to_csv(indexes, False))
+
+
 ######################################################################
 # Load & Store Shared Helper(s)
 def build_mask_bool_vec_epi32(alignment_incr, raw_N, sort_type, simd_type):
@@ -3900,6 +4439,11 @@ def instruction_filter(instructions,
 
 
 def best_instruction(instructions):
+    if UARCH is not None:
+        # hand weights only break ties between equal cost candidates
+        return min(instructions,
+                   key=lambda i: uarch_cost(i) + (i.weight, ))
+
     min_weight = instructions[0].weight
     min_idx = 0
     for i in range(1, len(instructions)):
@@ -3910,6 +4454,89 @@ def best_instruction(instructions):
     return instructions[min_idx]
 
 
+######################################################################
+# Caching
+
+# --bulk builds many kernels (and "best" builds every candidate for
+# each of them). Transformed networks and the instructions selected
+# for a compare exchange only depend on their inputs so they are
+# cached under a hash of those inputs; networks by their pairs, not by
+# which algorithm made them. Instruction choices that bumped
+# MIN_MAX_COUNT embed unique temporary names and are not cached.
+#
+# With --cache the tables are also kept in a json file. The file is
+# only used if it was written by the same export.py on a machine with
+# the same instruction sets.
+######################################################################
+
+
+class Export_Cache():
+    def __init__(self):
+        self.path = ""
+        self.dirty = False
+        self.version = self.get_version()
+        self.tables = {"network": {}, "cas": {}}
+
+    def get_version(self):
+        version = hashlib.sha1()
+        with open(os.path.realpath(__file__), "rb") as f:
+            version.update(f.read())
+        version.update(
+            repr(sorted(cpufeature.CPUFeature.items(),
+                        key=lambda f: f[0])).encode())
+        return version.hexdigest()
+
+    def key(self, *fields):
+        return hashlib.sha1(repr(fields).encode()).hexdigest()
+
+    def get(self, table, key):
+        return self.tables[table].get(key)
+
+    def put(self, table, key, value):
+        self.tables[table][key] = value
+        self.dirty = True
+
+    def load(self, path):
+        self.path = path
+        if os.path.isfile(path) is False:
+            return
+        try:
+            with open(path) as f:
+                saved = json.load(f)
+        except (IOError, ValueError):
+            return
+        if saved.get("version") != self.version:
+            return
+        for table in self.tables:
+            self.tables[table].update(saved.get(table, {}))
+
+    def save(self):
+        if self.path == "" or self.dirty is False:
+            return
+        saved = {"version": self.version}
+        saved.update(self.tables)
+        tmp_path = self.path + ".tmp"
+        try:
+            with open(tmp_path, "w") as f:
+                json.dump(saved, f)
+            os.replace(tmp_path, self.path)
+        except IOError:
+            err_assert(False, "Error writing \"cache\": {}".format(self.path))
+        self.dirty = False
+
+
+cache = Export_Cache()
+
+
+# Globals that change which instruction is selected for a permutation
+def constraints_key():
+    uarch_digest = None
+    if UARCH is not None:
+        uarch_digest = UARCH.digest
+    return (INSTRUCTION_OPT.name, SIMD_RESTRICTIONS, uarch_digest,
+            PAYLOAD != "")
+
+
 ######################################################################
 # Compare Exchange
 
@@ -4055,6 +4682,102 @@ class Output_Formatter():
         return fmt_output
 
 
+######################################################################
+# Constant Tables
+
+# With --const-table every _mm*_set_epi* of integer literals in a
+# function is replaced by an aligned load from one static table at the
+# top of the function. Widest vectors come first so each entry is
+# aligned to its own width and the vectors of a network are contiguous
+# in .rodata (instead of one pool entry per vector wherever the
+# compiler puts them). Identical vectors share an entry.
+CONST_SET_RE = re.compile(r"(_mm(?:256|512)?)_set_epi(8|16|32|64x?)\(([^()]*)\)")
+CONST_LITERAL_RE = re.compile(r"^-?(0[xX][0-9a-fA-F]+|[0-9]+)[uUlL]*$")
+CONST_TABLE_NAME = "constants"
+
+
+def const_vec_bytes(prefix, elem_bits, args):
+    width = {"_mm": 16, "_mm256": 32, "_mm512": 64}[prefix]
+    args = [a.strip() for a in args.split(",")]
+    if len(args) * elem_bits != 8 * width:
+        return None
+    for a in args:
+        if CONST_LITERAL_RE.match(a) is None:
+            return None
+
+    # set_epi* takes the last lane first
+    raw = b""
+    for a in reversed(args):
+        v = int(a.rstrip("uUlL"), 0) & ((1 << elem_bits) - 1)
+        raw += v.to_bytes(int(elem_bits / 8), "little")
+    return raw
+
+
+def const_vec_load(prefix, offset):
+    ptr = "({} + {})".format(CONST_TABLE_NAME, offset)
+    if prefix == "_mm":
+        return "_mm_load_si128((__m128i const *){})".format(ptr)
+    if prefix == "_mm256":
+        return "_mm256_load_si256((__m256i const *){})".format(ptr)
+    return "_mm512_load_si512((void const *){})".format(ptr)
+
+
+def pack_function_constants(body):
+    vecs = []
+    for m in CONST_SET_RE.finditer(body):
+        raw = const_vec_bytes(m.group(1), int(m.group(2).rstrip("x")),
+                              m.group(3))
+        if raw is not None and raw not in vecs:
+            vecs.append(raw)
+    if len(vecs) == 0:
+        return body
+
+    # stable so the order within a width follows the network
+    vecs.sort(key=lambda raw: -len(raw))
+    offsets = {}
+    table = []
+    for raw in vecs:
+        offsets[raw] = len(table)
+        for i in range(0, len(raw), 8):
+            table.append("0x{:016x}".format(
+                int.from_bytes(raw[i:i + 8], "little")))
+
+    def replace(m):
+        raw = const_vec_bytes(m.group(1), int(m.group(2).rstrip("x")),
+                              m.group(3))
+        if raw is None:
+            return m.group(0)
+        return const_vec_load(m.group(1), offsets[raw])
+
+    decl = ""
+    decl += "/* Constant Vectors */"
+    decl += "\n"
+    decl += "static const uint64_t {}[{}] __attribute__((aligned({}))) = {{ {} }};".format(
+        CONST_TABLE_NAME, len(table), len(vecs[0]), ", ".join(table))
+    decl += "\n"
+    return "\n" + decl + CONST_SET_RE.sub(replace, body)
+
+
+# Packs each top level function body in code (the generated code has
+# no braces outside of blocks)
+def pack_constant_tables(code):
+    out = ""
+    depth = 0
+    start = 0
+    for i in range(0, len(code)):
+        if code[i] == "{":
+            if depth == 0:
+                out += code[start:i + 1]
+                start = i + 1
+            depth += 1
+        elif code[i] == "}":
+            depth -= 1
+            if depth == 0:
+                out += pack_function_constants(code[start:i])
+                start = i
+    return out + code[start:]
+
+
 class Output_Generator():
     def __init__(self, header_info, CAS_info, algorithm_name, depth, N, raw_N,
                  sort_type):
@@ -4071,7 +4794,7 @@ class Output_Generator():
         self.depth = depth
         self.sort_type = sort_type
 
-        self.simd_type = get_simd_type(N * sort_type.sizeof())
+        self.simd_type = self.CAS_info.simd_type
         self.CAS_info_str = self.CAS_info.get()
         self.loadnstore_ops = self.CAS_info.load.count(
             self.simd_type.prefix()) + self.CAS_info.store.count(
@@ -4079,9 +4802,26 @@ class Output_Generator():
         self.logic_ops = self.CAS_info_str.count(
             self.simd_type.prefix()) - self.loadnstore_ops
 
+        self.cycles = self.CAS_info.get_cycles()
+        self.port_pressure = 0.0
+        if UARCH is not None:
+            self.port_pressure = UARCH.port_pressure(
+                self.CAS_info.get_helpers() + self.CAS_info.get_inner() +
+                self.CAS_info.get_wrapper())
+            self.cycles = max(self.cycles, self.port_pressure)
+
         global TEMPLATED
         self.templated = TEMPLATED
 
+        self.payload_type = self.CAS_info.payload_type
+        self.name_postfix = ""
+        if PAYLOAD == "index":
+            self.name_postfix = "_arg"
+        elif self.payload_type is not None:
+            self.name_postfix = "_kv"
+        elif VERTICAL is True:
+            self.name_postfix = "_vertical"
+
         global SORT_FUNC_NAME
         self.sort_to_str = SORT_FUNC_NAME
         self.sort_to_str_v = self.sort_to_str + "_vec"
@@ -4090,10 +4830,12 @@ class Output_Generator():
                 sign = "s"
                 if sort_type.sign == Sign.UNSIGNED:
                     sign = "u"
-                self.sort_to_str = "{}_{}_{}{}".format(
-                    self.base_algorithm_name, raw_N, sort_type.sizeof(), sign)
-                self.sort_to_str_v = "{}_{}_{}{}_vec".format(
-                    self.vec_algorithm_name, N, sort_type.sizeof(), sign)
+                self.sort_to_str = "{}_{}_{}{}{}".format(
+                    self.base_algorithm_name, raw_N, sort_type.sizeof(), sign,
+                    self.name_postfix)
+                self.sort_to_str_v = "{}_{}_{}{}{}_vec".format(
+                    self.vec_algorithm_name, N, sort_type.sizeof(), sign,
+                    self.name_postfix)
             else:
                 self.sort_to_str = "vsort"
                 self.sort_to_str_v = ""
@@ -4101,7 +4843,7 @@ class Output_Generator():
         full_load_and_store = EXTRA_MEMORY
         if full_load_and_store is False:
             full_load_and_store = N * sort_type.sizeof(
-            ) == self.simd_type.sizeof()
+            ) == self.simd_type.sizeof() * self.CAS_info.nregs
 
         simd_restrictions = SIMD_RESTRICTIONS
         if simd_restrictions != "":
@@ -4140,6 +4882,37 @@ class Output_Generator():
         if self.raw_N != self.N:
             self.impl_info.insert(
                 2, "\tScaled Sort Size                 : {}".format(self.N))
+        if self.payload_type is not None:
+            payload_str = self.payload_type.to_string()
+            if PAYLOAD == "index":
+                payload_str += " (argsort index)"
+            self.impl_info.insert(
+                self.impl_info.index("\tUnderlying Sort Type             : {}".format(
+                    self.sort_type.to_string())) + 1,
+                "\tPayload Type                     : {}".format(payload_str))
+        if VERTICAL is True:
+            self.impl_info.insert(
+                self.impl_info.index("\tSort Size                        : {}".format(
+                    self.raw_N)) + 1,
+                "\tArrays Sorted (Vertical)         : {}".format(
+                    self.CAS_info.W))
+        if self.CAS_info.nregs != 1:
+            self.impl_info.insert(
+                self.impl_info.index("\tSIMD Type                        : {}".format(
+                    self.simd_type.to_string())) + 1,
+                "\tSIMD Registers                   : {}".format(
+                    self.CAS_info.nregs))
+        if UARCH is not None:
+            self.impl_info.insert(
+                self.impl_info.index("\tNetwork Depth                    : {}".format(depth)) + 1,
+                "\tEstimated Cycles ({}){}: {:g} (depth {}, port pressure {:g})".
+                format(UARCH.name, " " * max(1, 14 - len(UARCH.name)),
+                       self.cycles, self.CAS_info.get_cycles(),
+                       self.port_pressure))
+        if self.CAS_info.verify_info is not None:
+            self.impl_info.append(
+                "\tVerified                         : {}".format(
+                    self.CAS_info.verify_info))
 
         self.perf_notes = [
             "Performance Notes:",
@@ -4168,9 +4941,35 @@ class Output_Generator():
                 self.perf_notes[i] += "   " + s[j].strip()
                 self.perf_notes[i] += "\n"
 
+    def get_vec_call(self):
+        if self.templated is True:
+            return "{}<{}, {}>::sort_vec".format(self.sort_to_str,
+                                                 self.sort_type.to_string(),
+                                                 self.raw_N)
+        return self.sort_to_str_v
+
+    # (return type, name, params) of the memory sort (and batch sort),
+    # the C visible symbols of the "asm" output
+    def get_entry_points(self):
+        params = [
+            "{} * const {}".format(self.sort_type.to_string(),
+                                   self.CAS_info.arr_name)
+        ]
+        batch_params = ["{} * const base".format(self.sort_type.to_string())]
+        if self.payload_type is not None:
+            params.append("{} * const {}".format(
+                self.payload_type.to_string(), self.CAS_info.payload_arr_name))
+            batch_params.append("{} * const {}_base".format(
+                self.payload_type.to_string(), self.CAS_info.payload_arr_name))
+        entries = [("void", self.sort_to_str, params)]
+        if BATCH != 0:
+            entries.append(("void", self.sort_to_str + "_batch",
+                            batch_params + ["size_t count", "size_t stride"]))
+        return entries
+
     def get_info(self):
         blend_weight, perm_weight, load_weight = self.CAS_info.get_weights()
-        return self.algorithm_name, self.depth, self.logic_ops, blend_weight, perm_weight, load_weight
+        return self.algorithm_name, self.depth, self.logic_ops, blend_weight, perm_weight, load_weight, self.cycles
 
     def get(self):
         return self.get_header() + self.get_content() + self.get_tail()
@@ -4188,31 +4987,60 @@ class Output_Generator():
         head += "\n\n"
         head += self.header_info.get_headers(self.sort_type)
         head += "\n\n"
+        head += self.get_helpers()
         if self.templated is True:
-            head += "template<typename T, uint32_t n>"
-            head += "\n"
-            head += "struct {};".format("vsort" if SORT_FUNC_NAME ==
-                                        "" else SORT_FUNC_NAME)
-            head += "\n\n"
+            head += self.get_template_declaration()
+            head += self.get_specialization_head()
+        return head
 
-            head += "template<>"
-            head += "\n"
-            head += "struct {}<{}, {}>".format(self.sort_to_str,
-                                               self.sort_type.to_string(),
-                                               self.raw_N)
-            head += " {"
-            head += "\n"
+    def get_info_comment(self):
+        comment = ""
+        comment += "/*"
+        comment += "\n\n"
+        comment += arr_to_str(self.impl_info)
+        comment += "\n\n"
+        comment += " */"
+        comment += "\n"
+        return comment
+
+    def get_template_declaration(self):
+        decl = ""
+        decl += "template<typename T, uint32_t n>"
+        decl += "\n"
+        decl += "struct {};".format(self.sort_to_str)
+        decl += "\n\n"
+        return decl
+
+    def get_specialization_head(self):
+        head = ""
+        head += "template<>"
+        head += "\n"
+        head += "struct {}<{}, {}>".format(self.sort_to_str,
+                                           self.sort_type.to_string(),
+                                           self.raw_N)
+        head += " {"
+        head += "\n"
         return head
 
+    # Free functions the kernel calls (i.e the single register sorts a
+    # multi register kernel is built from). Never part of a template
+    # specialization.
+    def get_helpers(self):
+        helpers = self.CAS_info.get_helpers()
+        if CONST_TABLE is True:
+            helpers = pack_constant_tables(helpers)
+        return helpers
+
     def get_content(self):
+        content = self.CAS_info.get()
+        if CONST_TABLE is True:
+            content = pack_constant_tables(content)
         if self.templated is True:
-            return self.CAS_info.get().replace("[FUNCNAME]", "sort").replace(
+            return content.replace("[FUNCNAME]", "sort").replace(
                 "[FUNCNAME_VEC]", "sort_vec")
         else:
-            return self.CAS_info.get().replace("[FUNCNAME]",
-                                               self.sort_to_str).replace(
-                                                   "[FUNCNAME_VEC]",
-                                                   self.sort_to_str_v)
+            return content.replace("[FUNCNAME]", self.sort_to_str).replace(
+                "[FUNCNAME_VEC]", self.sort_to_str_v)
 
     def get_tail(self):
         tail = ""
@@ -4232,6 +5060,8 @@ class CAS_Output_Generator():
         self.load = ""
         self.CAS = []
         self.store = ""
+        # argsort indexes if the key store writes past N
+        self.payload_store = None
 
         self.constraints = []
 
@@ -4239,14 +5069,30 @@ class CAS_Output_Generator():
 
         self.arr_name = "arr"
         self.v_name = "v"
-        self.last_v_name = ""
+        # no compare exchanges (N = 1) returns the input
+        self.last_v_name = self.v_name
         self.tmp_name = "_tmp"
 
+        self.payload_type = get_payload_type(sort_type)
+        self.payload_arr_name = "vals"
+        if PAYLOAD == "index":
+            self.payload_arr_name = "idx"
+        self.p_name = "p"
+        self.last_p_name = self.p_name
+
+        self.nregs = 1
+
+        # --bias-unsigned, flips the sign bit of [V]
+        self.bias = ""
+
         self.already_prepared_content = False
 
         self.cas_blend_weight = 0
         self.cas_perm_weight = 0
         self.cas_load_weight = 0
+        self.cas_cycles = 0
+
+        self.verify_info = None
 
     def append_cas(self, cas):
         self.CAS.append(cas)
@@ -4261,9 +5107,21 @@ class CAS_Output_Generator():
     def add_store(self, store):
         self.store = store
 
+    def add_payload_store(self, store):
+        self.payload_store = store
+
     def get(self):
         self.prepare_content()
-        return self.get_inner() + "\n\n\n" + self.get_wrapper()
+        out = self.get_inner() + "\n\n\n" + self.get_wrapper()
+        if BATCH != 0:
+            out += "\n\n" + self.get_batch()
+        return out
+
+    def get_helpers(self):
+        return ""
+
+    def get_memory_bytes(self):
+        return self.N * self.sort_type.sizeof()
 
     def get_wrapper(self):
         return self.get_wrapper_head() + "\n" + self.get_wrapper_content(
@@ -4284,12 +5142,19 @@ class CAS_Output_Generator():
         self.cas_perm_weight = perm_weight
         self.cas_load_weight = load_weight
 
+    def get_cycles(self):
+        return self.cas_cycles
+
+    def set_cycles(self, cycles):
+        self.cas_cycles = cycles
+
     def prepare_content(self):
         if self.already_prepared_content is True:
             return
 
         self.already_prepared_content = True
 
+        raw_load = self.load
         self.load = make_returnable(self.load, self.simd_type.to_string())
         self.tmp_count, self.load = order_str_tmps(self.load, 0)
         for i in range(0, self.tmp_count):
@@ -4297,22 +5162,30 @@ class CAS_Output_Generator():
                                           "{}{}".format(self.tmp_name, i))
         self.load = self.load.replace("[ARR]", self.arr_name)
         self.load = self.load.replace("[V]", self.v_name)
+        if self.payload_type is not None:
+            self.load += self.get_payload_load(raw_load)
 
         for i in range(0, len(self.CAS)):
             last_v = self.v_name
+            last_p = self.p_name
             if i != 0:
                 last_v = "{}{}".format(self.v_name, i - 1)
+                last_p = "{}{}".format(self.p_name, i - 1)
             v_names = [
                 "perm{}".format(i), "min{}".format(i), "max{}".format(i),
                 "{}{}".format(self.v_name,
-                              i), "min{}".format(i - 1), "max{}".format(i - 1)
+                              i), "min{}".format(i - 1), "max{}".format(i - 1),
+                "{}perm{}".format(self.p_name,
+                                  i), "{}{}".format(self.p_name, i), last_p
             ]
             self.last_v_name = v_names[3]
+            self.last_p_name = v_names[7]
 
             self.tmp_count = self.CAS[i].make_operation(
                 last_v, v_names, self.tmp_count, self.tmp_name,
                 self.simd_type.to_string())
 
+        raw_store = self.store
         tmp_max, self.store = order_str_tmps(self.store, self.tmp_count)
         tmp_max += self.tmp_count
         for i in range(self.tmp_count, tmp_max):
@@ -4323,6 +5196,38 @@ class CAS_Output_Generator():
         self.store = self.store.replace("[V]", self.v_name)
         self.store = self.store.replace("[VTYPE]", self.simd_type.to_string())
         self.store += ";\n"
+        if self.payload_type is not None:
+            if self.payload_store is not None:
+                raw_store = self.payload_store
+            self.store += self.get_payload_store(raw_store, tmp_max)
+
+    # The payload is loaded / stored with the same instruction as the
+    # keys, argsort starts from the lane indexes. Those past N were never
+    # loaded so they have their own store if the keys' writes past N
+    def get_payload_load(self, raw_load):
+        if PAYLOAD == "index":
+            return "{} {} = {};\n".format(
+                self.simd_type.to_string(), self.p_name,
+                get_index_set_vec(self.payload_type, self.simd_type))
+
+        load = make_returnable(raw_load, self.simd_type.to_string())
+        ntmps, load = order_str_tmps(load, self.tmp_count)
+        for i in range(self.tmp_count, self.tmp_count + ntmps):
+            load = load.replace("[OTMP{}]".format(i),
+                                "{}{}".format(self.tmp_name, i))
+        self.tmp_count += ntmps
+        load = load.replace("[ARR]", self.payload_arr_name)
+        return load.replace("[V]", self.p_name)
+
+    def get_payload_store(self, raw_store, tmp_base):
+        ntmps, store = order_str_tmps(raw_store, tmp_base)
+        for i in range(tmp_base, tmp_base + ntmps):
+            store = store.replace("[OTMP{}]".format(i),
+                                  "{}{}".format(self.tmp_name, i))
+        store = store.replace("[ARR]", self.payload_arr_name)
+        store = store.replace("[V]", self.p_name)
+        store = store.replace("[VTYPE]", self.simd_type.to_string())
+        return store + ";\n"
 
     def get_wrapper_head(self):
         head = ""
@@ -4336,16 +5241,26 @@ class CAS_Output_Generator():
         head += "/* Wrapper For SIMD Sort */"
         head += "\n"
         head += "static "
-        head += "void inline __attribute__((always_inline)) [FUNCNAME]([VTYPE] * const [ARR]) {".replace(
+        head += "void inline __attribute__((always_inline)) [FUNCNAME]([VTYPE] * const [ARR]".replace(
             "[ARR]", self.arr_name).replace("[VTYPE]",
                                             self.sort_type.to_string())
+        if self.payload_type is not None:
+            head += ", {} * const {}".format(self.payload_type.to_string(),
+                                             self.payload_arr_name)
+        head += ") {"
         head += "\n"
         return head
 
+    def get_wrapper_call(self):
+        if self.payload_type is not None:
+            return "[FUNCNAME_VEC](&[V], &[P]);".replace(
+                "[V]", self.v_name).replace("[P]", self.p_name)
+        return "[V] = [FUNCNAME_VEC]([V]);".replace("[V]", self.v_name)
+
     def get_wrapper_content(self):
         content = self.load
         content += "\n"
-        content += "[V] = [FUNCNAME_VEC]([V]);".replace("[V]", self.v_name)
+        content += self.get_wrapper_call()
         content += "\n"
         content += "\n"
         content += self.store
@@ -4359,6 +5274,80 @@ class CAS_Output_Generator():
         tail += "\n"
         return tail
 
+    # Sorts count arrays that start stride elements apart. BATCH arrays
+    # are loaded, sorted and stored together so their dependency chains
+    # interleave, and the vec function is inlined into the loop so its
+    # constants are materialized once instead of once per array.
+    def get_batch(self):
+        rename = re.compile(r"\b({}|{}|{}|{}|{}\d+)\b".format(
+            self.arr_name, self.payload_arr_name, self.v_name, self.p_name,
+            self.tmp_name))
+
+        arrs = [("base", self.arr_name, self.sort_type)]
+        if self.payload_type is not None:
+            arrs.append(("{}_base".format(self.payload_arr_name),
+                         self.payload_arr_name, self.payload_type))
+
+        head = ""
+        global TEMPLATED
+        if TEMPLATED is False:
+            head += "#ifndef _SIMD_SORT_BATCH_[FUNCNAME]_H_"
+            head += "\n"
+            head += "#define _SIMD_SORT_BATCH_[FUNCNAME]_H_"
+            head += "\n\n"
+
+        head += "/* Batch Wrapper For SIMD Sort ([B] Arrays Per Iteration) */".replace(
+            "[B]", str(BATCH))
+        head += "\n"
+        head += "static "
+        head += "void inline __attribute__((always_inline)) [FUNCNAME]_batch("
+        head += ", ".join([
+            "{} * const {}".format(T.to_string(), base) for base, name, T in arrs
+        ])
+        head += ", size_t count, size_t stride) {"
+        head += "\n"
+
+        content = "size_t i = 0;"
+        content += "\n"
+        content += "for (; i + {} <= count; i += {}) {{".format(BATCH, BATCH)
+        content += "\n"
+        for k in range(0, BATCH):
+            for base, name, T in arrs:
+                offset = "i"
+                if k != 0:
+                    offset = "(i + {})".format(k)
+                content += "{} * const {}_{} = {} + {} * stride;".format(
+                    T.to_string(), name, k, base, offset)
+                content += "\n"
+
+        # two iterations ahead, every cache line the sort touches
+        sort_bytes = self.get_memory_bytes()
+        for k in range(0, BATCH):
+            for base, name, T in arrs:
+                for line in range(0, sort_bytes, 64):
+                    content += "__builtin_prefetch({}_{} + {} * stride{}, 1);".format(
+                        name, k, 2 * BATCH, "" if line == 0 else " + {}".format(
+                            int(line / T.sizeof())))
+                    content += "\n"
+
+        for part in [self.load, self.get_wrapper_call() + "\n", self.store]:
+            content += "\n"
+            for k in range(0, BATCH):
+                content += rename.sub(r"\g<1>_{}".format(k), part)
+        content += "}"
+        content += "\n"
+
+        content += "for (; i < count; ++i) {"
+        content += "\n"
+        content += "[FUNCNAME]("
+        content += ", ".join(["{} + i * stride".format(base) for base, name, T in arrs])
+        content += ");"
+        content += "\n"
+        content += "}"
+        content += "\n"
+
+        return head + content + self.get_wrapper_tail()
+
     def get_inner_head(self):
         head = ""
         global TEMPLATED
@@ -4371,15 +5360,29 @@ class CAS_Output_Generator():
         head += "/* SIMD Sort */"
         head += "\n"
         head += "static "
-        head += "[VTYPE] __attribute__((const)) [FUNCNAME_VEC]([VTYPE] [V]) {".replace(
-            "[VTYPE]", self.simd_type.to_string()).replace("[V]", self.v_name)
+        if self.payload_type is not None:
+            head += "void inline __attribute__((always_inline)) [FUNCNAME_VEC]([VTYPE] * const [V]_ptr, [VTYPE] * const [P]_ptr) {".replace(
+                "[VTYPE]", self.simd_type.to_string()).replace(
+                    "[V]", self.v_name).replace("[P]", self.p_name)
+            head += "\n"
+            head += "[VTYPE] [V] = *[V]_ptr;".replace(
+                "[VTYPE]",
+                self.simd_type.to_string()).replace("[V]", self.v_name)
+            head += "\n"
+            head += "[VTYPE] [V] = *[V]_ptr;".replace(
+                "[VTYPE]",
+                self.simd_type.to_string()).replace("[V]", self.p_name)
+        else:
+            head += "[VTYPE] __attribute__((const)) [FUNCNAME_VEC]([VTYPE] [V]) {".replace(
+                "[VTYPE]",
+                self.simd_type.to_string()).replace("[V]", self.v_name)
         head += "\n"
         return head
 
     def get_inner_content(self):
         ordered_content = []
         for i in range(0, len(self.CAS)):
-            reorder, comments, perm, _min, _max, blend = self.CAS[
+            reorder, comments, perm, _min, _max, blend, payload = self.CAS[
                 i].get_operation()
             if reorder is True:
                 err_assert(len(ordered_content) != 0, "about to have OOB")
@@ -4403,8 +5406,18 @@ class CAS_Output_Generator():
             ordered_content.append(_min)
             ordered_content.append(_max)
             ordered_content.append(blend)
+            # payload kernels never reorder, the previous blend is
+            # always last otherwise
+            if payload != "":
+                ordered_content.append(payload)
 
         content = ""
+        if self.bias != "":
+            content += "/* Bias Keys To Signed */"
+            content += "\n"
+            content += "{} = {};".format(
+                self.v_name, self.bias.replace("[V]", self.v_name))
+            content += "\n"
         for oc in ordered_content:
             if "/* Pairs" in oc and content != "":
                 content += "\n"
@@ -4413,7 +5426,16 @@ class CAS_Output_Generator():
         return content
 
     def get_inner_tail(self):
-        tail = "return [V];\n".replace("[V]", self.last_v_name)
+        last_v = self.last_v_name
+        if self.bias != "":
+            last_v = self.bias.replace("[V]", last_v)
+        if self.payload_type is not None:
+            tail = "*[V]_ptr = [LAST_V];\n".replace("[V]", self.v_name).replace(
+                "[LAST_V]", last_v)
+            tail += "*[V]_ptr = [LAST_V];\n".replace("[V]", self.p_name).replace(
+                "[LAST_V]", self.last_p_name)
+        else:
+            tail = "return [V];\n".replace("[V]", last_v)
         tail += "}\n"
         global TEMPLATED
         if TEMPLATED is False:
@@ -4433,14 +5455,23 @@ class Compare_Exchange():
 
         self.constraints = constraints
 
+        self.raw_payload_perm = ""
+        self.raw_payload_select = ""
+
         self.tmps_start = 0
         self.tmps_end = 0
 
         self.reorder = False
         self.blend_max = False
+
+    def add_payload(self, raw_payload_perm, raw_payload_select, constraints):
+        self.raw_payload_perm = raw_payload_perm
+        self.raw_payload_select = raw_payload_select
+        self.constraints += constraints
+
     def get_operation(self):
         return self.reorder, self.make_comment(
-        ), self.raw_perm, self.raw_min, self.raw_max, self.raw_blend
+        ), self.raw_perm, self.raw_min, self.raw_max, self.raw_blend, self.raw_payload_perm + self.raw_payload_select
 
     def make_comment(self):
         pair_list_str = ""
@@ -4489,6 +5520,10 @@ class Compare_Exchange():
         self.raw_min = make_returnable(self.raw_min, simd_type_str)
         self.raw_max = make_returnable(self.raw_max, simd_type_str)
         self.raw_blend = make_returnable(self.raw_blend, simd_type_str)
+        self.raw_payload_perm = make_returnable(self.raw_payload_perm,
+                                                simd_type_str)
+        self.raw_payload_select = make_returnable(self.raw_payload_select,
+                                                  simd_type_str)
 
     def set_v(self, v_names):
         self.raw_perm = self.raw_perm.replace("[V]", v_names[0])
@@ -4498,6 +5533,11 @@ class Compare_Exchange():
         else:
             self.raw_max = self.raw_max.replace("[V]", v_names[2])
             self.raw_blend = self.raw_blend.replace("[V]", v_names[3])
+        if self.raw_payload_perm != "":
+            self.raw_payload_perm = self.raw_payload_perm.replace(
+                "[V]", v_names[6])
+            self.raw_payload_select = self.raw_payload_select.replace(
+                "[V]", v_names[7])
 
     def set_tmp(self, tmp_name):
         for i in range(self.tmps_start, self.tmps_end):
@@ -4509,6 +5549,10 @@ class Compare_Exchange():
                                                 "{}{}".format(tmp_name, i))
             self.raw_blend = self.raw_blend.replace("[OTMP{}]".format(i),
                                                     "{}{}".format(tmp_name, i))
+            self.raw_payload_perm = self.raw_payload_perm.replace(
+                "[OTMP{}]".format(i), "{}{}".format(tmp_name, i))
+            self.raw_payload_select = self.raw_payload_select.replace(
+                "[OTMP{}]".format(i), "{}{}".format(tmp_name, i))
 
     def set_input_arguments(self, last_v, v_names):
         if "[V2]" in self.raw_perm:
@@ -4526,6 +5570,14 @@ class Compare_Exchange():
             "[V2]", v_names[0]).replace("[V0]", v_names[1])
         self.raw_blend = self.raw_blend.replace("[V1]", v_names[2]).replace(
             "[V2]", v_names[1])
+        if self.raw_payload_perm != "":
+            err_assert(self.reorder is False,
+                       "payload permute can't use the previous min / max")
+            self.raw_payload_perm = self.raw_payload_perm.replace(
+                "[V1]", v_names[8])
+            self.raw_payload_select = self.raw_payload_select.replace(
+                "[K0]", v_names[3]).replace("[K1]", last_v).replace(
+                    "[P0]", v_names[6]).replace("[P1]", v_names[8])
 
     def order_temporaries(self, base):
         self.tmps_start = base
@@ -4537,6 +5589,12 @@ class Compare_Exchange():
         base += ntmps
         ntmps, self.raw_blend = order_str_tmps(self.raw_blend, base)
         base += ntmps
+        ntmps, self.raw_payload_perm = order_str_tmps(self.raw_payload_perm,
+                                                      base)
+        base += ntmps
+        ntmps, self.raw_payload_select = order_str_tmps(
+            self.raw_payload_select, base)
+        base += ntmps
         self.tmps_end = base
         return base
 
@@ -4546,8 +5604,9 @@ class Compare_Exchange_Generator():
 
         self.total_blend_weight = 0
         self.total_perm_weight = 0
+        self.total_cycles = 0
 
-        self.pairs = copy.deepcopy(pairs)
+        self.pairs = list(pairs)
         self.sort_N = sort_n(N, sort_type.sizeof())
         self.sort_type = sort_type
         self.simd_type = get_simd_type(self.sort_N * self.sort_type.sizeof())
@@ -4560,6 +5619,13 @@ class Compare_Exchange_Generator():
 
         self.cas_output_generator = CAS_Output_Generator(N, sort_type)
 
+        self.compare_type = compare_type(sort_type, self.simd_type)
+        self.bias = None
+        if self.compare_type is not sort_type:
+            self.bias = bias_instruction(self.simd_type)
+            self.cas_output_generator.bias = self.bias.generate_instruction()
+            self.cas_output_generator.add_constraints(self.bias.constraints)
+
         do_full = EXTRA_MEMORY
         if self.simd_type.sizeof() == N * sort_type.sizeof():
             do_full = True
@@ -4575,22 +5641,66 @@ class Compare_Exchange_Generator():
             SIMD_Store(N, sort_type, did_scale_N).instructions, self.sort_type,
             self.simd_type, ALIGNED_ACCESS, do_full)
 
+        self.payload_store = None
+        if PAYLOAD == "index" and self.simd_type.sizeof(
+        ) != N * sort_type.sizeof() and (do_full is True
+                                         or INT_ALIGNED is True):
+            self.payload_store = self.index_store(N, did_scale_N)
+
+        self.payload_type = get_payload_type(sort_type)
+        if self.payload_type is not None:
+            self.SIMD_payload_select = instruction_filter(
+                SIMD_Payload_Select().instructions, self.sort_type,
+                self.simd_type)
+
+    # The keys past N are stored back unchanged by full / int aligned
+    # stores but argsort indexes past N were never loaded, they need a
+    # store of only N (INT_ALIGNED is also read when the store is
+    # generated so this returns the generated store and its constraints)
+    def index_store(self, N, did_scale_N):
+        global INT_ALIGNED
+        saved_int_aligned = INT_ALIGNED
+        INT_ALIGNED = False
+        store = best_instruction(
+            instruction_filter(
+                SIMD_Store(N, self.sort_type, did_scale_N).instructions,
+                self.sort_type, self.simd_type, ALIGNED_ACCESS, False))
+        instruction = store.generate_instruction()
+        INT_ALIGNED = saved_int_aligned
+        return instruction, store.constraints
+
     def Generate_Instructions(self):
         best_load = best_instruction(self.SIMD_load)
         self.cas_output_generator.add_constraints(best_load.constraints)
         self.cas_output_generator.add_load(best_load.generate_instruction())
 
         for i in range(0, int(len(self.pairs) / self.sort_N)):
-            self.cas_output_generator.append_cas(self.Make_Compare_Exchange(i))
+            cas = self.Make_Compare_Exchange(i)
+            if self.payload_type is not None:
+                best_select = best_instruction(self.SIMD_payload_select)
+                cas.add_payload(cas.raw_perm,
+                                best_select.generate_instruction(),
+                                best_select.constraints)
+            self.cas_output_generator.append_cas(cas)
 
         best_store = best_instruction(self.SIMD_store)
         self.cas_output_generator.add_constraints(best_store.constraints)
         self.cas_output_generator.add_store(best_store.generate_instruction())
+        if self.payload_store is not None:
+            instruction, constraints = self.payload_store
+            self.cas_output_generator.add_constraints(constraints)
+            self.cas_output_generator.add_payload_store(instruction)
 
         self.cas_output_generator.set_weights(self.total_blend_weight,
                                               self.total_perm_weight,
                                               best_load.weight)
 
+        self.total_cycles += instruction_latency(
+            best_load) + instruction_latency(best_store)
+        if self.bias is not None:
+            self.total_cycles += 2 * instruction_latency(self.bias)
+        self.cas_output_generator.set_cycles(self.total_cycles)
+
         return self.cas_output_generator
 
     def Make_Compare_Exchange(self, cas_idx):
@@ -4598,13 +5708,45 @@ class Compare_Exchange_Generator():
         cas_perm = []
         for i in range(cas_idx * self.sort_N, (cas_idx + 1) * self.sort_N):
             cas_perm.append(self.pairs[i])
-        if cas_idx != 0:
+        # the payload has no previous min / max to permute from
+        if cas_idx != 0 and self.payload_type is None:
             for i in range((cas_idx - 1) * self.sort_N,
                            (cas_idx) * self.sort_N):
                 cas_prev_perm.append(self.pairs[i])
 
+        key = cache.key(cas_prev_perm, cas_perm, self.compare_type.to_string(),
+                        self.simd_type.to_string(), constraints_key())
+
+        selection = cache.get("cas", key)
+        if selection is None:
+            saved_min_max_count = MIN_MAX_COUNT
+            saved_header = copy.copy(header.__dict__)
+
+            selection = self.Select_Compare_Exchange(cas_prev_perm, cas_perm)
+
+            if saved_min_max_count == MIN_MAX_COUNT:
+                header_flags = [
+                    k for k, v in header.__dict__.items()
+                    if v is True and saved_header[k] is False
+                ]
+                cache.put("cas", key, selection + (header_flags, ))
+        else:
+            for flag in selection[len(selection) - 1]:
+                setattr(header, flag, True)
+
+        (perm, _min, _max, blend, constraints, blend_weight, perm_weight,
+         cycles) = selection[:8]
+
+        self.total_blend_weight += blend_weight
+        self.total_perm_weight += perm_weight
+        self.total_cycles += cycles
+
+        return Compare_Exchange(cas_perm, perm, _min, _max, blend,
+                                copy.copy(constraints))
+
+    def Select_Compare_Exchange(self, cas_prev_perm, cas_perm):
         SIMD_blend = instruction_filter(
-            SIMD_Blend(cas_perm).instructions, self.sort_type, self.simd_type)
+            SIMD_Blend(cas_perm).instructions, self.compare_type, self.simd_type)
 
         best_blend = best_instruction(SIMD_blend)
 
@@ -4615,13 +5757,13 @@ class Compare_Exchange_Generator():
 
         SIMD_permute = instruction_filter(
             SIMD_Permute(cas_prev_perm, is_mask_blend, is_avx512,
-                         cas_perm).instructions, self.sort_type,
+                         cas_perm).instructions, self.compare_type,
             self.simd_type)
 
         best_permutate = best_instruction(SIMD_permute)
         is_2 = best_permutate.carry_over()
 
-        SIMD_min = instruction_filter(SIMD_Min().instructions, self.sort_type,
+        SIMD_min = instruction_filter(SIMD_Min().instructions, self.compare_type,
                                       self.simd_type)
 
         if is_avx512 is False and is_2 is False:
@@ -4629,7 +5771,7 @@ class Compare_Exchange_Generator():
 
         SIMD_max = instruction_filter(
             SIMD_Max(cas_perm, is_2, is_mask_blend, is_avx512).instructions,
-            self.sort_type, self.simd_type)
+            self.compare_type, self.simd_type)
 
         best_min = best_instruction(SIMD_min)
         best_max = best_instruction(SIMD_max)
@@ -4640,37 +5782,909 @@ class Compare_Exchange_Generator():
             ## recompute incase we could have selected a better instruction
             SIMD_permute = instruction_filter(
             SIMD_Permute(cas_prev_perm, False, False,
-                         cas_perm).instructions, self.sort_type,
+                         cas_perm).instructions, self.compare_type,
             self.simd_type)
 
         best_permutate = best_instruction(SIMD_permute)
 
-        self.total_blend_weight += best_blend.weight
-        self.total_perm_weight += best_permutate.weight
+        # min and max issue in parallel so only the slower adds to the
+        # dependency depth
+        cycles = instruction_latency(best_permutate) + max(
+            instruction_latency(best_min), instruction_latency(
+                best_max)) + instruction_latency(best_blend)
 
-        compare_exchange = Compare_Exchange(
-            cas_perm, best_permutate.generate_instruction(),
-            best_min.generate_instruction(), best_max.generate_instruction(),
-            best_blend.generate_instruction(),
-            best_permutate.constraints + best_min.constraints +
-            best_max.constraints + best_blend.constraints)
-
-        return compare_exchange
+        return (best_permutate.generate_instruction(),
+                best_min.generate_instruction(),
+                best_max.generate_instruction(),
+                best_blend.generate_instruction(),
+                best_permutate.constraints + best_min.constraints +
+                best_max.constraints + best_blend.constraints,
+                best_blend.weight, best_permutate.weight, cycles)
 
 
 ######################################################################
-# Network Generation
+# Multi Register
+
+# Sorts that don't fit in one register are split across 2 - 8 of the
+# largest registers available. Each register is sorted with the
+# single register network for the full register, then registers are
+# bitonic merged. The first layer of each merge compares a register
+# with the reverse of its mirror, every other inter-register layer
+# compares lane i with lane i of another register so it is just a
+# min and a max. The max register of the first layer is left in
+# reversed lane order which is fine, once the merge is down to pairs
+# within a register each register holds a bitonic sequence (reversed
+# or not) and is finished with the single register bitonic merge
+# network. Lanes past N are filled with the max value so they sort to
+# the end and are never stored.
 ######################################################################
 
 
-def next_p2(v):
-    v -= 1
-    v |= v >> 1
-    v |= v >> 2
-    v |= v >> 4
-    v |= v >> 8
-    v |= v >> 16
-    v += 1
+def get_max_simd_type():
+    if SIMD_m512().has_support() is True:
+        return SIMD_m512()
+    if SIMD_m256().has_support() is True:
+        return SIMD_m256()
+    return SIMD_m128()
+
+
+def is_multi_register(N, sort_type):
+    return N * sort_type.sizeof() > get_max_simd_type().sizeof()
+
+
+class Multi_Register_Network():
+    def __init__(self, N, sort_type, algorithm_name):
+        self.N = N
+        self.network_N = N
+        self.sort_type = sort_type
+        self.simd_type = get_max_simd_type()
+
+        self.reg_N = int(self.simd_type.sizeof() / sort_type.sizeof())
+        self.nregs = int((N + self.reg_N - 1) / self.reg_N)
+        # the merges are the bitonic merge of a power of 2 registers.
+        # Registers past nregs would only hold max fill and stay that
+        # way (min with them is a no-op, max is max fill) so they
+        # aren't allocated and their compare exchanges are dropped
+        self.merge_nregs = next_p2(self.nregs)
+        err_assert(PAYLOAD == "",
+                   "\"payload-type\" is only supported for single register sorts")
+        err_assert(
+            self.nregs <= 8,
+            "N to large for network size ({} {} registers, max is 8)".format(
+                self.nregs, self.simd_type.to_string()))
+
+        # with --bias-unsigned the registers are sorted / merged as
+        # int64_t between the bias after the load and before the store
+        self.compare_type = compare_type(sort_type, self.simd_type)
+        self.register_sort = Builder(self.reg_N, self.compare_type,
+                                     algorithm_name)
+        self.algorithm = self.register_sort.network.algorithm
+
+        self.create_register_merge()
+
+        self.depth = self.register_sort.network.depth
+        for layers in self.get_merge_levels():
+            self.depth += len(layers) + self.merge_depth
+
+    # Single register bitonic merge, sorts a register holding a bitonic
+    # sequence
+    def create_register_merge(self):
+        merge = Bitonic(self.reg_N)
+        merge.bitonic_merge(0, self.reg_N, True)
+
+        transformer = Transform(self.reg_N, False, self.compare_type,
+                                merge.pairs)
+        transformer.group()
+        transformer.permutation()
+        self.merge_depth = transformer.depth
+
+        header.reset()
+        self.merge_generator = Compare_Exchange_Generator(
+            transformer.pairs, self.reg_N, False, self.compare_type)
+        self.merge_pairs = list(transformer.pairs)
+        self.merge_info = self.merge_generator.Generate_Instructions()
+        self.merge_header = copy.copy(header)
+
+    # Returns the inter-register layers of each merge as a list of
+    # (min register, max register, reverse max register) tuples
+    def get_merge_levels(self):
+        levels = []
+        block = 2
+        while block <= self.merge_nregs:
+            layers = [[]]
+            for lo in range(0, self.merge_nregs, block):
+                for i in range(0, int(block / 2)):
+                    layers[0].append((lo + i, lo + block - (i + 1), True))
+
+            dist = int(block / 4)
+            while dist > 0:
+                layers.append([])
+                for lo in range(0, self.merge_nregs, 2 * dist):
+                    for i in range(lo, lo + dist):
+                        layers[-1].append((i, i + dist, False))
+                dist = int(dist / 2)
+
+            layers = [[cas for cas in layer if cas[1] < self.nregs]
+                      for layer in layers]
+            levels.append([layer for layer in layers if len(layer) != 0])
+            block = 2 * block
+        return levels
+
+
+class Multi_Register_Generator():
+    def __init__(self, network):
+        self.network = network
+        self.N = network.N
+        self.reg_N = network.reg_N
+        self.nregs = network.nregs
+        self.sort_type = network.sort_type
+        self.simd_type = network.simd_type
+
+        header.merge(network.register_sort.header)
+        header.merge(network.merge_header)
+        header.immintrin = True
+
+        self.output_generator = Multi_Register_Output_Generator(
+            self.N, self.reg_N, self.nregs, self.sort_type)
+
+        self.compare_type = network.compare_type
+        self.bias = None
+        if self.compare_type is not self.sort_type:
+            self.bias = bias_instruction(self.simd_type)
+            self.output_generator.bias = self.bias.generate_instruction()
+            self.output_generator.add_constraints(self.bias.constraints)
+
+        self.SIMD_min = instruction_filter(SIMD_Min().instructions,
+                                           self.compare_type, self.simd_type)
+        self.SIMD_max = instruction_filter(
+            SIMD_Max([], False, False, False).instructions, self.compare_type,
+            self.simd_type)
+
+        # In the perm format (lane 0 last) reversing is just [0, N)
+        self.SIMD_reverse = instruction_filter(
+            SIMD_Permute([], False, False, list(range(0,
+                                                      self.reg_N))).instructions,
+            self.compare_type, self.simd_type)
+
+    # helpers are shared with the kernels of the type they sort as
+    def helper_name(self, name):
+        sign = "s"
+        if self.compare_type.sign == Sign.UNSIGNED:
+            sign = "u"
+        return "{}_{}_{}{}_vec".format(name, self.reg_N,
+                                       self.compare_type.sizeof(), sign)
+
+    # latency of the vec function alone
+    def vec_cycles(self, cas_generator, cas_info):
+        return cas_info.get_cycles() - instruction_latency(
+            best_instruction(cas_generator.SIMD_load)) - instruction_latency(
+                best_instruction(cas_generator.SIMD_store))
+
+    def Generate_Instructions(self):
+        register_sort = self.network.register_sort
+        sort_name = self.helper_name(register_sort.network_name)
+        merge_name = self.helper_name("bitonic_merge")
+
+        out = self.output_generator
+        out.add_helper(register_sort.cas_info, sort_name)
+        out.add_helper(self.network.merge_info, merge_name)
+        out.add_constraints(register_sort.cas_info.constraints)
+        out.add_constraints(self.network.merge_info.constraints)
+
+        load_cycles = 0
+        store_cycles = 0
+        load_weight = 0
+        for i in range(0, self.nregs):
+            count = min(self.reg_N, self.N - i * self.reg_N)
+            if count <= 0:
+                out.add_register_load(
+                    i, get_max_set_vec(self.sort_type, self.simd_type))
+                continue
+
+            # a partial register has to be filled with max
+            fill = count != self.reg_N
+            do_full = EXTRA_MEMORY or fill is False
+            if do_full is True and self.simd_type.sizeof() == 8:
+                header.aliasing_m64 = True
+
+            best_load = best_instruction(
+                instruction_filter(
+                    SIMD_Load(count, self.sort_type, fill).instructions,
+                    self.sort_type, self.simd_type, ALIGNED_ACCESS, do_full))
+            best_store = best_instruction(
+                instruction_filter(
+                    SIMD_Store(count, self.sort_type, fill).instructions,
+                    self.sort_type, self.simd_type, ALIGNED_ACCESS, do_full))
+
+            out.add_constraints(best_load.constraints + best_store.constraints)
+            out.add_register_load(i, best_load.generate_instruction())
+            out.add_register_store(i, best_store.generate_instruction())
+
+            load_weight += best_load.weight
+            load_cycles = max(load_cycles, instruction_latency(best_load))
+            store_cycles = max(store_cycles, instruction_latency(best_store))
+
+        sort_blend_weight, sort_perm_weight, _ = register_sort.cas_info.get_weights(
+        )
+        merge_blend_weight, merge_perm_weight, _ = self.network.merge_info.get_weights(
+        )
+
+        out.append_register_call("Sort Each Register", sort_name)
+        total_cycles = load_cycles + store_cycles + self.vec_cycles(
+            register_sort.cas_generator, register_sort.cas_info)
+        if self.bias is not None:
+            total_cycles += 2 * instruction_latency(self.bias)
+        total_blend_weight = self.nregs * sort_blend_weight
+        total_perm_weight = self.nregs * sort_perm_weight
+
+        merge_N = self.reg_N
+        for layers in self.network.get_merge_levels():
+            merge_N = 2 * merge_N
+            for layer in layers:
+                for lo, hi, reverse in layer:
+                    best_min = best_instruction(self.SIMD_min)
+                    best_max = best_instruction(self.SIMD_max)
+                    perm = ""
+                    if reverse is True:
+                        best_reverse = best_instruction(self.SIMD_reverse)
+                        err_assert(best_reverse.carry_over() is False,
+                                   "register reverse needs second register")
+                        perm = best_reverse.generate_instruction()
+                        out.add_constraints(best_reverse.constraints)
+                        total_perm_weight += best_reverse.weight
+
+                    # min and max of the same registers must be generated
+                    # back to back (fallbacks share the compare)
+                    out.append_register_min_max(
+                        lo, hi, perm, best_min.generate_instruction(),
+                        best_max.generate_instruction())
+                    out.add_constraints(best_min.constraints +
+                                        best_max.constraints)
+
+                total_cycles += max(instruction_latency(best_min),
+                                    instruction_latency(best_max))
+                if layer[0][2] is True:
+                    total_cycles += instruction_latency(best_reverse)
+
+            out.append_register_call(
+                "Bitonic Merge Into Runs Of {}".format(merge_N), merge_name)
+            total_cycles += self.vec_cycles(self.network.merge_generator,
+                                            self.network.merge_info)
+            total_blend_weight += self.nregs * merge_blend_weight
+            total_perm_weight += self.nregs * merge_perm_weight
+
+        out.set_weights(total_blend_weight, total_perm_weight, load_weight)
+        out.set_cycles(total_cycles)
+        return out
+
+
+def make_assignable(raw_str, simd_type_str):
+    ops = raw_str.split("\n")
+    ops[len(ops) - 1] = "[V] = " + ops[len(ops) - 1] + ";"
+
+    out = ""
+    for op in ops:
+        out += op.replace("[VTYPE]", simd_type_str) + "\n"
+    return out
+
+
+class Multi_Register_Output_Generator(CAS_Output_Generator):
+    def __init__(self, N, reg_N, nregs, sort_type):
+        super().__init__(reg_N, sort_type)
+        self.N = N
+        self.nregs = nregs
+
+        self.helpers = []
+        self.loads = []
+        self.stores = []
+        self.inner_content = ""
+        self.op_count = 0
+
+    def add_helper(self, cas_info, name):
+        cas_info.prepare_content()
+        helper = cas_info.get_inner().replace("[FUNCNAME_VEC]", name)
+
+        # always guarded, different kernels (or template
+        # specializations) share them
+        global TEMPLATED
+        if TEMPLATED is True:
+            helper = "#ifndef _SIMD_SORT_VEC_{}_H_\n#define _SIMD_SORT_VEC_{}_H_\n\n".format(
+                name, name) + helper + "#endif\n"
+        self.helpers.append(helper)
+
+    def add_register_load(self, idx, load):
+        self.loads.append((idx, load))
+
+    def add_register_store(self, idx, store):
+        self.stores.append((idx, store))
+
+    def register_name(self, idx):
+        return "{}[{}]".format(self.v_name, idx)
+
+    def register_arr(self, idx):
+        if idx == 0:
+            return self.arr_name
+        return "({} + {})".format(self.arr_name, idx * int(
+            self.simd_type.sizeof() / self.sort_type.sizeof()))
+
+    def order_tmps(self, raw_str):
+        ntmps, raw_str = order_str_tmps(raw_str, self.tmp_count)
+        for i in range(self.tmp_count, self.tmp_count + ntmps):
+            raw_str = raw_str.replace("[OTMP{}]".format(i),
+                                      "{}{}".format(self.tmp_name, i))
+        self.tmp_count += ntmps
+        return raw_str
+
+    def make_op(self, raw_str, v_name, v1, v2):
+        op = self.order_tmps(make_returnable(raw_str,
+                                             self.simd_type.to_string()))
+        return op.replace("[V1]", v1).replace("[V2]", v2).replace(
+            "[V]", v_name)
+
+    def append_register_call(self, comment, name):
+        content = "\n"
+        content += "/* {} */".format(comment)
+        content += "\n"
+        for i in range(0, self.nregs):
+            content += "{} = {}({});".format(self.register_name(i), name,
+                                             self.register_name(i))
+            content += "\n"
+        self.inner_content += content
+
+    def append_register_min_max(self, lo, hi, perm, _min, _max):
+        idx = self.op_count
+        self.op_count += 1
+
+        content = "\n"
+        content += "/* Registers: ({}, {}){} */".format(
+            lo, hi, " Reversed" if perm != "" else "")
+        content += "\n"
+
+        hi_name = self.register_name(hi)
+        if perm != "":
+            hi_name = "perm{}".format(idx)
+            content += self.make_op(perm, hi_name, self.register_name(hi),
+                                    "")
+
+        content += self.make_op(_min, "min{}".format(idx),
+                                self.register_name(lo), hi_name)
+        content += self.make_op(_max, "max{}".format(idx),
+                                self.register_name(lo), hi_name)
+        content += "{} = min{};".format(self.register_name(lo), idx)
+        content += "\n"
+        content += "{} = max{};".format(self.register_name(hi), idx)
+        content += "\n"
+        self.inner_content += content
+
+    def prepare_content(self):
+        if self.already_prepared_content is True:
+            return
+
+        self.already_prepared_content = True
+
+        # tmps in the inner function were numbered as ops were added
+        self.tmp_count = 0
+        self.load = "[VTYPE] [V][{}];".format(self.nregs).replace(
+            "[VTYPE]", self.simd_type.to_string()).replace("[V]", self.v_name)
+        self.load += "\n"
+        for idx, load in self.loads:
+            load = self.order_tmps(
+                make_assignable(load, self.simd_type.to_string()))
+            load = load.replace("[ARR]", self.register_arr(idx))
+            self.load += load.replace("[V]", self.register_name(idx))
+
+        self.store = ""
+        for idx, store in self.stores:
+            store = self.order_tmps(store)
+            store = store.replace("[ARR]", self.register_arr(idx))
+            store = store.replace("[V]", self.register_name(idx))
+            store = store.replace("[VTYPE]", self.simd_type.to_string())
+            self.store += store + ";\n"
+
+    def get_helpers(self):
+        helpers = ""
+        for helper in self.helpers:
+            helpers += helper
+            helpers += "\n\n"
+        return helpers
+
+    def get_wrapper_call(self):
+        return "[FUNCNAME_VEC]([V]);".replace("[V]", self.v_name)
+
+    def get_wrapper_content(self):
+        content = self.load
+        content += "\n"
+        content += self.get_wrapper_call()
+        content += "\n"
+        content += "\n"
+        content += self.store
+        return content
+
+    def get_inner_head(self):
+        head = ""
+        global TEMPLATED
+        if TEMPLATED is False:
+            head += "#ifndef _SIMD_SORT_VEC_[FUNCNAME_VEC]_H_"
+            head += "\n"
+            head += "#define _SIMD_SORT_VEC_[FUNCNAME_VEC]_H_"
+            head += "\n\n"
+
+        head += "/* SIMD Sort ([N] Registers) */".replace(
+            "[N]", str(self.nregs))
+        head += "\n"
+        head += "static "
+        head += "void inline __attribute__((always_inline)) [FUNCNAME_VEC]([VTYPE] * const [V]) {".replace(
+            "[VTYPE]", self.simd_type.to_string()).replace("[V]", self.v_name)
+        head += "\n"
+        return head
+
+    # registers the network sorts
+    def biased_registers(self):
+        return range(0, self.nregs)
+
+    def get_register_bias(self, comment):
+        content = "/* {} */".format(comment)
+        content += "\n"
+        for i in self.biased_registers():
+            content += "{} = {};".format(
+                self.register_name(i),
+                self.bias.replace("[V]", self.register_name(i)))
+            content += "\n"
+        return content
+
+    def get_inner_content(self):
+        if self.bias == "":
+            return self.inner_content
+        return self.get_register_bias(
+            "Bias Keys To Signed") + self.inner_content + "\n" + self.get_register_bias(
+                "Undo Bias")
+
+    def get_inner_tail(self):
+        tail = "}\n"
+        global TEMPLATED
+        if TEMPLATED is False:
+            tail += "#endif"
+        tail += "\n"
+        return tail
+
+
+######################################################################
+# Vertical
+
+# --vertical sorts W independent arrays of N at once, W being the lane
+# count of the largest register. Lane k of register i holds element i
+# of array k so every compare exchange is a min and a max of two whole
+# registers, there are no permutes or blends in the network. The arrays
+# are contiguous ([0, N) is the first, [N, 2N) the second ...) and are
+# loaded as W x W blocks (W elements of each array) that are
+# transposed in registers. The transpose swaps the off diagonal g x g
+# quarters of every 2g x 2g sub-block for g = W / 2 ... 1. That is its
+# own inverse so the same helper transposes the blocks back before
+# they are stored. Stores are in memory order so a full register store
+# that spills into the next array only rewrites values it loaded
+# before that array is stored.
+######################################################################
+
+
+# Each 2 * block_bytes chunk of the result is [V1] block 0, [V2]
+# block 0 (or block 1 of both if high)
+class SIMD_Interleave_Blocks():
+    def __init__(self, block_bytes, high):
+        lo_hi = int(high)
+        and_or_m128 = [
+            "_mm_or_si128(_mm_and_si128([V1], [MASK]), _mm_slli_[SHIFT]([V2], [BITS]))",
+            "_mm_or_si128(_mm_srli_[SHIFT]([V1], [BITS]), _mm_andnot_si128([MASK], [V2]))"
+        ][lo_hi]
+        and_or_m256 = and_or_m128.replace("_mm_", "_mm256_").replace(
+            "si128", "si256")
+        and_or_m512 = and_or_m128.replace("_mm_", "_mm512_").replace(
+            "si128", "si512")
+
+        shift = {1: "epi16", 2: "epi32", 4: "epi64"}
+        masks = {
+            1: "set1_epi16(0xff)",
+            2: "set1_epi32(0xffff)",
+            4: "set1_epi64x(0xffffffff)"
+        }
+
+        self.instructions = []
+        if block_bytes in shift:
+            for simd_type, and_or, constraints in [
+                (SIMD_m128(), and_or_m128, ["SSE2"]),
+                (SIMD_m256(), and_or_m256, ["AVX2"]),
+                (SIMD_m512(), and_or_m512, ["AVX512f"])
+            ]:
+                mask = "{}_{}".format(simd_type.prefix(), masks[block_bytes])
+                if simd_type.sizeof() == 64:
+                    mask = mask.replace("epi64x", "epi64")
+                self.instructions.append(
+                    SIMD_Instruction(
+                        and_or.replace("[MASK]", mask).replace(
+                            "[SHIFT]", shift[block_bytes]).replace(
+                                "[BITS]", str(8 * block_bytes)),
+                        Sign.NOT_SIGNED, -1, simd_type, constraints, 1))
+
+        if block_bytes == 1:
+            self.instructions += [
+                SIMD_Instruction([
+                    "_mm512_mask_blend_epi8(0xaaaaaaaaaaaaaaaa, [V1], _mm512_slli_epi16([V2], 8))",
+                    "_mm512_mask_blend_epi8(0xaaaaaaaaaaaaaaaa, _mm512_srli_epi16([V1], 8), [V2])"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m512(), ["AVX512bw"], 0)
+            ]
+        elif block_bytes == 2:
+            self.instructions += [
+                SIMD_Instruction([
+                    "_mm_blend_epi16([V1], _mm_slli_epi32([V2], 16), 0xaa)",
+                    "_mm_blend_epi16(_mm_srli_epi32([V1], 16), [V2], 0xaa)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m128(), ["SSE4.1"], 0),
+                SIMD_Instruction([
+                    "_mm256_blend_epi16([V1], _mm256_slli_epi32([V2], 16), 0xaa)",
+                    "_mm256_blend_epi16(_mm256_srli_epi32([V1], 16), [V2], 0xaa)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m256(), ["AVX2"], 0),
+                SIMD_Instruction([
+                    "_mm512_mask_blend_epi16(0xaaaaaaaa, [V1], _mm512_slli_epi32([V2], 16))",
+                    "_mm512_mask_blend_epi16(0xaaaaaaaa, _mm512_srli_epi32([V1], 16), [V2])"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m512(), ["AVX512bw"], 0)
+            ]
+        elif block_bytes == 4:
+            self.instructions += [
+                SIMD_Instruction([
+                    "_mm_blend_epi16([V1], _mm_slli_epi64([V2], 32), 0xcc)",
+                    "_mm_blend_epi16(_mm_srli_epi64([V1], 32), [V2], 0xcc)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m128(), ["SSE4.1"], 0),
+                SIMD_Instruction([
+                    "_mm256_blend_epi32([V1], _mm256_slli_epi64([V2], 32), 0xaa)",
+                    "_mm256_blend_epi32(_mm256_srli_epi64([V1], 32), [V2], 0xaa)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m256(), ["AVX2"], 0),
+                SIMD_Instruction([
+                    "_mm512_mask_shuffle_epi32([V1], 0xaaaa, [V2], _MM_PERM_CCAA)",
+                    "_mm512_mask_shuffle_epi32([V2], 0x5555, [V1], _MM_PERM_DDBB)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m512(), ["AVX512f"], 0)
+            ]
+        elif block_bytes == 8:
+            op = ["unpacklo", "unpackhi"][lo_hi]
+            self.instructions += [
+                SIMD_Instruction("_mm_{}_epi64([V1], [V2])".format(op),
+                                 Sign.NOT_SIGNED, -1, SIMD_m128(), ["SSE2"],
+                                 0),
+                SIMD_Instruction("_mm256_{}_epi64([V1], [V2])".format(op),
+                                 Sign.NOT_SIGNED, -1, SIMD_m256(), ["AVX2"],
+                                 0),
+                SIMD_Instruction("_mm512_{}_epi64([V1], [V2])".format(op),
+                                 Sign.NOT_SIGNED, -1, SIMD_m512(),
+                                 ["AVX512f"], 0)
+            ]
+        elif block_bytes == 16:
+            self.instructions += [
+                SIMD_Instruction([
+                    "_mm256_permute2x128_si256([V1], [V2], 0x20)",
+                    "_mm256_permute2x128_si256([V1], [V2], 0x31)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m256(), ["AVX2"], 0),
+                SIMD_Instruction([
+                    "_mm512_mask_shuffle_i64x2([V1], 0xcc, [V2], [V2], 0xa0)",
+                    "_mm512_mask_shuffle_i64x2([V2], 0x33, [V1], [V1], 0xf5)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m512(), ["AVX512f"], 0)
+            ]
+        elif block_bytes == 32:
+            self.instructions += [
+                SIMD_Instruction([
+                    "_mm512_shuffle_i64x2([V1], [V2], 0x44)",
+                    "_mm512_shuffle_i64x2([V1], [V2], 0xee)"
+                ][lo_hi], Sign.NOT_SIGNED, -1, SIMD_m512(), ["AVX512f"], 0)
+            ]
+
+
+class Vertical_Network():
+    def __init__(self, N, sort_type, algorithm_name):
+        self.N = N
+        self.network_N = N
+        self.sort_type = sort_type
+        self.simd_type = get_max_simd_type()
+
+        self.W = int(self.simd_type.sizeof() / sort_type.sizeof())
+        self.nblocks = int((N + self.W - 1) / self.W)
+        err_assert(PAYLOAD == "",
+                   "\"payload-type\" is not supported with \"vertical\"")
+        err_assert(N >= 2, "\"vertical\" needs N >= 2")
+
+        # every compare exchange costs the same so "best" is the
+        # network with the fewest, then the least depth
+        candidates = [algorithm_name]
+        if algorithm_name == "best":
+            candidates = [
+                name for name in Algorithms(N).algorithms if name != "best"
+            ]
+
+        best = None
+        for name in candidates:
+            algorithm = Algorithms(N).get_algorithm(name)
+            if algorithm.valid() is False or (name == "minimum"
+                                              and N >= len(min_pairs())):
+                continue
+            pairs = list(algorithm.create_pairs())
+            # i.e there is no minimum network for N < 4
+            if len(pairs) == 0:
+                continue
+            layers = self.get_layers(pairs)
+            cost = (int(len(pairs) / 2), len(layers))
+            if best is None or cost < best[0]:
+                best = (cost, algorithm, layers)
+        err_assert(best is not None,
+                   "No \"{}\" network for N = {}".format(algorithm_name, N))
+
+        self.algorithm = best[1]
+        self.layers = best[2]
+        self.depth = len(self.layers)
+
+    # Each compare exchange goes in the layer after the last one that
+    # used either of its registers
+    def get_layers(self, pairs):
+        layers = []
+        last = [-1] * self.N
+        for i in range(0, len(pairs), 2):
+            lo, hi = pairs[i], pairs[i + 1]
+            err_assert(lo < hi,
+                       "vertical compare exchange ({}, {}) not ascending".format(
+                           lo, hi))
+            layer = max(last[lo], last[hi]) + 1
+            if layer == len(layers):
+                layers.append([])
+            layers[layer].append((lo, hi))
+            last[lo] = layer
+            last[hi] = layer
+        return layers
+
+
+class Vertical_Generator():
+    def __init__(self, network):
+        self.network = network
+        self.N = network.N
+        self.W = network.W
+        self.nblocks = network.nblocks
+        self.sort_type = network.sort_type
+        self.simd_type = network.simd_type
+
+        header.immintrin = True
+
+        self.output_generator = Vertical_Output_Generator(
+            self.N, self.W, self.nblocks, self.sort_type)
+
+        self.compare_type = compare_type(self.sort_type, self.simd_type)
+        self.bias = None
+        if self.compare_type is not self.sort_type:
+            self.bias = bias_instruction(self.simd_type)
+            self.output_generator.bias = self.bias.generate_instruction()
+            self.output_generator.add_constraints(self.bias.constraints)
+
+        self.SIMD_min = instruction_filter(SIMD_Min().instructions,
+                                           self.compare_type, self.simd_type)
+        self.SIMD_max = instruction_filter(
+            SIMD_Max([], False, False, False).instructions, self.compare_type,
+            self.simd_type)
+
+    def transpose_name(self):
+        return "transpose_{}x{}_{}_vec".format(self.W, self.W,
+                                               self.sort_type.sizeof())
+
+    # returns the transpose helper and the (perm weight, cycles) of
+    # running it once
+    def create_transpose(self):
+        name = self.transpose_name()
+        vtype = self.simd_type.to_string()
+
+        helper = ""
+        helper += "#ifndef _SIMD_SORT_VEC_{}_H_".format(name)
+        helper += "\n"
+        helper += "#define _SIMD_SORT_VEC_{}_H_".format(name)
+        helper += "\n\n"
+        helper += "/* In Register Transpose Of {} x {} Block */".format(
+            self.W, self.W)
+        helper += "\n"
+        helper += "static "
+        helper += "void inline __attribute__((always_inline)) {}({} * const v) {{".format(
+            name, vtype)
+        helper += "\n"
+
+        perm_weight = 0
+        cycles = 0
+        tmp = 0
+        g = int(self.W / 2)
+        while g > 0:
+            block_bytes = g * self.sort_type.sizeof()
+            ops = []
+            for high in [False, True]:
+                best_op = best_instruction(
+                    instruction_filter(
+                        SIMD_Interleave_Blocks(block_bytes,
+                                               high).instructions,
+                        self.sort_type, self.simd_type))
+                self.output_generator.add_constraints(best_op.constraints)
+                perm_weight += int(self.W / 2) * best_op.weight
+                ops.append(best_op)
+            cycles += max(instruction_latency(ops[0]),
+                          instruction_latency(ops[1]))
+
+            helper += "\n"
+            helper += "/* Swap Blocks Of {} */".format(g)
+            helper += "\n"
+            for i in range(0, self.W):
+                if (i & g) != 0:
+                    continue
+                v1 = "v[{}]".format(i)
+                v2 = "v[{}]".format(i + g)
+                for op, dst in [(ops[0], "lo{}".format(tmp)),
+                                (ops[1], "hi{}".format(tmp))]:
+                    helper += "{} {} = {};".format(
+                        vtype, dst,
+                        op.generate_instruction().replace("[V1]", v1).replace(
+                            "[V2]", v2))
+                    helper += "\n"
+                helper += "{} = lo{};".format(v1, tmp)
+                helper += "\n"
+                helper += "{} = hi{};".format(v2, tmp)
+                helper += "\n"
+                tmp += 1
+            g = int(g / 2)
+
+        helper += "}"
+        helper += "\n"
+        helper += "#endif"
+        helper += "\n"
+        self.output_generator.helpers.append(helper)
+        return perm_weight, cycles
+
+    def Generate_Instructions(self):
+        out = self.output_generator
+        transpose_weight, transpose_cycles = self.create_transpose()
+        out.set_transpose(self.transpose_name())
+
+        # the arrays are already a multiple of the register size so
+        # "extra memory" / "int aligned" guarantee nothing past them.
+        # Whether a row is loaded / stored full is do_full alone (the
+        # instructions also read the globals when they are selected /
+        # generated)
+        global EXTRA_MEMORY
+        global INT_ALIGNED
+        saved_memory_flags = (EXTRA_MEMORY, INT_ALIGNED)
+        EXTRA_MEMORY = False
+        INT_ALIGNED = False
+
+        load_cycles = 0
+        store_cycles = 0
+        load_weight = 0
+        block_bytes = self.W * self.N * self.sort_type.sizeof()
+        # row major so stores are in memory order
+        for k in range(0, self.W):
+            for c in range(0, self.nblocks):
+                idx = c * self.W + k
+                count = min(self.W, self.N - c * self.W)
+                offset = (k * self.N + c * self.W) * self.sort_type.sizeof()
+
+                # a full register that stays inside the arrays is fine
+                # even if it runs into the next one
+                do_full = offset + self.simd_type.sizeof() <= block_bytes
+                fill = count != self.W and do_full is False
+                aligned = ALIGNED_ACCESS and offset % self.simd_type.sizeof(
+                ) == 0
+                if do_full is True and self.simd_type.sizeof() == 8:
+                    header.aliasing_m64 = True
+
+                best_load = best_instruction(
+                    instruction_filter(
+                        SIMD_Load(count, self.sort_type, fill).instructions,
+                        self.sort_type, self.simd_type, aligned, do_full))
+                best_store = best_instruction(
+                    instruction_filter(
+                        SIMD_Store(count, self.sort_type, fill).instructions,
+                        self.sort_type, self.simd_type, aligned, do_full))
+
+                out.add_constraints(best_load.constraints +
+                                    best_store.constraints)
+                out.add_register_load(idx, best_load.generate_instruction())
+                out.add_register_store(idx, best_store.generate_instruction())
+
+                load_weight += best_load.weight
+                load_cycles = max(load_cycles, instruction_latency(best_load))
+                store_cycles = max(store_cycles,
+                                   instruction_latency(best_store))
+        EXTRA_MEMORY, INT_ALIGNED = saved_memory_flags
+
+        total_cycles = load_cycles + store_cycles + 2 * transpose_cycles
+        if self.bias is not None:
+            total_cycles += 2 * instruction_latency(self.bias)
+        for layer in self.network.layers:
+            for lo, hi in layer:
+                best_min = best_instruction(self.SIMD_min)
+                best_max = best_instruction(self.SIMD_max)
+                # min and max of the same registers must be generated
+                # back to back (fallbacks share the compare)
+                out.append_register_min_max(lo, hi, "",
+                                            best_min.generate_instruction(),
+                                            best_max.generate_instruction())
+                out.add_constraints(best_min.constraints +
+                                    best_max.constraints)
+            total_cycles += max(instruction_latency(best_min),
+                                instruction_latency(best_max))
+
+        out.set_weights(0, 2 * self.nblocks * transpose_weight, load_weight)
+        out.set_cycles(total_cycles)
+        return out
+
+
+class Vertical_Output_Generator(Multi_Register_Output_Generator):
+    def __init__(self, N, W, nblocks, sort_type):
+        super().__init__(N, W, nblocks * W, sort_type)
+        self.W = W
+        self.nblocks = nblocks
+        self.transpose = ""
+
+    def set_transpose(self, name):
+        self.transpose = name
+
+    # register c * W + k is loaded from array k, elements [c * W, c * W + W)
+    def register_arr(self, idx):
+        c, k = divmod(idx, self.W)
+        offset = k * self.N + c * self.W
+        if offset == 0:
+            return self.arr_name
+        return "({} + {})".format(self.arr_name, offset)
+
+    def get_memory_bytes(self):
+        return self.W * self.N * self.sort_type.sizeof()
+
+    # registers past N are only padding
+    def biased_registers(self):
+        return range(0, self.N)
+
+    def get_transposes(self):
+        content = ""
+        for c in range(0, self.nblocks):
+            block = self.v_name
+            if c != 0:
+                block = "{} + {}".format(self.v_name, c * self.W)
+            content += "{}({});".format(self.transpose, block)
+            content += "\n"
+        return content
+
+    def prepare_content(self):
+        if self.already_prepared_content is True:
+            return
+        super().prepare_content()
+        self.load += self.get_transposes()
+        self.store = self.get_transposes() + self.store
+
+    def get_inner_head(self):
+        head = ""
+        global TEMPLATED
+        if TEMPLATED is False:
+            head += "#ifndef _SIMD_SORT_VEC_[FUNCNAME_VEC]_H_"
+            head += "\n"
+            head += "#define _SIMD_SORT_VEC_[FUNCNAME_VEC]_H_"
+            head += "\n\n"
+
+        head += "/* Vertical SIMD Sort (Lane k Of [V][0] ... [V][[N]] Is Array k) */".replace(
+            "[N]", str(self.N - 1)).replace("[V]", self.v_name)
+        head += "\n"
+        head += "static "
+        head += "void inline __attribute__((always_inline)) [FUNCNAME_VEC]([VTYPE] * const [V]) {".replace(
+            "[VTYPE]", self.simd_type.to_string()).replace("[V]", self.v_name)
+        head += "\n"
+        return head
+
+
+######################################################################
+# Network Generation
+######################################################################
+
+
+def next_p2(v):
+    v -= 1
+    v |= v >> 1
+    v |= v >> 2
+    v |= v >> 4
+    v |= v >> 8
+    v |= v >> 16
+    v += 1
     return v
 
 
@@ -4687,7 +6701,7 @@ class Transform():
         self.scaled = scaled
         self.sort_type = sort_type
 
-        self.pairs = copy.deepcopy(pairs)
+        self.pairs = list(pairs)
 
         self.depth = -1
 
@@ -4800,7 +6814,7 @@ class Transform():
                         for k in range(0, max_mod):
                             perm_arr[(i * sort_N) + j + k] = tmp[k]
 
-        self.pairs = copy.deepcopy(perm_arr)
+        self.pairs = list(perm_arr)
         err_assert(len(self.pairs) == len(perm_arr), "bad usage of deep copy")
 
 
@@ -4841,7 +6855,7 @@ class Bitonic():
         transformer = Transform(self.N, False, Sort_Type(1, True), self.pairs)
         transformer.unidirectional()
 
-        self.pairs = copy.deepcopy(transformer.pairs)
+        self.pairs = list(transformer.pairs)
         return self.pairs
 
 
@@ -4968,7 +6982,7 @@ class Minimum():
     def __init__(self, N):
         self.name = "minimum"
         self.N = N
-        self.pairs = copy.deepcopy(min_pairs()[min(N, 32)])
+        self.pairs = list(min_pairs()[min(N, 32)])
         self.depth = None
 
     def valid(self):
@@ -4982,16 +6996,20 @@ class Minimum():
 
 class Weights():
     def __init__(self, perm_weight, blend_weight, load_weight,
-                 instruction_weight, depth_weight, algorithm, npairs):
+                 instruction_weight, depth_weight, algorithm, npairs,
+                 cycles):
+        self.cycles = cycles
         self.perm_weight = perm_weight
         self.blend_weight = blend_weight
         self.load_weight = load_weight
         self.instruction_weight = instruction_weight
         self.depth_weight = depth_weight
         self.algorithm = algorithm
-        self.npairs = copy.deepcopy(npairs)
+        self.npairs = list(npairs)
 
     def val(self):
+        if UARCH is not None:
+            return self.cycles
         return 2 * self.perm_weight + self.blend_weight + self.load_weight + 10 * self.depth_weight
 
 
@@ -5024,17 +7042,17 @@ class Best():
                     err_assert(p.N == n, "something is seriously wrong")
                     b = Builder(self.N, USER_TYPE, p.name, n)
 
-                    name, depth, instructions, blend_weight, perm_weight, load_weight = b.Stats(
+                    name, depth, instructions, blend_weight, perm_weight, load_weight, cycles = b.Stats(
                     )
                     self.options.append(
                         Weights(perm_weight, blend_weight, load_weight,
-                                instructions, depth, p, b.network_pairs))
+                                instructions, depth, p, b.network_pairs,
+                                cycles))
 
     def create_orders(self):
-        all_weights = copy.deepcopy(self.options)
-        all_weights = sorted(all_weights, key=lambda w: w.val())
+        all_weights = sorted(self.options, key=lambda w: w.val())
 
-        self.pairs = copy.deepcopy(all_weights[0].npairs)
+        self.pairs = list(all_weights[0].npairs)
         self.name = all_weights[0].algorithm.name
         self.depth = all_weights[0].depth_weight
         self.N = all_weights[0].algorithm.N
@@ -5094,13 +7112,22 @@ class Network():
         return ret
 
     def get_network(self):
-        transformer = Transform(self.N, self.scaled, self.sort_type,
-                                self.create_pairs())
-        transformer.group()
-        transformer.permutation()
-        self.depth = transformer.depth
+        pairs = self.create_pairs()
+        key = cache.key(pairs, self.N, self.scaled, self.sort_type.sizeof(),
+                        INT_ALIGNED, EXTRA_MEMORY)
+
+        network = cache.get("network", key)
+        if network is None:
+            transformer = Transform(self.N, self.scaled, self.sort_type,
+                                    pairs)
+            transformer.group()
+            transformer.permutation()
+            network = (transformer.pairs, transformer.depth)
+            cache.put("network", key, network)
+
+        self.depth = network[1]
         self.algorithm.depth = self.depth
-        return transformer.pairs
+        return list(network[0])
 
 
 class Builder():
@@ -5114,14 +7141,22 @@ class Builder():
         if network_N is None:
             network_N = N
         self.network_pairs = None
-        self.network = Network(network_N, network_N > N, sort_type,
-                               algorithm_name)
-        if algorithm_name.lower() == "best":
-            self.network_pairs, self.network.depth = self.network.create_pairs(
-            )
-
+        self.multi_register = VERTICAL is False and is_multi_register(
+            N, sort_type)
+        if VERTICAL is True:
+            self.network = Vertical_Network(N, sort_type, algorithm_name)
+        elif self.multi_register is True:
+            self.network = Multi_Register_Network(N, sort_type,
+                                                  algorithm_name)
         else:
-            self.network_pairs = self.network.get_network()
+            self.network = Network(network_N, network_N > N, sort_type,
+                                   algorithm_name)
+            if algorithm_name.lower() == "best":
+                self.network_pairs, self.network.depth = self.network.create_pairs(
+                )
+
+            else:
+                self.network_pairs = self.network.get_network()
         network_N = self.network.network_N
         self.network_N = network_N
         self.network_name = self.network.algorithm.name
@@ -5129,20 +7164,52 @@ class Builder():
         self.did_scale_N = network_N != self.N
 
         header.reset()
-        self.cas_generator = Compare_Exchange_Generator(
-            self.network_pairs, N, self.did_scale_N, self.network.sort_type)
+        if VERTICAL is True:
+            self.cas_generator = Vertical_Generator(self.network)
+        elif self.multi_register is True:
+            self.cas_generator = Multi_Register_Generator(self.network)
+        else:
+            self.cas_generator = Compare_Exchange_Generator(
+                self.network_pairs, N, self.did_scale_N,
+                self.network.sort_type)
 
         self.cas_info = self.cas_generator.Generate_Instructions()
+        if BATCH != 0:
+            header.stddef = True
+        self.header = copy.copy(header)
+
+    def Verify(self):
+        self.cas_info.verify_info = Verifier(self).run()
 
     def Stats(self):
-        full_output = Output_Generator(header, self.cas_info,
+        full_output = Output_Generator(self.header, self.cas_info,
                                        self.algorithm_name, self.network.depth,
                                        self.network_N, self.N, self.sort_type)
         return full_output.get_info()
 
+    def Report(self):
+        full_output = Output_Generator(self.header, self.cas_info,
+                                       self.network_name, self.network.depth,
+                                       self.network_N, self.N, self.sort_type)
+        report = MCA_Report(full_output.get(), full_output.get_vec_call(),
+                            full_output.simd_type, self.cas_info.nregs,
+                            full_output.payload_type is not None,
+                            self.cas_info.get_instruction_sets())
+        return report.get()
+
+    def Assemble(self):
+        full_output = Output_Generator(self.header, self.cas_info,
+                                       self.network_name, self.network.depth,
+                                       self.network_N, self.N, self.sort_type)
+        asm = Assembly_Output(full_output.get(), self.header.get_includes(),
+                              full_output.get_entry_points(),
+                              self.cas_info.get_instruction_sets(),
+                              full_output.impl_info)
+        return asm.get()
+
     def Build(self):
 
-        full_output = Output_Generator(header, self.cas_info,
+        full_output = Output_Generator(self.header, self.cas_info,
                                        self.network_name, self.network.depth,
                                        self.network_N, self.N, self.sort_type)
         out = full_output.get()
@@ -5155,38 +7222,1998 @@ class Builder():
 
 
 ######################################################################
-# Main()
-def main():
+# Static Throughput Report
+
+# Compiles the generated kernel, pulls the assembly of the vec function
+# out and runs it through llvm-mca for each -mcpu target. llvm-mca
+# treats the block as a loop body and the sort's output register is
+# its input register, so "Cycles / Iter" is the latency of one sort
+# while "Block RThroughput" is the bound if sorts were independent.
+######################################################################
+
+
+def isa_flags(instruction_sets):
+    flags = []
+    for isa in instruction_sets:
+        if isa != "":
+            flags.append("-m" + isa.lower())
+    return flags
+
+
+# Returns (stdout, stderr) or (None, first line of the error)
+def run_tool(cmd, input_str):
+    try:
+        sproc = subprocess.Popen(cmd,
+                                 stdin=subprocess.PIPE,
+                                 stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE)
+
+        stdout_data, stderr_data = sproc.communicate(
+            input=input_str.encode(), timeout=60)
+    except OSError:
+        return None, "unable to run {}".format(cmd[0])
+    except subprocess.TimeoutExpired:
+        sproc.kill()
+        return None, "{} timed out".format(cmd[0])
+
+    stdout_data = stdout_data.decode("utf-8", "ignore")
+    stderr_data = stderr_data.decode("utf-8", "ignore")
+    if sproc.returncode != 0:
+        return None, stderr_data.strip().split("\n")[0]
+    return stdout_data, stderr_data
+
+
+# Instruction sets of the -mcpu targets the report knows about. Targets
+# not listed here are always analyzed.
+MCA_X86_64_V3 = [
+    "MMX", "SSE", "SSE2", "SSE3", "SSSE3", "SSE4.1", "SSE4.2", "AVX", "AVX2"
+]
+MCA_CPU_ISAS = {
+    "haswell": MCA_X86_64_V3,
+    "skylake": MCA_X86_64_V3,
+    "znver2": MCA_X86_64_V3,
+    "znver3": MCA_X86_64_V3,
+    "skylake-avx512": MCA_X86_64_V3 + ["AVX512f", "AVX512vl", "AVX512bw"],
+    "cascadelake": MCA_X86_64_V3 + ["AVX512f", "AVX512vl", "AVX512bw"],
+    "icelake-client":
+    MCA_X86_64_V3 + ["AVX512f", "AVX512vl", "AVX512bw", "AVX512vbmi"],
+    "icelake-server":
+    MCA_X86_64_V3 + ["AVX512f", "AVX512vl", "AVX512bw", "AVX512vbmi"],
+    "tigerlake":
+    MCA_X86_64_V3 + ["AVX512f", "AVX512vl", "AVX512bw", "AVX512vbmi"]
+}
+MCA_DEFAULT_CPUS = ["skylake-avx512", "icelake-server", "znver3"]
+
+
+def mca_cpu_supports(cpu, instruction_sets):
+    if cpu not in MCA_CPU_ISAS:
+        return True
+    for isa in instruction_sets:
+        if isa != "" and isa not in MCA_CPU_ISAS[cpu]:
+            return False
+    return True
+
+
+class MCA_Report():
+    def __init__(self, kernel, vec_call, simd_type, nregs, payload,
+                 instruction_sets):
+        self.kernel = kernel
+        self.vec_call = vec_call
+        self.simd_type = simd_type
+        self.nregs = nregs
+        self.payload = payload
+        self.instruction_sets = instruction_sets
+        self.kernel_name = "mca_kernel"
+
+    def compile_kernel(self):
+        source = self.kernel
+        source += "\n"
+        if self.payload is True:
+            source += "extern \"C\" void {}({} * const v, {} * const p) {{ {}(v, p); }}".format(
+                self.kernel_name, self.simd_type.to_string(),
+                self.simd_type.to_string(), self.vec_call)
+        elif self.nregs == 1:
+            source += "extern \"C\" {} {}({} v) {{ return {}(v); }}".format(
+                self.simd_type.to_string(), self.kernel_name,
+                self.simd_type.to_string(), self.vec_call)
+        else:
+            # registers are passed in memory, the loads / stores of v
+            # are part of the measured block
+            source += "extern \"C\" void {}({} * const v) {{ {}(v); }}".format(
+                self.kernel_name, self.simd_type.to_string(), self.vec_call)
+        source += "\n"
+
+        cmd = [
+            COMPILER_EXE, "-x", "c++", "-std=c++17", "-O3", "-S", "-o", "-",
+            "-fno-asynchronous-unwind-tables", "-fno-exceptions"
+        ] + isa_flags(self.instruction_sets) + ["-"]
+        asm, err = run_tool(cmd, source)
+        err_assert(asm is not None, "Error compiling kernel: {}".format(err))
+        return self.extract_asm(asm)
+
+    def extract_asm(self, asm):
+        body = []
+        in_kernel = False
+        for line in asm.split("\n"):
+            if line.startswith(self.kernel_name + ":"):
+                in_kernel = True
+                continue
+            if in_kernel is False:
+                continue
+            line = line.strip()
+            if line == "" or line.startswith(".") or line.endswith(":"):
+                if line.startswith(".size") or line.startswith(
+                        ".cfi_endproc"):
+                    break
+                continue
+            # return is outside the block being measured
+            if line.startswith("ret"):
+                continue
+            body.append(line)
+        err_assert(
+            len(body) != 0,
+            "unable to find {} in compiled assembly".format(self.kernel_name))
+        return "\n".join(body) + "\n"
+
+    def parse_field(self, mca_out, field):
+        for line in mca_out.split("\n"):
+            if line.startswith(field + ":"):
+                return float(line.split(":")[1].strip())
+        return None
+
+    def parse_pressure(self, mca_out):
+        lines = mca_out.split("\n")
+        names = {}
+        for i in range(0, len(lines)):
+            if lines[i].startswith("Resources:"):
+                for j in range(i + 1, len(lines)):
+                    parts = lines[j].split("-", 1)
+                    if len(parts) != 2 or lines[j].strip().startswith(
+                            "[") is False:
+                        break
+                    names[parts[0].strip()] = parts[1].strip()
+            if lines[i].startswith("Resource pressure per iteration:"):
+                idx = lines[i + 1].split()
+                vals = lines[i + 2].split()
+                max_idx = None
+                max_val = 0.0
+                for k in range(0, min(len(idx), len(vals))):
+                    if vals[k] == "-":
+                        continue
+                    if float(vals[k]) > max_val:
+                        max_val = float(vals[k])
+                        max_idx = idx[k]
+                if max_idx is None:
+                    return "None"
+                return "{} ({})".format(names.get(max_idx, max_idx),
+                                        max_val)
+        return "None"
+
+    def analyze(self, asm, cpu):
+        cmd = [LLVM_MCA_EXE, "-mtriple=x86_64", "-mcpu=" + cpu]
+        mca_out, err = run_tool(cmd, asm)
+        if mca_out is None:
+            return [cpu, err]
+
+        iterations = self.parse_field(mca_out, "Iterations")
+        cycles = self.parse_field(mca_out, "Total Cycles")
+        uops = self.parse_field(mca_out, "Total uOps")
+        rthroughput = self.parse_field(mca_out, "Block RThroughput")
+        return [
+            cpu, "{:.2f}".format(cycles / iterations),
+            "{:.2f}".format(rthroughput), "{:g}".format(uops / iterations),
+            self.parse_pressure(mca_out)
+        ]
+
+    def get(self):
+        asm = self.compile_kernel()
+        rows = [[
+            "CPU", "Cycles / Iter", "Block RThroughput", "uOps",
+            "Max Resource Pressure"
+        ]]
+        cpus = MCA_CPUS
+        if len(cpus) == 0:
+            cpus = MCA_DEFAULT_CPUS
+        skipped = [
+            cpu for cpu in cpus
+            if mca_cpu_supports(cpu, self.instruction_sets) is False
+        ]
+        for cpu in cpus:
+            if cpu not in skipped:
+                rows.append(self.analyze(asm, cpu))
+
+        widths = []
+        for row in rows:
+            # error rows are a single message, don't size columns on them
+            if len(row) != len(rows[0]):
+                continue
+            for i in range(0, len(row)):
+                if i == len(widths):
+                    widths.append(0)
+                widths[i] = max(widths[i], len(row[i]))
+
+        out = "/*"
+        out += "\n\n"
+        out += "llvm-mca Static Report: {} ({} instructions)".format(
+            self.vec_call, len(asm.strip().split("\n")))
+        out += "\n"
+        for row in rows:
+            out += "\t"
+            for i in range(0, len(row)):
+                out += row[i].ljust(widths[i] + 2)
+            out = out.rstrip()
+            out += "\n"
+        if len(skipped) != 0:
+            out += "\tSkipped (missing instruction sets): {}\n".format(
+                arr_to_csv(skipped))
+        out += "\n"
+        out += " */"
+        out += "\n"
+        return out
+
+
+######################################################################
+# Assembly Output
+
+# Compiles the generated C once and keeps the result as a standalone
+# .S so the kernel no longer depends on the compiler that builds the
+# project. The generated functions are put in a namespace and each
+# entry point gets an extern "C" wrapper (SysV ABI, arguments in
+# rdi / rsi / rdx). Local labels are prefixed with the first entry
+# point so outputs can be appended to the same file.
+######################################################################
+
+
+class Assembly_Output():
+    def __init__(self, source, includes, entries, instruction_sets, info):
+        self.source = source
+        self.includes = includes
+        self.entries = entries
+        self.instruction_sets = instruction_sets
+        self.info = info
+        self.namespace = "asm_kernels"
+
+    def get_prototype(self, entry):
+        ret, name, params = entry
+        return "{} {}({})".format(ret, name, ", ".join(params))
+
+    def get_wrapper(self, entry):
+        ret, name, params = entry
+        args = [param.split()[-1] for param in params]
+        call = "{}::{}({})".format(self.namespace, name, ", ".join(args))
+        if ret != "void":
+            call = "return " + call
+        return "extern \"C\" {} {{ {}; }}".format(self.get_prototype(entry),
+                                                   call)
+
+    def compile(self):
+        # the generated includes are guarded so including them first
+        # keeps them out of the namespace
+        source = self.includes
+        source += "namespace {} {{".format(self.namespace)
+        source += "\n"
+        source += self.source
+        source += "\n"
+        source += "}"
+        source += "\n\n"
+        for entry in self.entries:
+            source += self.get_wrapper(entry)
+            source += "\n"
+
+        cmd = [
+            COMPILER_EXE, "-x", "c++", "-std=c++17", "-O3", "-S", "-o", "-",
+            "-fno-asynchronous-unwind-tables", "-fno-exceptions",
+            "-masm=" + ASM_SYNTAX
+        ] + isa_flags(self.instruction_sets)
+        if ASM_VZEROUPPER is False:
+            cmd.append("-mno-vzeroupper")
+        cmd.append("-")
+        asm, err = run_tool(cmd, source)
+        err_assert(asm is not None, "Error compiling kernel: {}".format(err))
+        return asm
+
+    def is_text_section(self, line, in_text):
+        if line.startswith(".text"):
+            return True
+        if line.startswith(".section"):
+            return line.split()[1].startswith(".text")
+        if line.startswith(".data") or line.startswith(".bss"):
+            return False
+        return in_text
+
+    def post_process(self, asm):
+        label_prefix = ".L{}_".format(self.entries[0][1])
+        lines = []
+        if ASM_SYNTAX == "att":
+            lines.append("\t.att_syntax")
+        in_text = False
+        for line in asm.split("\n"):
+            directive = line.strip()
+            if directive.startswith(".file") or directive.startswith(
+                    ".ident"):
+                continue
+            in_text = self.is_text_section(directive, in_text)
+            if ASM_ALIGN != 0 and in_text is True and directive.startswith(
+                    ".p2align"):
+                line = "\t.p2align {}".format(ASM_ALIGN.bit_length() - 1)
+                # loop heads are aligned with two .p2align
+                if len(lines) != 0 and lines[-1] == line:
+                    continue
+            lines.append(re.sub(r"(?<![\w.])\.L(\w+)", label_prefix + r"\1",
+                                line))
+        return "\n".join(lines).strip() + "\n"
+
+    def get_compiler_version(self):
+        version, err = run_tool([COMPILER_EXE, "--version"], "")
+        if version is None:
+            return COMPILER_EXE
+        return version.strip().split("\n")[0]
+
+    def get(self):
+        asm = self.post_process(self.compile())
+
+        syntax = "AT&T"
+        if ASM_SYNTAX == "intel":
+            syntax = "Intel"
+        align = "Compiler Default"
+        if ASM_ALIGN != 0:
+            align = "{} Bytes".format(ASM_ALIGN)
+        asm_info = [
+            "Assembly Output:",
+            "\tSyntax                           : {}".format(syntax),
+            "\tCompiler                         : {}".format(
+                self.get_compiler_version()),
+            "\tCode Alignment                   : {}".format(align),
+            "\tvzeroupper                       : {}".format(
+                str(ASM_VZEROUPPER))
+        ]
+
+        out = "/*"
+        out += "\n\n"
+        out += arr_to_str(self.info)
+        out += "\n\n"
+        out += arr_to_str(asm_info)
+        out += "\n\n"
+        out += "Entry Points (SysV ABI):"
+        out += "\n"
+        for entry in self.entries:
+            out += "\t{};".format(self.get_prototype(entry))
+            out += "\n"
+        out += "\n"
+        out += " */"
+        out += "\n\n"
+        out += asm
+        return out
+
+
+######################################################################
+# Verification
+
+# --verify checks every kernel before it is written. The network is
+# checked with the 0-1 principle: a comparator network sorts every
+# input iff it sorts every input of 0s and 1s. The inputs are
+# evaluated bit-parallel, bit x of lane j's integer is lane j of input
+# x, so a compare exchange of all 2^N inputs is one and / or. That is
+# exhaustive up to VERIFY_EXHAUSTIVE_N lanes, past it random 0-1
+# inputs are used. The simulated schedule is the grouped / permuted
+# one the instructions are generated from (including the lanes past N
+# and the merges between registers).
+#
+# The emitted code itself is run by a small interpreter of the
+# intrinsics this file generates on 0-1 and random inputs (with
+# duplicates and the type's min / max) and must output a sorted
+# permutation of its input. The memory function (load, vec function,
+# store) is run the same way on a buffer of exactly the bytes it may
+# access, with random bytes past N that must be unchanged afterwards.
+# Anything it doesn't know is reported in the output header instead of
+# failing.
+######################################################################
+
+VERIFY_EXHAUSTIVE_N = 24
+VERIFY_SAMPLES = 1 << 12
+VERIFY_KERNEL_RUNS = 256
+VERIFY_MEMORY_RUNS = 32
+
+
+class Interpreter_Unsupported(Exception):
+    pass
+
+
+class Vec():
+    def __init__(self, bits, width):
+        self.width = width
+        self.bits = bits & ((1 << width) - 1)
+
+    def lanes(self, T_bits, signed=False):
+        out = []
+        mask = (1 << T_bits) - 1
+        for i in range(0, int(self.width / T_bits)):
+            x = (self.bits >> (i * T_bits)) & mask
+            if signed is True and (x >> (T_bits - 1)) != 0:
+                x -= (1 << T_bits)
+            out.append(x)
+        return out
+
+    def chunks(self, chunk_bits):
+        return self.lanes(chunk_bits)
+
+
+def vec_of(lanes, T_bits, width):
+    bits = 0
+    mask = (1 << T_bits) - 1
+    for i in range(0, len(lanes)):
+        bits |= (lanes[i] & mask) << (i * T_bits)
+    return Vec(bits, width)
+
+
+def bytes_to_int(data):
+    x = 0
+    for i in range(0, len(data)):
+        x |= data[i] << (8 * i)
+    return x
+
+
+def int_to_bytes(x, nbytes):
+    return [(x >> (8 * i)) & 0xff for i in range(0, nbytes)]
+
+
+# An access outside of the memory a kernel may touch
+class Memory_Fault(Exception):
+    pass
+
+
+# The bytes a memory wrapper is run on. It is exactly what the kernel
+# may access (N elements, rounded up with "int aligned" / "extra
+# memory") so any other access is a fault
+class Memory():
+    def __init__(self, data):
+        self.data = list(data)
+
+    def check(self, offset, nbytes, what):
+        if offset < 0 or offset + nbytes > len(self.data):
+            raise Memory_Fault("{} bytes [{}, {}) of {}".format(
+                what, offset, offset + nbytes, len(self.data)))
+
+    def read(self, offset, nbytes):
+        self.check(offset, nbytes, "reads")
+        return self.data[offset:offset + nbytes]
+
+    def write(self, offset, data):
+        self.check(offset, len(data), "writes")
+        self.data[offset:offset + len(data)] = data
+
+
+# A typed pointer into a Memory, size is the bytes per element and
+# width the register width if it points to registers
+class Pointer():
+    def __init__(self, memory, offset, size, signed=False, width=None):
+        self.memory = memory
+        self.offset = offset
+        self.size = size
+        self.signed = signed
+        self.width = width
+
+    def __add__(self, i):
+        return Pointer(self.memory, self.offset + i * self.size, self.size,
+                       self.signed, self.width)
+
+    def read(self, nbytes, at=0):
+        return self.memory.read(self.offset + at, nbytes)
+
+    def write(self, data, at=0):
+        self.memory.write(self.offset + at, data)
+
+    def __getitem__(self, i):
+        x = bytes_to_int(self.read(self.size, i * self.size))
+        if self.width is not None:
+            return Vec(x, self.width)
+        if self.signed is True and (x >> (8 * self.size - 1)) != 0:
+            x -= (1 << (8 * self.size))
+        return x
+
+    def __setitem__(self, i, value):
+        if isinstance(value, Vec):
+            value = value.bits
+        self.write(int_to_bytes(value, self.size), i * self.size)
+
+    def cast(self, type_str):
+        width = vec_width(re.sub(r"^_aliasing_(m\d+)_$", r"__\1", type_str))
+        if width is not None:
+            return Pointer(self.memory, self.offset, int(width / 8), False,
+                           width)
+        m = re.match(r"^(u?)int(\d+)_t$", type_str)
+        if m is not None:
+            return Pointer(self.memory, self.offset, int(int(m.group(2)) / 8),
+                           m.group(1) == "")
+        # _aliasing_int16_t_ is a may_alias uint16_t
+        if type_str == "_aliasing_int16_t_":
+            return Pointer(self.memory, self.offset, 2)
+        if type_str == "void":
+            return Pointer(self.memory, self.offset, 1)
+        raise Interpreter_Unsupported("pointer cast to " + type_str)
+
+
+# register array + offset (multi register helpers sort v + i)
+class Array_Ref():
+    def __init__(self, array, offset):
+        self.array = array
+        self.offset = offset
+
+    def __add__(self, i):
+        return Array_Ref(self.array, self.offset + i)
+
+    def __getitem__(self, i):
+        return self.array[self.offset + i]
+
+    def __setitem__(self, i, value):
+        self.array[self.offset + i] = value
+
+
+# &variable, the vec functions of key / value kernels take pointers to
+# the registers and __builtin_memcpy copies through them
+class Variable_Ref():
+    def __init__(self, env, name):
+        self.env = env
+        self.name = name
+
+    def __getitem__(self, i):
+        if i != 0:
+            raise Interpreter_Unsupported("&{}[{}]".format(self.name, i))
+        return self.env[self.name]
+
+    def __setitem__(self, i, value):
+        if i != 0:
+            raise Interpreter_Unsupported("&{}[{}]".format(self.name, i))
+        self.env[self.name] = value
+
+    def read(self, nbytes, at=0):
+        value = self[at]
+        if isinstance(value, Vec):
+            value = value.bits
+        return int_to_bytes(value, nbytes)
+
+    def write(self, data, at=0):
+        value = self[at]
+        mask = (1 << (8 * len(data))) - 1
+        if isinstance(value, Vec):
+            self[at] = Vec((value.bits & ~mask) | bytes_to_int(data),
+                           value.width)
+        else:
+            self[at] = (value & ~mask) | bytes_to_int(data)
+
+
+# Applies fn to each 128 bit lane (the whole register for __m64)
+def per_lane(fn, T_bits, width, *vecs):
+    lane_bits = min(128, width)
+    out = []
+    for l in range(0, int(width / lane_bits)):
+        args = [
+            vec_of(v.chunks(lane_bits)[l:l + 1], lane_bits,
+                   lane_bits).lanes(T_bits) for v in vecs
+        ]
+        out += fn(*args)
+    return vec_of(out, T_bits, width)
+
+
+def rotate(x, r, T_bits):
+    mask = (1 << T_bits) - 1
+    r = r % T_bits
+    x &= mask
+    return ((x >> r) | (x << (T_bits - r))) & mask
+
+
+def vec_width(type_str):
+    if type_str == "__m64":
+        return 64
+    m = re.match(r"^__m(128|256|512)[id]?$", type_str)
+    if m is not None:
+        return int(m.group(1))
+    return None
+
+
+MM_CMPINT = {
+    "_MM_CMPINT_EQ": 0,
+    "_MM_CMPINT_LT": 1,
+    "_MM_CMPINT_LE": 2,
+    "_MM_CMPINT_FALSE": 3,
+    "_MM_CMPINT_NE": 4,
+    "_MM_CMPINT_NLT": 5,
+    "_MM_CMPINT_NLE": 6,
+    "_MM_CMPINT_TRUE": 7
+}
+
+
+def cmp_imm(x, y, imm):
+    return [x == y, x < y, x <= y, False, x != y, x >= y, x > y,
+            True][imm & 7]
+
+
+def interpret_intrinsic(name, args):
+    m = re.match(r"^_mm(\d*)_(\w+)$", name)
+    if m is None:
+        raise Interpreter_Unsupported(name)
+    width = 128
+    if m.group(1) != "":
+        width = int(m.group(1))
+    op = m.group(2)
+    if width == 128 and re.search(r"_(si64|p[iu]\d+)$", op) is not None:
+        width = 64
+
+    # Element type agnostic
+    m = re.match(r"^(cast|zext)(si\d+|ps|pd)_(si\d+|ps|pd)$", op)
+    if m is not None:
+        to_width = width
+        if m.group(3).startswith("si"):
+            to_width = int(m.group(3)[2:])
+        return Vec(args[0].bits, to_width)
+    m = re.match(r"^(and|andnot|or|xor)_(si\d+|ps|pd|epi32|epi64)$", op)
+    if m is not None:
+        a, b = args[0].bits, args[1].bits
+        res = {
+            "and": a & b,
+            "andnot": (~a) & b,
+            "or": a | b,
+            "xor": a ^ b
+        }[m.group(1)]
+        return Vec(res, width)
+    if re.match(r"^setzero_(si\d+|ps|pd)$", op) is not None:
+        return Vec(0, width)
+    m = re.match(r"^(load|loadu|store|storeu)_si(\d+)$", op)
+    if m is not None:
+        if m.group(1).startswith("load"):
+            return Vec(bytes_to_int(args[0].read(int(width / 8))), width)
+        args[0].write(int_to_bytes(args[1].bits, int(width / 8)))
+        return None
+    m = re.match(r"^(mask_)?shuffle_([if])(32x4|64x2)$", op)
+    if m is not None:
+        if m.group(1) is not None:
+            src, k, a, b, imm = args
+        else:
+            a, b, imm = args
+        nchunks = int(width / 128)
+        bits_per = 2 if nchunks == 4 else 1
+        sel = (1 << bits_per) - 1
+        out = []
+        for i in range(0, nchunks):
+            from_vec = a if i < nchunks / 2 else b
+            out.append(from_vec.chunks(128)[(imm >> (i * bits_per)) & sel])
+        res = vec_of(out, 128, width)
+        if m.group(1) is not None:
+            T = int(m.group(3)[:2])
+            res = vec_of([
+                x if (k >> i) & 1 else y for i, (x, y) in enumerate(
+                    zip(res.lanes(T), src.lanes(T)))
+            ], T, width)
+        return res
+    if op == "shuffle_ps" or op == "shuffle_pd":
+        a, b, imm = args
+        if op == "shuffle_ps":
+            return per_lane(
+                lambda x, y: [
+                    x[imm & 3], x[(imm >> 2) & 3], y[(imm >> 4) & 3], y[
+                        (imm >> 6) & 3]
+                ], 32, width, a, b)
+        out = []
+        for l in range(0, int(width / 128)):
+            x = a.lanes(64)[2 * l:2 * l + 2]
+            y = b.lanes(64)[2 * l:2 * l + 2]
+            out += [x[(imm >> (2 * l)) & 1], y[(imm >> (2 * l + 1)) & 1]]
+        return vec_of(out, 64, width)
+    if op == "permute2x128_si256":
+        a, b, imm = args
+        chunks = a.chunks(128) + b.chunks(128)
+        out = []
+        for h in range(0, 2):
+            ctrl = (imm >> (4 * h)) & 0xf
+            out.append(0 if ctrl & 0x8 else chunks[ctrl & 3])
+        return vec_of(out, 128, width)
+    m = re.match(r"^(bslli|bsrli|slli|srli)_si128$", op)
+    if m is not None:
+        a, imm = args
+        left = m.group(1).endswith("slli")
+        return per_lane(
+            lambda x: [(x[0] << (8 * imm)) if left else (x[0] >> (8 * imm))],
+            128, width, a)
+    m = re.match(r"^(extract|insert)[if](128|32x4|64x4|64x2)_(si256|epi32|epi64|si512)$", op)
+    if m is not None:
+        chunk = 256 if m.group(2) == "64x4" else 128
+        if m.group(1) == "extract":
+            a, imm = args
+            return Vec(a.chunks(chunk)[imm % int(a.width / chunk)], chunk)
+        a, b, imm = args
+        chunks = a.chunks(chunk)
+        chunks[imm % len(chunks)] = b.bits
+        return vec_of(chunks, chunk, width)
+    if op == "blend_ps" or op == "blend_pd":
+        a, b, imm = args
+        T = 32 if op == "blend_ps" else 64
+        return vec_of([
+            y if (imm >> i) & 1 else x
+            for i, (x, y) in enumerate(zip(a.lanes(T), b.lanes(T)))
+        ], T, width)
+
+    m = re.match(r"^(\w*?)_?(epi|epu|pi|pu)(8|16|32|64)x?(_mask)?$", op)
+    if m is None:
+        raise Interpreter_Unsupported(name)
+    op = m.group(1)
+    T = int(m.group(3))
+    signed = m.group(2) == "epi" or m.group(2) == "pi"
+    n = int(width / T)
+    to_mask = m.group(4) is not None
+
+    def elementwise(fn, *vecs):
+        return vec_of([fn(*x) for x in zip(*[v.lanes(T, signed) for v in vecs])],
+                      T, width)
+
+    def select(k, a, b):
+        return vec_of([
+            y if (k >> i) & 1 else x
+            for i, (x, y) in enumerate(zip(a.lanes(T), b.lanes(T)))
+        ], T, width)
+
+    def compare(fn, a, b):
+        res = [fn(x, y) for x, y in zip(a.lanes(T, signed), b.lanes(T, signed))]
+        if to_mask is True:
+            return sum([int(r) << i for i, r in enumerate(res)])
+        return vec_of([-1 if r else 0 for r in res], T, width)
+
+    fns = {
+        "min": min,
+        "max": max,
+        "add": lambda x, y: x + y,
+        "sub": lambda x, y: x - y
+    }
+    cmps = {
+        "cmpeq": lambda x, y: x == y,
+        "cmpgt": lambda x, y: x > y,
+        "cmplt": lambda x, y: x < y,
+        "cmpge": lambda x, y: x >= y,
+        "cmple": lambda x, y: x <= y,
+        "cmpneq": lambda x, y: x != y
+    }
+
+    # Masked memory accesses only touch the selected elements
+    def masked_load(src, k, ptr):
+        x = src.lanes(T)
+        for i in range(0, n):
+            if (k >> i) & 1:
+                x[i] = bytes_to_int(ptr.read(int(T / 8), i * int(T / 8)))
+        return vec_of(x, T, width)
+
+    def masked_store(ptr, k, v):
+        x = v.lanes(T)
+        for i in range(0, n):
+            if (k >> i) & 1:
+                ptr.write(int_to_bytes(x[i], int(T / 8)), i * int(T / 8))
+
+    def mask_of(v):
+        return sum([int(x < 0) << i for i, x in enumerate(v.lanes(T, True))])
+
+    if op == "mask_loadu" or op == "mask_load":
+        return masked_load(args[0], args[1], args[2])
+    if op == "maskz_loadu" or op == "maskz_load":
+        return masked_load(Vec(0, width), args[0], args[1])
+    if op == "maskload":
+        return masked_load(Vec(0, width), mask_of(args[1]), args[0])
+    if op == "mask_storeu" or op == "mask_store":
+        return masked_store(args[0], args[1], args[2])
+    if op == "maskstore":
+        return masked_store(args[0], mask_of(args[1]), args[2])
+    if op == "insert":
+        a, x, imm = args
+        lanes = a.lanes(T)
+        lanes[imm % n] = x
+        return vec_of(lanes, T, width)
+    if op == "extract":
+        a, imm = args
+        return a.lanes(T, T >= 32)[imm % n]
+
+    if op == "set":
+        return vec_of(list(reversed(args)), T, width)
+    if op == "setr":
+        return vec_of(list(args), T, width)
+    if op == "set1":
+        return vec_of([args[0]] * n, T, width)
+    if op in fns:
+        return elementwise(fns[op], args[0], args[1])
+    if op.startswith("mask_") and op[5:] in fns:
+        src, k, a, b = args
+        return select(k, src, elementwise(fns[op[5:]], a, b))
+    if op.startswith("maskz_") and op[6:] in fns:
+        k, a, b = args
+        return select(k, Vec(0, width), elementwise(fns[op[6:]], a, b))
+    if op in cmps:
+        return compare(cmps[op], args[0], args[1])
+    if op == "cmp" and to_mask is True:
+        return compare(lambda x, y: cmp_imm(x, y, args[2]), args[0], args[1])
+    if op == "blend":
+        a, b, imm = args
+        return select(sum([((imm >> (i % 8)) & 1) << i for i in range(0, n)]),
+                      a, b)
+    if op == "blendv":
+        a, b, mask = args
+        return select(
+            sum([int(x < 0) << i for i, x in enumerate(mask.lanes(T, True))]),
+            a, b)
+    if op == "mask_blend":
+        k, a, b = args
+        return select(k, a, b)
+    if op == "mask_mov":
+        src, k, a = args
+        return select(k, src, a)
+    if op == "maskz_mov":
+        k, a = args
+        return select(k, Vec(0, width), a)
+    if op == "shuffle" or op == "mask_shuffle":
+        if op == "mask_shuffle":
+            src, k, a, ctrl = args
+        else:
+            a, ctrl = args
+        if T == 8:
+            sel = 15 if width != 64 else 7
+            res = per_lane(
+                lambda x, c: [0 if c[i] & 0x80 else x[c[i] & sel]
+                              for i in range(0, len(x))], 8, width, a, ctrl)
+        elif T == 16:
+            res = vec_of([a.lanes(16)[(ctrl >> (2 * i)) & 3] for i in range(4)],
+                         16, width)
+        else:
+            res = per_lane(
+                lambda x: [x[(ctrl >> (2 * i)) & 3] for i in range(0, 4)], 32,
+                width, a)
+        if op == "mask_shuffle":
+            res = select(k, src, res)
+        return res
+    if op == "shufflelo" or op == "shufflehi":
+        a, imm = args
+        lo = op == "shufflelo"
+        return per_lane(
+            lambda x: ([x[(imm >> (2 * i)) & 3] for i in range(0, 4)] + x[4:])
+            if lo else (x[:4] + [x[4 + ((imm >> (2 * i)) & 3)]
+                                 for i in range(0, 4)]), 16, width, a)
+    if op == "permutexvar":
+        idx, a = args
+        x = a.lanes(T)
+        return vec_of([x[i % n] for i in idx.lanes(T)], T, width)
+    if op == "permutex2var":
+        a, idx, b = args
+        x = a.lanes(T) + b.lanes(T)
+        return vec_of([x[i % (2 * n)] for i in idx.lanes(T)], T, width)
+    if op == "permutevar8x32":
+        a, idx = args
+        x = a.lanes(32)
+        return vec_of([x[i & 7] for i in idx.lanes(32)], 32, width)
+    if op == "permute4x64" or op == "permutex":
+        a, imm = args
+        out = []
+        x = a.lanes(64)
+        for h in range(0, len(x), 4):
+            out += [x[h + ((imm >> (2 * i)) & 3)] for i in range(0, 4)]
+        return vec_of(out, 64, width)
+    if op == "alignr":
+        a, b, imm = args
+        if T == 8:
+            lane_bits = min(128, width)
+            return per_lane(
+                lambda x, y: [((x[0] << lane_bits | y[0]) >> (8 * imm))],
+                lane_bits, width, a, b)
+        x = b.lanes(T) + a.lanes(T)
+        shift = imm % n
+        return vec_of(x[shift:shift + n], T, width)
+    if op in ["ror", "rol", "rorv", "rolv"]:
+        a, r = args
+        rs = [r] * n
+        if op.endswith("v"):
+            rs = r.lanes(T)
+        right = op.startswith("ror")
+        return vec_of([
+            rotate(x, rr if right else (T - rr % T), T)
+            for x, rr in zip(a.lanes(T), rs)
+        ], T, width)
+    if op in ["slli", "srli", "srai"]:
+        a, imm = args
+        if op == "slli":
+            return elementwise(lambda x: x << imm if imm < T else 0, a)
+        if op == "srli":
+            return vec_of([x >> imm if imm < T else 0 for x in a.lanes(T)], T,
+                          width)
+        return vec_of([x >> min(imm, T - 1) for x in a.lanes(T, True)], T,
+                      width)
+    if op == "unpacklo" or op == "unpackhi":
+        a, b = args
+        half = int(min(128, width) / T / 2)
+        base = 0 if op == "unpacklo" else half
+        return per_lane(
+            lambda x, y: [z for i in range(base, base + half)
+                          for z in (x[i], y[i])], T, width, a, b)
+    raise Interpreter_Unsupported(name)
+
+
+class Kernel_Interpreter():
+    def __init__(self, source):
+        self.functions = {}
+        source = re.sub(r"/\*.*?\*/", "", source, flags=re.S)
+        lines = source.split("\n")
+        i = 0
+        while i < len(lines):
+            m = re.search(r"\b(\w+)\s*\(([^()]*)\)\s*\{\s*$", lines[i])
+            if m is None:
+                i += 1
+                continue
+            params = []
+            for param in m.group(2).split(","):
+                if param.strip() == "":
+                    continue
+                params.append((re.findall(r"\w+", param)[-1], "*" in param))
+            depth = lines[i].count("{") - lines[i].count("}")
+            body = []
+            i += 1
+            while i < len(lines) and depth > 0:
+                depth += lines[i].count("{") - lines[i].count("}")
+                if depth > 0 and lines[i].strip().startswith("#") is False:
+                    body.append(lines[i])
+                i += 1
+            self.functions[m.group(1)] = (params, [
+                s.strip() for s in " ".join(body).split(";") if s.strip() != ""
+            ])
+
+    def has(self, name):
+        return name in self.functions
+
+    def call(self, name, args):
+        params, body = self.functions[name]
+        err_assert(len(params) == len(args), "bad call of " + name)
+        env = {}
+        for (pname, _), arg in zip(params, args):
+            env[pname] = arg
+        for statement in body:
+            if re.match(r"^(if|for|while|do|switch)\b", statement) or "{" in statement:
+                raise Interpreter_Unsupported(statement.split()[0])
+            if re.match(r"^asm\b", statement):
+                self.asm(statement, env)
+                continue
+            m = re.match(r"^return\b(.*)$", statement)
+            if m is not None:
+                if m.group(1).strip() == "":
+                    return None
+                return self.eval(m.group(1), env)
+            m = re.match(
+                r"^(?:const\s+)?([A-Za-z_]\w*)\s+(?:const\s+)?([A-Za-z_]\w*)\s*(?:\[\s*(\d+)\s*\])?\s*(?:=\s*(.+))?$",
+                statement, re.S)
+            if m is not None:
+                if m.group(3) is not None:
+                    env[m.group(2)] = [None] * int(m.group(3))
+                elif m.group(4) is not None:
+                    env[m.group(2)] = self.eval(m.group(4), env)
+                else:
+                    width = vec_width(m.group(1))
+                    env[m.group(2)] = Vec(0, width) if width else 0
+                continue
+            # (*(pointer expression)) = value
+            m = re.match(r"^\(\s*\*(.+)\)\s*=(?!=)\s*(.+)$", statement, re.S)
+            if m is not None:
+                self.eval(m.group(1), env)[0] = self.eval(m.group(2), env)
+                continue
+            m = re.match(r"^(\*?)\s*(\w+)\s*(?:\[(.+?)\])?\s*=(?!=)\s*(.+)$",
+                         statement, re.S)
+            if m is not None:
+                value = self.eval(m.group(4), env)
+                if m.group(1) == "*":
+                    env[m.group(2)][0] = value
+                elif m.group(3) is not None:
+                    env[m.group(2)][self.eval(m.group(3), env)] = value
+                else:
+                    env[m.group(2)] = value
+                continue
+            self.eval(statement, env)
+        return None
+
+    # The partial loads with a memory operand blend (see
+    # SIMD_Mask_Load_ASM_*), they read the whole register
+    def asm(self, statement, env):
+        m = re.match(
+            r'^asm\s+volatile\s*\(\s*"(vpblendd|vpblendvb) %\[load_mask\], \(%\[arr\]\), %\[fill_v\], %\[fill_v\]\\n"\s*'
+            r':\s*\[ fill_v \] "\+x" \((\w+)\)\s*'
+            r':\s*\[ arr \] "r" \((.+?)\), \[ load_mask \] "[ix]" \((.+?)\)\s*:\s*\)$',
+            statement, re.S)
+        if m is None:
+            raise Interpreter_Unsupported("asm")
+        fill = env[m.group(2)]
+        data = self.eval(m.group(3), env).read(int(fill.width / 8))
+        mem = vec_of(data, 8, fill.width)
+        mask = self.eval(m.group(4), env)
+        if m.group(1) == "vpblendd":
+            env[m.group(2)] = interpret_intrinsic(
+                "_mm{}_blend_epi32".format(fill.width), [fill, mem, mask])
+        else:
+            env[m.group(2)] = interpret_intrinsic(
+                "_mm{}_blendv_epi8".format(fill.width), [fill, mem, mask])
+
+    def eval(self, expr, env):
+        self.tokens = re.findall(
+            r"0[xX][0-9a-fA-F]+[uUlL]*|\d+[uUlL]*|[A-Za-z_]\w*|<<|>>|[()\[\],*&|^~+\-]",
+            expr)
+        self.pos = 0
+        value = self.parse_binary(0, env)
+        if self.pos != len(self.tokens):
+            raise Interpreter_Unsupported(expr)
+        return value
+
+    def peek(self, offset=0):
+        if self.pos + offset < len(self.tokens):
+            return self.tokens[self.pos + offset]
+        return ""
+
+    def take(self, token=None):
+        tok = self.peek()
+        if token is not None and tok != token:
+            raise Interpreter_Unsupported("expected " + token)
+        self.pos += 1
+        return tok
+
+    def parse_binary(self, min_prec, env):
+        precs = {"|": 1, "^": 2, "&": 3, "<<": 4, ">>": 4, "+": 5, "-": 5,
+                 "*": 6}
+        lhs = self.parse_unary(env)
+        while self.peek() in precs and precs[self.peek()] > min_prec:
+            op = self.take()
+            rhs = self.parse_binary(precs[op], env)
+            # pointer arithmetic
+            if isinstance(lhs, list):
+                lhs = Array_Ref(lhs, 0)
+            if isinstance(lhs, (Pointer, Array_Ref)) and op == "+":
+                lhs = lhs + rhs
+                continue
+            if isinstance(lhs, int) is False or isinstance(rhs, int) is False:
+                raise Interpreter_Unsupported(op)
+            lhs = {
+                "|": lambda: lhs | rhs,
+                "^": lambda: lhs ^ rhs,
+                "&": lambda: lhs & rhs,
+                "<<": lambda: lhs << rhs,
+                ">>": lambda: lhs >> rhs,
+                "+": lambda: lhs + rhs,
+                "-": lambda: lhs - rhs,
+                "*": lambda: lhs * rhs
+            }[op]()
+        return lhs
+
+    def is_cast(self):
+        i = 1
+        while re.match(r"^[A-Za-z_]\w*$", self.peek(i)) or self.peek(i) == "*":
+            i += 1
+        if i == 1 or self.peek(i) != ")":
+            return False
+        tok = self.peek(1)
+        return tok.startswith("__m") or tok.startswith(
+            "_aliasing") or tok.endswith("_t") or tok in [
+            "const", "int", "unsigned", "long", "short", "char", "void",
+            "_MM_PERM_ENUM"
+        ]
+
+    def parse_unary(self, env):
+        tok = self.peek()
+        if tok == "-" or tok == "~":
+            self.take()
+            value = self.parse_unary(env)
+            return -value if tok == "-" else ~value
+        if tok == "*":
+            self.take()
+            return self.parse_unary(env)[0]
+        if tok == "&":
+            self.take()
+            name = self.take()
+            if name not in env:
+                raise Interpreter_Unsupported("&" + name)
+            return Variable_Ref(env, name)
+        if tok == "(":
+            if self.is_cast():
+                self.take()
+                type_toks = []
+                while self.peek() != ")":
+                    type_toks.append(self.take())
+                self.take(")")
+                return self.cast(type_toks, self.parse_unary(env))
+            self.take()
+            value = self.parse_binary(0, env)
+            self.take(")")
+            if self.peek() == "[":
+                self.take()
+                value = value[self.parse_binary(0, env)]
+                self.take("]")
+            return value
+        return self.parse_postfix(env)
+
+    def cast(self, type_toks, value):
+        if "*" in type_toks:
+            if isinstance(value, Pointer) is False:
+                raise Interpreter_Unsupported("pointer cast")
+            return value.cast(type_toks[0])
+        type_str = type_toks[-1]
+        width = vec_width(type_str)
+        if width is not None:
+            if isinstance(value, Vec):
+                return Vec(value.bits, width)
+            return Vec(value, width)
+        m = re.match(r"^(u?)int(\d+)_t$", type_str)
+        if m is not None:
+            T = int(m.group(2))
+            value &= (1 << T) - 1
+            if m.group(1) == "" and (value >> (T - 1)) != 0:
+                value -= (1 << T)
+        return value
+
+    def parse_postfix(self, env):
+        tok = self.take()
+        m = re.match(r"^(0[xX][0-9a-fA-F]+|\d+)[uUlL]*$", tok)
+        if m is not None:
+            return int(m.group(1), 0)
+        if re.match(r"^[A-Za-z_]\w*$", tok) is None:
+            raise Interpreter_Unsupported(tok)
+        if self.peek() == "(":
+            self.take()
+            args = []
+            while self.peek() != ")":
+                args.append(self.parse_binary(0, env))
+                if self.peek() == ",":
+                    self.take()
+            self.take(")")
+            if self.has(tok):
+                return self.call(tok, args)
+            if re.match(r"^(u?)int(\d+)_t$", tok) and len(args) == 1:
+                return self.cast([tok], args[0])
+            if tok == "__builtin_memcpy":
+                dst, src, nbytes = args
+                dst.write(src.read(nbytes))
+                return None
+            return interpret_intrinsic(tok, args)
+        if tok in env:
+            value = env[tok]
+            if self.peek() == "[":
+                self.take()
+                value = value[self.parse_binary(0, env)]
+                self.take("]")
+            return value
+        if tok in MM_CMPINT:
+            return MM_CMPINT[tok]
+        m = re.match(r"^_MM_PERM_([A-D]{4})$", tok)
+        if m is not None:
+            return sum([(ord(c) - ord("A")) << (2 * (3 - i))
+                        for i, c in enumerate(m.group(1))])
+        raise Interpreter_Unsupported(tok)
+
+
+# Bit x of lane j is lane j of 0-1 input x
+def zero_one_columns(nlanes, rand):
+    if nlanes <= VERIFY_EXHAUSTIVE_N:
+        total = 1 << nlanes
+        columns = []
+        for j in range(0, nlanes):
+            col = ((1 << (1 << j)) - 1) << (1 << j)
+            width = 1 << (j + 1)
+            while width < total:
+                col |= col << width
+                width *= 2
+            columns.append(col)
+        return columns, total, True
+    return [rand.getrandbits(VERIFY_SAMPLES)
+            for j in range(0, nlanes)], VERIFY_SAMPLES, False
+
+
+# Compare exchanges (lo, hi) of each layer of a perm array (lane 0
+# last, partner lanes must point at each other)
+def perm_layers(perm, sort_N):
+    layers = []
+    for i in range(0, len(perm), sort_N):
+        layer = []
+        for lane in range(0, sort_N):
+            partner = perm[i + (sort_N - 1) - lane]
+            err_assert(
+                perm[i + (sort_N - 1) - partner] == lane,
+                "verify: layer {} pairs lane {} with {} but not back".format(
+                    int(i / sort_N), lane, partner))
+            if partner > lane:
+                layer.append((lane, partner))
+        layers.append(layer)
+    return layers
+
+
+def apply_layers(columns, layers, offset=0):
+    for layer in layers:
+        for lo, hi in layer:
+            x = columns[offset + lo]
+            y = columns[offset + hi]
+            columns[offset + lo] = x & y
+            columns[offset + hi] = x | y
+
+
+class Verifier():
+    def __init__(self, builder):
+        self.builder = builder
+        self.N = builder.N
+        self.sort_type = builder.sort_type
+        self.cas_info = builder.cas_info
+        self.T_bits = 8 * self.sort_type.sizeof()
+        self.signed = self.sort_type.sign == Sign.SIGNED
+        self.rand = random.Random(self.N * 131 + self.T_bits)
+
+    def fail(self, what):
+        err_assert(
+            False, "verify: {}_{} {} (N = {}, {})".format(
+                self.builder.network_name, self.N, what, self.N,
+                self.sort_type.to_string()))
+
+    def run(self):
+        info = self.check_network()
+        for what, check in [("kernel", self.check_kernel),
+                            ("memory", self.check_memory)]:
+            try:
+                info += ", " + check()
+            except Interpreter_Unsupported as e:
+                info += ", {} not interpreted ({})".format(
+                    what,
+                    str(e).strip()[:40])
+        return info
+
+    ##################################################################
+    # Network (0-1 principle)
+
+    def check_network(self):
+        if VERTICAL is True:
+            nlanes = self.N
+        elif self.builder.multi_register is True:
+            nlanes = self.builder.network.nregs * self.builder.network.reg_N
+        else:
+            nlanes = sort_n(self.builder.network_N, self.sort_type.sizeof())
+
+        columns, total, exhaustive = zero_one_columns(self.N, self.rand)
+        full = (1 << total) - 1
+        # lanes past N are loaded with max
+        columns += [full] * (nlanes - self.N)
+
+        if VERTICAL is True:
+            apply_layers(columns, self.builder.network.layers)
+        elif self.builder.multi_register is True:
+            self.apply_multi_register(columns)
+        else:
+            layers = perm_layers(self.builder.network_pairs, nlanes)
+            if self.builder.did_scale_N is False:
+                for layer in layers:
+                    for lo, hi in layer:
+                        if lo < self.N and hi >= self.N:
+                            self.fail("compares lane {} with unloaded lane {}".
+                                      format(lo, hi))
+            apply_layers(columns, layers)
+
+        for j in range(0, self.N - 1):
+            bad = columns[j] & (columns[j + 1] ^ full)
+            if bad != 0:
+                x = (bad & -bad).bit_length() - 1
+                what = "input {}".format(x)
+                if exhaustive is True:
+                    what = "0-1 input [{}]".format(", ".join(
+                        [str((x >> k) & 1) for k in range(0, self.N)]))
+                self.fail("network doesn't sort {} (lanes {} > {})".format(
+                    what, j, j + 1))
+
+        if exhaustive is True:
+            return "0-1 all 2^{}".format(self.N)
+        return "0-1 {} random".format(total)
+
+    def apply_multi_register(self, columns):
+        network = self.builder.network
+        reg_N = network.reg_N
+        sort_layers = perm_layers(network.register_sort.network_pairs, reg_N)
+        merge_layers = perm_layers(network.merge_pairs, reg_N)
+
+        for r in range(0, network.nregs):
+            apply_layers(columns, sort_layers, r * reg_N)
+        for layers in network.get_merge_levels():
+            for layer in layers:
+                for lo, hi, reverse in layer:
+                    x = columns[lo * reg_N:(lo + 1) * reg_N]
+                    y = columns[hi * reg_N:(hi + 1) * reg_N]
+                    if reverse is True:
+                        y = list(reversed(y))
+                    for l in range(0, reg_N):
+                        columns[lo * reg_N + l] = x[l] & y[l]
+                        columns[hi * reg_N + l] = x[l] | y[l]
+            for r in range(0, network.nregs):
+                apply_layers(columns, merge_layers, r * reg_N)
+
+    ##################################################################
+    # Kernel (intrinsic interpreter)
+
+    def random_values(self, count):
+        lo = 0
+        hi = (1 << self.T_bits) - 1
+        if self.signed is True:
+            lo = -(1 << (self.T_bits - 1))
+            hi = (1 << (self.T_bits - 1)) - 1
+        mode = self.rand.randrange(0, 4)
+        if mode == 0:
+            return [self.rand.randrange(0, 2) for i in range(0, count)]
+        if mode == 1:
+            extremes = [x for x in [lo, lo + 1, -1, 0, 1, hi - 1, hi] if x >= lo]
+            return [self.rand.choice(extremes) for i in range(0, count)]
+        if mode == 2:
+            base = self.rand.randint(lo, hi - 3)
+            return [
+                base + self.rand.randrange(0, 4) for i in range(0, count)
+            ]
+        return [self.rand.randint(lo, hi) for i in range(0, count)]
+
+    def type_max(self):
+        if self.signed is True:
+            return (1 << (self.T_bits - 1)) - 1
+        return (1 << self.T_bits) - 1
+
+    def check_sorted(self, inputs, outputs):
+        if outputs != sorted(inputs):
+            self.fail("kernel sorted {} to {}".format(inputs, outputs))
+
+    def check_kernel(self):
+        cas_info = self.cas_info
+        cas_info.prepare_content()
+        source = cas_info.get_helpers() + cas_info.get_inner().replace(
+            "[FUNCNAME_VEC]", "verify_vec")
+        interpreter = Kernel_Interpreter(source)
+        width = 8 * cas_info.simd_type.sizeof()
+        lanes = int(width / self.T_bits)
+
+        if VERTICAL is True:
+            self.check_transpose(interpreter, width, lanes)
+            runs = max(1, int(VERIFY_KERNEL_RUNS / lanes))
+            for run in range(0, runs):
+                arrays = [self.random_values(self.N) for k in range(0, lanes)]
+                v = [
+                    vec_of([arrays[k][i] for k in range(0, lanes)],
+                           self.T_bits, width) for i in range(0, self.N)
+                ]
+                interpreter.call("verify_vec", [v])
+                for k in range(0, lanes):
+                    self.check_sorted(
+                        arrays[k],
+                        [v[i].lanes(self.T_bits, self.signed)[k]
+                         for i in range(0, self.N)])
+            return "kernel {} runs".format(runs * lanes)
+
+        nregs = cas_info.nregs
+        for run in range(0, VERIFY_KERNEL_RUNS):
+            values = self.random_values(self.N)
+            # unloaded lanes are garbage unless the network was scaled
+            fill = self.type_max()
+            if nregs == 1 and self.builder.did_scale_N is False:
+                fill = None
+            padded = values + [
+                self.rand.randint(0, (1 << self.T_bits) - 1)
+                if fill is None else fill
+                for i in range(self.N, nregs * lanes)
+            ]
+            v = [
+                vec_of(padded[r * lanes:(r + 1) * lanes], self.T_bits, width)
+                for r in range(0, nregs)
+            ]
+            if nregs != 1:
+                interpreter.call("verify_vec", [v])
+            elif cas_info.payload_type is not None:
+                p = [vec_of(list(range(0, lanes)), self.T_bits, width)]
+                interpreter.call("verify_vec", [v, p])
+                idx = p[0].lanes(self.T_bits)[:self.N]
+                if sorted(idx) != list(range(0, self.N)):
+                    self.fail("payload of {} is {}".format(values, idx))
+                keys = v[0].lanes(self.T_bits, self.signed)[:self.N]
+                if keys != [values[i] for i in idx]:
+                    self.fail("payload of {} is {}".format(values, idx))
+            else:
+                v = [interpreter.call("verify_vec", v)]
+                if isinstance(v[0], Vec) is False:
+                    self.fail("kernel doesn't return a register")
+            out = []
+            for reg in v:
+                out += reg.lanes(self.T_bits, self.signed)
+            self.check_sorted(values, out[:self.N])
+            self.check_untouched(padded, out, lanes)
+        return "kernel {} runs".format(VERIFY_KERNEL_RUNS)
+
+    # Without "Full Load & Store" of a non scaled network the lanes
+    # past N the store writes back must be what was loaded
+    def check_untouched(self, padded, out, lanes):
+        if self.cas_info.nregs != 1 or self.builder.did_scale_N is True:
+            return
+        stored = self.N
+        if EXTRA_MEMORY is True:
+            stored = lanes
+        elif INT_ALIGNED is True:
+            stored = int((self.N * self.sort_type.sizeof() + 3) / 4) * 4
+            stored = int(stored / self.sort_type.sizeof())
+        mask = (1 << self.T_bits) - 1
+        for i in range(self.N, min(stored, lanes)):
+            if (out[i] & mask) != (padded[i] & mask):
+                self.fail("kernel changed lane {} past N".format(i))
+
+    # The memory function (load, vec function, store) is run on a
+    # buffer of exactly the bytes it may access. Past the N elements it
+    # holds random bytes that must be unchanged after the sort, accesses
+    # outside of the buffer fail
+    def check_memory(self):
+        cas_info = self.cas_info
+        cas_info.prepare_content()
+        source = cas_info.get_helpers() + cas_info.get_inner(
+        ) + cas_info.get_wrapper()
+        source = source.replace("[FUNCNAME_VEC]", "verify_vec").replace(
+            "[FUNCNAME]", "verify")
+        interpreter = Kernel_Interpreter(source)
+
+        size = self.sort_type.sizeof()
+        nbytes = cas_info.get_memory_bytes()
+        allowed = nbytes
+        if EXTRA_MEMORY is True:
+            simd_bytes = cas_info.simd_type.sizeof()
+            allowed = int((nbytes + simd_bytes - 1) / simd_bytes) * simd_bytes
+        elif INT_ALIGNED is True:
+            allowed = int((nbytes + 3) / 4) * 4
+        count = int(nbytes / size)
+        nlanes = 1
+        if VERTICAL is True:
+            nlanes = int(count / self.N)
+
+        for run in range(0, VERIFY_MEMORY_RUNS):
+            values = []
+            for k in range(0, nlanes):
+                values += self.random_values(self.N)
+            data = []
+            for x in values:
+                data += int_to_bytes(x, size)
+            data += [
+                self.rand.randrange(0, 256) for i in range(nbytes, allowed)
+            ]
+            memory = Memory(data)
+            args = [Pointer(memory, 0, size, self.signed)]
+
+            payload = None
+            if cas_info.payload_type is not None:
+                # argsort indexes are never loaded, all canary
+                payload = [
+                    self.rand.randrange(0, 256) for i in range(0, allowed)
+                ]
+                payload_memory = Memory(payload)
+                args.append(Pointer(payload_memory, 0, size))
+
+            try:
+                interpreter.call("verify", args)
+            except Memory_Fault as e:
+                self.fail("memory function {} (may access {} bytes)".format(
+                    str(e), allowed))
+
+            out = Pointer(memory, 0, size, self.signed)
+            out = [out[i] for i in range(0, count)]
+            for k in range(0, nlanes):
+                self.check_sorted(values[k * self.N:(k + 1) * self.N],
+                                  out[k * self.N:(k + 1) * self.N])
+            if memory.data[nbytes:] != data[nbytes:]:
+                self.fail("memory function changed bytes past N")
+
+            if payload is not None:
+                p = Pointer(payload_memory, 0, size)
+                p = [p[i] for i in range(0, count)]
+                if PAYLOAD == "index":
+                    if sorted(p) != list(range(0, count)) or out != [
+                            values[i] for i in p
+                    ]:
+                        self.fail("memory function payload of {} is {}".format(
+                            values, p))
+                else:
+                    pairs = list(
+                        zip(values, [
+                            bytes_to_int(payload[i * size:(i + 1) * size])
+                            for i in range(0, count)
+                        ]))
+                    if sorted(pairs) != sorted(zip(out, p)):
+                        self.fail("memory function payload of {} is {}".format(
+                            values, p))
+                if payload_memory.data[nbytes:] != payload[nbytes:]:
+                    self.fail("memory function changed payload bytes past N")
+        return "memory {} runs".format(VERIFY_MEMORY_RUNS)
+
+    def check_transpose(self, interpreter, width, lanes):
+        name = self.cas_info.transpose
+        v = [
+            vec_of([i * lanes + k for k in range(0, lanes)], self.T_bits,
+                   width) for i in range(0, lanes)
+        ]
+        interpreter.call(name, [v])
+        for i in range(0, lanes):
+            got = v[i].lanes(self.T_bits)
+            want = [(k * lanes + i) & ((1 << self.T_bits) - 1)
+                    for k in range(0, lanes)]
+            if got != want:
+                self.fail("{} row {} is {}".format(name, i, got))
+
+
+######################################################################
+# Network Search
+
+# --search looks for a network that is cheap for this generator rather
+# than one with the fewest compare exchanges or the least depth. One
+# more compare exchange can win if it turns a lane crossing permute
+# into an in-lane shuffle. Candidates are grouped / permuted and have
+# their instructions selected like any kernel and are ranked the way
+# "best" ranks algorithms (perm / blend / load weights and depth, or
+# cycles with --uarch), then by lane crossing permutes, instructions
+# and compare exchanges.
+#
+# The search is a hill climb in the spirit of SorterHunter seeded with
+# every algorithm's network. A mutation drops compare exchanges, swaps
+# two neighbouring ones or puts a random in-lane layer in front. The
+# result is repaired by appending the compare exchange that fixes the
+# most out of order 0-1 outputs until all 2^N inputs sort, then
+# compare exchanges that never exchange are dropped. The 0-1 inputs
+# are bit-parallel (see Verification) so N is limited to
+# VERIFY_EXHAUSTIVE_N.
+######################################################################
+
+
+class Network_Search():
+    def __init__(self, N, sort_type, iterations):
+        err_assert(
+            N >= 2 and N <= VERIFY_EXHAUSTIVE_N,
+            "\"search\" needs 2 <= N <= {}".format(VERIFY_EXHAUSTIVE_N))
+        err_assert(
+            is_multi_register(N, sort_type) is False,
+            "\"search\" is only supported for single register sorts")
+        self.N = N
+        self.sort_type = sort_type
+        self.iterations = iterations
+        self.rand = random.Random(N * 131 + sort_type.sizeof())
+        self.inputs, total, _ = zero_one_columns(N, self.rand)
+        self.full = (1 << total) - 1
+        self.costs = {}
+
+    # Runs the network on every 0-1 input, dropping compare exchanges
+    # that never exchange. Returns the kept pairs and the outputs
+    def simulate(self, pairs):
+        columns = list(self.inputs)
+        kept = []
+        for i in range(0, len(pairs), 2):
+            lo, hi = pairs[i], pairs[i + 1]
+            x, y = columns[lo], columns[hi]
+            if x & (y ^ self.full) == 0:
+                continue
+            columns[lo] = x & y
+            columns[hi] = x | y
+            kept += [lo, hi]
+        return kept, columns
+
+    def sorted_outputs(self, columns):
+        for j in range(0, self.N - 1):
+            if columns[j] & (columns[j + 1] ^ self.full) != 0:
+                return False
+        return True
+
+    # Appends the compare exchange with the most out of order outputs
+    # (ties go to the closest lanes) until every output is sorted
+    def repair(self, pairs):
+        pairs, columns = self.simulate(pairs)
+        while self.sorted_outputs(columns) is False:
+            best = None
+            for lo in range(0, self.N):
+                for hi in range(lo + 1, self.N):
+                    swaps = (columns[lo] & (columns[hi] ^ self.full)).bit_count()
+                    if swaps != 0 and (best is None or
+                                       (swaps, lo - hi) > best[0]):
+                        best = ((swaps, lo - hi), lo, hi)
+            _, lo, hi = best
+            x, y = columns[lo], columns[hi]
+            columns[lo] = x & y
+            columns[hi] = x | y
+            pairs += [lo, hi]
+        return pairs
+
+    def mutate(self, pairs):
+        pairs = list(pairs)
+        ncas = int(len(pairs) / 2)
+        kind = self.rand.randrange(0, 3)
+        if kind == 0 or ncas < 2:
+            for k in range(0, min(ncas, self.rand.randint(1, 3))):
+                i = 2 * self.rand.randrange(0, int(len(pairs) / 2))
+                del pairs[i:i + 2]
+        elif kind == 1:
+            i = 2 * self.rand.randrange(0, ncas - 1)
+            pairs[i:i + 4] = pairs[i + 2:i + 4] + pairs[i:i + 2]
+        else:
+            lane_N = max(2, min(next_p2(self.N),
+                                int(16 / self.sort_type.sizeof())))
+            stride = 1 << self.rand.randrange(0, lane_N.bit_length() - 1)
+            layer = []
+            for lo in range(0, self.N):
+                hi = lo ^ stride
+                if hi > lo and hi < self.N:
+                    layer += [lo, hi]
+            pairs = layer + pairs
+        return self.repair(pairs)
+
+    # (ranking, lane crossing permutes, instructions, compare exchanges,
+    # depth)
+    def cost(self, pairs):
+        key = tuple(pairs)
+        if key in self.costs:
+            return self.costs[key]
+
+        transformer = Transform(self.N, False, self.sort_type, pairs)
+        transformer.group()
+        transformer.permutation()
+
+        header.reset()
+        cas_info = Compare_Exchange_Generator(
+            transformer.pairs, self.N, False,
+            self.sort_type).Generate_Instructions()
+        output = Output_Generator(copy.copy(header), cas_info, "minimum",
+                                  transformer.depth, self.N, self.N,
+                                  self.sort_type)
+        _, depth, instructions, blend_weight, perm_weight, load_weight, cycles = output.get_info(
+        )
+        weights = Weights(perm_weight, blend_weight, load_weight,
+                          instructions, depth, None, pairs, cycles)
+
+        sort_N = sort_n(self.N, self.sort_type.sizeof())
+        crossing = 0
+        for i in range(0, len(transformer.pairs), sort_N):
+            if in_same_lanes(16, self.sort_type.sizeof(),
+                             transformer.pairs[i:i + sort_N]) is False:
+                crossing += 1
+
+        cost = (weights.val(), crossing, instructions, int(len(pairs) / 2),
+                depth)
+        self.costs[key] = cost
+        return cost
+
+    def get_seeds(self):
+        seeds = []
+        for name in Algorithms(self.N).algorithms:
+            if name == "best" or (name == "minimum"
+                                  and self.N >= len(min_pairs())):
+                continue
+            algorithm = Algorithms(self.N).get_algorithm(name)
+            if algorithm.valid() is False:
+                continue
+            pairs, _ = self.simulate(list(algorithm.create_pairs()))
+            if len(pairs) != 0:
+                seeds.append((self.cost(pairs), name, pairs))
+        return sorted(seeds)
+
+    def run(self):
+        seeds = self.get_seeds()
+        best = seeds[0]
+        current = best[2]
+        stale = 0
+        for it in range(0, self.iterations):
+            candidate = self.mutate(current)
+            if self.cost(candidate) <= self.cost(current):
+                current = candidate
+            if self.cost(candidate) < best[0]:
+                best = (self.cost(candidate), "search", candidate)
+                stale = 0
+            else:
+                stale += 1
+            # restart from a random seed when stuck
+            if stale == 50:
+                current = self.rand.choice(seeds)[2]
+                stale = 0
+        return seeds, best
+
+    def cost_str(self, cost):
+        return "{} Compare Exchanges, Depth {}, {} Lane Crossing Permutes, Cost {}".format(
+            cost[3], cost[4], cost[1], cost[0])
+
+    def get(self):
+        seeds, best = self.run()
+        cost, name, pairs = best
+
+        lines = [
+            "/*",
+            " * Sorting Network For N = {}, with Depth = {}".format(
+                self.N, cost[4]),
+            " * Searched For {} ({}): {}".format(
+                self.sort_type.to_string(),
+                get_simd_type(self.N * self.sort_type.sizeof()).to_string(),
+                self.cost_str(cost))
+        ]
+        for seed_cost, seed_name, _ in seeds:
+            lines.append(" *     {:<10} : {}".format(seed_name,
+                                                    self.cost_str(seed_cost)))
+        if name != "search":
+            lines.append(" * Nothing Better Than {} Found".format(name))
+        lines += [
+            " */", "template<>",
+            "struct minimum_network<{}> {{".format(self.N),
+            "    using network = std::integer_sequence<uint32_t,",
+            "                                          // clang-format off"
+        ]
+        for i in range(0, len(pairs), 8):
+            row = ", ".join(["{:>2}".format(p) for p in pairs[i:i + 8]])
+            if i + 8 < len(pairs):
+                row += ","
+            lines.append(" " * 42 + row)
+        lines += [
+            "                                          // clang-format on",
+            "                                          >;", "};"
+        ]
+        return arr_to_str(lines)
+
+
+######################################################################
+# Bulk Export
+
+# Every (T, N) of each flag set is built in one process (sharing the
+# caches above) and written as one output. Kernels share the includes
+# and typedefs at the top and each (name, T) gets a dispatcher that
+# switches on N and returns 0 if there is no kernel for it.
+######################################################################
+
+
+class Bulk_Output_Generator():
+    def __init__(self, name):
+        self.name = name
+        self.header_info = Headers()
+        self.m64_alignment = 64
+        self.int16_alignment = 64
+        self.perf_notes = []
+        self.template_names = []
+        self.kernels = []
+        self.kernel_names = []
+        self.dispatchers = {}
+        self.entries = []
+        self.instruction_sets = []
+        self.skipped = []
+
+    def skip(self, sort_type, N, msg):
+        name = "{} N={}".format(sort_type.to_string(), N)
+        print("Warning: skipping {} in \"bulk\": {}".format(name, msg),
+              file=sys.stderr)
+        self.skipped.append(name)
+
+    def add(self, builder, dispatch_prefix):
+        full_output = Output_Generator(builder.header, builder.cas_info,
+                                       builder.network_name,
+                                       builder.network.depth,
+                                       builder.network_N, builder.N,
+                                       builder.sort_type)
+
+        sort_type = builder.sort_type
+        kernel_name = full_output.sort_to_str
+        if full_output.templated is True:
+            kernel_name = "{}<{}, {}>".format(full_output.sort_to_str,
+                                              sort_type.to_string(),
+                                              builder.N)
+            if full_output.sort_to_str not in self.template_names:
+                self.template_names.append(full_output.sort_to_str)
+        err_assert(
+            kernel_name not in self.kernel_names,
+            "duplicate kernel {} in \"bulk\" (use \"name\" to tell flag sets apart)"
+            .format(kernel_name))
+        self.kernel_names.append(kernel_name)
+
+        self.header_info.merge(builder.header)
+        self.m64_alignment = min(self.m64_alignment,
+                                 builder.header.m64_alignment(sort_type))
+        self.int16_alignment = min(self.int16_alignment,
+                                   builder.header.int16_alignment(sort_type))
+        self.perf_notes = full_output.perf_notes
+        if full_output.templated is False:
+            self.entries += full_output.get_entry_points()
+        for isa in builder.cas_info.get_instruction_sets():
+            if isa not in self.instruction_sets:
+                self.instruction_sets.append(isa)
+
+        kernel = full_output.get_info_comment()
+        kernel += "\n"
+        kernel += full_output.get_helpers()
+        if full_output.templated is True:
+            kernel += full_output.get_specialization_head()
+        kernel += full_output.get_content()
+        kernel += full_output.get_tail()
+        self.kernels.append(kernel)
+
+        sort_call = full_output.sort_to_str
+        if full_output.templated is True:
+            sort_call = kernel_name + "::sort"
+
+        sign = "s"
+        if sort_type.sign == Sign.UNSIGNED:
+            sign = "u"
+        dispatch_name = "{}_{}{}{}".format(dispatch_prefix, sort_type.sizeof(),
+                                           sign, full_output.name_postfix)
+
+        if dispatch_name not in self.dispatchers:
+            self.dispatchers[dispatch_name] = (sort_type,
+                                               full_output.payload_type, [])
+        self.dispatchers[dispatch_name][2].append((builder.N, sort_call))
+
+    def get_dispatcher(self, dispatch_name):
+        sort_type, payload_type, cases = self.dispatchers[dispatch_name]
+
+        payload_arg = ""
+        payload_call = ""
+        if payload_type is not None:
+            payload_arg = "{} * const vals, ".format(payload_type.to_string())
+            payload_call = ", vals"
+
+        dispatch = ""
+        dispatch += "/* Dispatch To SIMD Sort By N, Returns 0 If N Has No Kernel */"
+        dispatch += "\n"
+        dispatch += "static "
+        dispatch += "int inline __attribute__((always_inline)) {}({} * const arr, {}uint32_t n) {{".format(
+            dispatch_name, sort_type.to_string(), payload_arg)
+        dispatch += "\n"
+        dispatch += "switch (n) {"
+        dispatch += "\n"
+        for N, sort_call in sorted(cases):
+            dispatch += "case {}:".format(N)
+            dispatch += "\n"
+            dispatch += "{}(arr{});".format(sort_call, payload_call)
+            dispatch += "\n"
+            dispatch += "return 1;"
+            dispatch += "\n"
+        dispatch += "default:"
+        dispatch += "\n"
+        dispatch += "return 0;"
+        dispatch += "\n"
+        dispatch += "}"
+        dispatch += "\n"
+        dispatch += "}"
+        dispatch += "\n"
+        return dispatch
+
+    def get_dispatcher_entry_point(self, dispatch_name):
+        sort_type, payload_type, cases = self.dispatchers[dispatch_name]
+        params = ["{} * const arr".format(sort_type.to_string())]
+        if payload_type is not None:
+            params.append("{} * const vals".format(payload_type.to_string()))
+        params.append("uint32_t n")
+        return "int", dispatch_name, params
+
+    def get_info(self):
+        info = [
+            "Bulk Sorting Network Export:",
+            "\tKernels                          : {}".format(
+                len(self.kernels)),
+            "\tDispatchers                      : {}".format(
+                arr_to_padd_str(list(self.dispatchers.keys()),
+                                "\tDispatchers                      : "))
+        ]
+        if len(self.skipped) != 0:
+            info.append("\tSkipped (No Kernel)              : {}".format(
+                arr_to_padd_str(self.skipped,
+                                "\tSkipped (No Kernel)              : ")))
+        return info
+
+    def get_assembly(self):
+        entries = self.entries + [
+            self.get_dispatcher_entry_point(dispatch_name)
+            for dispatch_name in self.dispatchers
+        ]
+        asm = Assembly_Output(self.get(), self.header_info.get_includes(),
+                              entries, self.instruction_sets, self.get_info())
+        return asm.get()
+
+    def get(self):
+        bulk_info = self.get_info()
+
+        out = ""
+        out += "\n"
+        out += "/*"
+        out += "\n\n"
+        out += arr_to_str(bulk_info)
+        out += "\n\n"
+        out += arr_to_str(self.perf_notes)
+        out += "\n"
+        out += " */"
+        out += "\n\n"
+        out += "#ifndef _SIMD_SORT_BULK_{}_H_".format(self.name)
+        out += "\n"
+        out += "#define _SIMD_SORT_BULK_{}_H_".format(self.name)
+        out += "\n\n"
+        out += self.header_info.get_includes()
+        out += self.header_info.get_typedefs(self.m64_alignment,
+                                             self.int16_alignment)
+        out += "\n\n"
+        for template_name in self.template_names:
+            out += "template<typename T, uint32_t n>"
+            out += "\n"
+            out += "struct {};".format(template_name)
+            out += "\n\n"
+        for kernel in self.kernels:
+            out += kernel
+        for dispatch_name in self.dispatchers:
+            out += self.get_dispatcher(dispatch_name)
+            out += "\n\n"
+        out += "#endif"
+        out += "\n"
+        return out
+
+
+def parse_N_list(user_N):
+    Ns = []
+    try:
+        for field in user_N.split(","):
+            field = field.strip()
+            if "-" in field:
+                lo, hi = field.split("-", 1)
+                Ns += list(range(int(lo), int(hi) + 1))
+            else:
+                Ns.append(int(field))
+    except ValueError:
+        err_assert(False, "\"N\" flag not valid list of ints / ranges")
+    err_assert(len(Ns) != 0, "No \"N\" flag")
+    return Ns
+
+
+def get_user_types(args):
+    user_types = []
+    if args.type != "":
+        for user_T in args.type.split(","):
+            if Sort_Type(1, Sign.SIGNED).is_valid(user_T.strip()) is False:
+                user_types = []
+                break
+            user_types.append(Sort_Type(1, Sign.SIGNED).string_to_T(
+                user_T.strip()))
+
+    if len(user_types) != 0:
+        if args.size != "" or args.signed is not False or args.unsigned is not False:
+            print(
+                "Overriding \"signed\", \"unsigned\", and \"size\" flags with \"type\" flag"
+            )
+        return user_types
+
+    user_Size = args.size
+    err_assert(user_Size != "",
+               "\"size\" flag is required if \"type\" is not specified")
+    try:
+        user_Size = int(user_Size)
+    except ValueError:
+        err_assert(False, "\"size\" flag is not valid integer type")
+
+    if args.signed is True:
+        return [Sort_Type(user_Size, Sign.SIGNED)]
+    elif args.unsigned is True:
+        return [Sort_Type(user_Size, Sign.UNSIGNED)]
+    err_assert(False, "neither \"signed\" nor \"unsigned\" flag specified")
+
+
+UARCH_TABLES = {}
+
+
+# Sets the globals that change what is generated (as opposed to how it
+# is output). Called once per flag set in "bulk".
+def set_config(args):
     global INSTRUCTION_OPT
     global SIMD_RESTRICTIONS
     global ALIGNED_ACCESS
     global INT_ALIGNED
     global EXTRA_MEMORY
-    global DO_FORMAT
-    global CLANG_FORMAT_EXE
-    global USER_TYPE
+    global UARCH
     global SORT_FUNC_NAME
-    global TEMPLATED
-    global OUTFILE
-    global FMODE
+    global PAYLOAD
+    global VERTICAL
+    global BIAS_UNSIGNED
+    global NO_ZMM
 
-    args = parser.parse_args()
-
-    FMODE = args.fmode
-    OUTFILE = args.outfile
+    UARCH = None
+    if args.uarch != "":
+        if args.uarch not in UARCH_TABLES:
+            UARCH_TABLES[args.uarch] = Uarch_Table(args.uarch)
+        UARCH = UARCH_TABLES[args.uarch]
 
     SORT_FUNC_NAME = args.name
-    TEMPLATED = args.template
+    PAYLOAD = args.payload_type
+    VERTICAL = args.vertical
+    BIAS_UNSIGNED = args.bias_unsigned
+    NO_ZMM = args.no_zmm
 
     user_opt = args.optimization
     err_assert(user_opt == "space" or user_opt == "uop",
                "Invalid \"optimization\" flag")
-    user_aligned = args.aligned
-    user_extra_mem = args.extra_memory
-    user_Constraint = args.constraint
-    user_Int_Aligned = args.int_aligned
-    user_Clang_Format_EXE = args.clang_format
-    user_Format = args.no_format
 
     if user_opt == "space":
         INSTRUCTION_OPT = Optimization.SPACE
@@ -5195,22 +9222,187 @@ def main():
     else:
         err_assert(False, "have no idea wtf happened")
 
-    CLANG_FORMAT_EXE = user_Clang_Format_EXE
-    DO_FORMAT = user_Format
-
-    SIMD_RESTRICTIONS = user_Constraint
-    ALIGNED_ACCESS = user_aligned
+    SIMD_RESTRICTIONS = args.constraint
+    ALIGNED_ACCESS = args.aligned
 
     # It is impossible to fault with an aligned address
     if ALIGNED_ACCESS is True:
         EXTRA_MEMORY = True
     else:
-        EXTRA_MEMORY = user_extra_mem
+        EXTRA_MEMORY = args.extra_memory
 
-    INT_ALIGNED = user_Int_Aligned
+    INT_ALIGNED = args.int_aligned
     if EXTRA_MEMORY is True:
         INT_ALIGNED = True
 
+    err_assert(
+        Algorithms(0).valid_algorithm(args.algorithm) is True,
+        "\"algorithm\" flag doesn't match")
+
+
+def bulk_export(args):
+    global USER_TYPE
+    global SORT_FUNC_NAME
+    global BULK_KERNEL
+
+    flag_sets = [args]
+    if args.bulk != "":
+        flag_sets = []
+        try:
+            with open(args.bulk) as f:
+                for line in f:
+                    line = line.split("#")[0].strip()
+                    if line != "":
+                        flag_sets.append(parser.parse_args(shlex.split(line)))
+        except IOError:
+            err_assert(False,
+                       "Error reading \"bulk\" file: {}".format(args.bulk))
+        err_assert(len(flag_sets) != 0,
+                   "No flag sets in \"bulk\" file: {}".format(args.bulk))
+
+    bulk_name = args.name
+    if bulk_name == "":
+        bulk_name = "vsort"
+    bulk_output = Bulk_Output_Generator(bulk_name)
+
+    for flag_set in flag_sets:
+        set_config(flag_set)
+        user_name = SORT_FUNC_NAME
+        dispatch_prefix = user_name
+        if dispatch_prefix == "":
+            dispatch_prefix = "vsort"
+        for user_T in get_user_types(flag_set):
+            USER_TYPE = user_T
+            for user_N in parse_N_list(flag_set.N):
+                sign = "s"
+                if user_T.sign == Sign.UNSIGNED:
+                    sign = "u"
+                if PAYLOAD == "index":
+                    sign += "_arg"
+                elif PAYLOAD != "":
+                    sign += "_kv"
+                elif VERTICAL is True:
+                    sign += "_vertical"
+                if TEMPLATED is False and user_name != "":
+                    SORT_FUNC_NAME = "{}_{}_{}{}".format(
+                        user_name, user_N, user_T.sizeof(), sign)
+                # the dispatcher returns 0 for a skipped N
+                BULK_KERNEL = True
+                try:
+                    builder = Builder(user_N, user_T, flag_set.algorithm)
+                except Kernel_Error as e:
+                    bulk_output.skip(user_T, user_N, str(e))
+                    continue
+                finally:
+                    BULK_KERNEL = False
+                if VERIFY is True:
+                    builder.Verify()
+                bulk_output.add(builder, dispatch_prefix)
+
+    err_assert(
+        len(bulk_output.kernels) != 0,
+        "No kernels could be generated for \"bulk\" (skipped: {})".format(
+            arr_to_csv(bulk_output.skipped)))
+    return bulk_output
+
+
+def write_output(out, outfile=None):
+    if outfile is None:
+        outfile = OUTFILE
+    if outfile == "":
+        print(out)
+        return
+
+    mode = FMODE
+    if mode == "":
+        mode = "w+"
+    if mode != "a" and mode != "w" and mode != "w+" and mode != "a+":
+        err_assert(
+            False,
+            "\"fmode\": {} does not correspond to a valid file write mode flag"
+        )
+
+    try:
+        f = open(outfile, mode)
+        f.write(out)
+        f.flush()
+        f.close()
+    except IOError:
+        err_assert(False, "Error writing to \"outfile\": {}".format(outfile))
+
+
+######################################################################
+# Main()
+def main():
+    global DO_FORMAT
+    global CLANG_FORMAT_EXE
+    global USER_TYPE
+    global TEMPLATED
+    global OUTFILE
+    global FMODE
+    global MCA_CPUS
+    global LLVM_MCA_EXE
+    global COMPILER_EXE
+    global ASM_SYNTAX
+    global ASM_ALIGN
+    global ASM_VZEROUPPER
+    global BATCH
+    global VERIFY
+    global CONST_TABLE
+
+    args = parser.parse_args()
+
+    MCA_CPUS = [c.strip() for c in args.mca_cpus.split(",") if c.strip() != ""]
+    LLVM_MCA_EXE = args.llvm_mca
+    COMPILER_EXE = args.compiler
+
+    FMODE = args.fmode
+    OUTFILE = args.outfile
+
+    TEMPLATED = args.template
+    BATCH = args.batch
+    err_assert(BATCH >= 0, "\"batch\" must be positive")
+    VERIFY = args.verify
+    CONST_TABLE = args.const_table
+
+    CLANG_FORMAT_EXE = args.clang_format
+    DO_FORMAT = args.no_format
+
+    ASM_SYNTAX = args.asm
+    ASM_ALIGN = args.asm_align
+    ASM_VZEROUPPER = args.no_vzeroupper
+    asm_outfile = ""
+    if ASM_SYNTAX != "":
+        err_assert(ASM_SYNTAX == "att" or ASM_SYNTAX == "intel",
+                   "Invalid \"asm\" flag, either \"att\" or \"intel\"")
+        err_assert(ASM_ALIGN >= 0 and (ASM_ALIGN & (ASM_ALIGN - 1)) == 0,
+                   "\"asm-align\" must be a power of 2")
+        err_assert(TEMPLATED is False,
+                   "\"asm\" is not supported with \"template\"")
+        err_assert(args.mca is False, "\"asm\" is not supported with \"mca\"")
+        err_assert(OUTFILE != "", "\"asm\" requires \"outfile\"")
+        asm_outfile = os.path.splitext(OUTFILE)[0] + ".S"
+        err_assert(asm_outfile != OUTFILE,
+                   "\"outfile\" for \"asm\" can't end with .S")
+
+    if args.cache != "":
+        cache.load(args.cache)
+
+    if args.bulk is not None:
+        err_assert(args.mca is False,
+                   "\"mca\" is not supported with \"bulk\"")
+        bulk_output = bulk_export(args)
+        out = bulk_output.get()
+        cache.save()
+        if DO_FORMAT is True:
+            out = Output_Formatter(out).get_fmt_output()
+        write_output(out)
+        if asm_outfile != "":
+            write_output(bulk_output.get_assembly(), asm_outfile)
+        return
+
+    set_config(args)
+
     user_N = args.N
     try:
         err_assert(user_N != "", "No \"N\" flag")
@@ -5218,65 +9410,28 @@ def main():
     except ValueError:
         err_assert(False, "\"N\" flag not valid int type")
 
-    user_T = args.type
-    user_Size = args.size
-    user_Signed = args.signed
-    user_Unsigned = args.unsigned
-
-    set_T = False
-    if user_T != "":
-        if Sort_Type(1, Sign.SIGNED).is_valid(user_T) is True:
-            if user_Size != "" or user_Signed is not False or user_Unsigned is not False:
-                print(
-                    "Overriding \"signed\", \"unsigned\", and \"size\" flags with \"type\" flag"
-                )
-            set_T = True
-            user_T = Sort_Type(1, Sign.SIGNED).string_to_T(user_T)
-
-    if set_T is False:
-        err_assert(user_Size != "",
-                   "\"size\" flag is required if \"type\" is not specified")
-        try:
-            user_Size = int(user_Size)
-        except ValueError:
-            err_assert(False, "\"size\" flag is not valid integer type")
-
-        if user_Signed is True:
-            user_T = Sort_Type(user_Size, Sign.SIGNED)
-        elif user_Unsigned is True:
-            user_T = Sort_Type(user_Size, Sign.UNSIGNED)
-        else:
-            err_assert(False,
-                       "neither \"signed\" nor \"unsigned\" flag specified")
+    user_T = get_user_types(args)
+    err_assert(len(user_T) == 1, "Multiple types require \"bulk\"")
+    user_T = user_T[0]
     USER_TYPE = user_T
 
-    user_Algorithm = args.algorithm
-    err_assert(
-        Algorithms(0).valid_algorithm(user_Algorithm) is True,
-        "\"algorithm\" flag doesn't match")
+    if args.search != 0:
+        err_assert(args.search > 0, "\"search\" must be positive")
+        print(Network_Search(user_N, user_T, args.search).get())
+        cache.save()
+        return
 
-    network_builder = Builder(user_N, user_T, user_Algorithm)
+    network_builder = Builder(user_N, user_T, args.algorithm)
+    cache.save()
+    if VERIFY is True:
+        network_builder.Verify()
 
-    if OUTFILE == "":
-        print(network_builder.Build())
+    if args.mca is True:
+        print(network_builder.Report())
     else:
-        mode = FMODE
-        if mode == "":
-            mode = "w+"
-        if mode != "a" and mode != "w" and mode != "w+" and mode != "a+":
-            err_assert(
-                False,
-                "\"fmode\": {} does not correspond to a valid file write mode flag"
-            )
-
-        try:
-            f = open(OUTFILE, mode)
-            f.write(network_builder.Build())
-            f.flush()
-            f.close()
-        except IOError:
-            err_assert(False,
-                       "Error writing to \"outfile\": {}".format(OUTFILE))
+        write_output(network_builder.Build())
+        if asm_outfile != "":
+            write_output(network_builder.Assemble(), asm_outfile)
 
 
 ######################################################################
@@ -5298,8 +9453,10 @@ def min_pairs():
     minimum_pairs = [
         [],  # N = 0
         [],  # N = 1
-        [],  # N = 2
-        [],  # N = 3
+        # Sorting Network For N = 2, with Depth = 1
+        [0, 1],
+        # Sorting Network For N = 3, with Depth = 3
+        [1, 2, 0, 2, 0, 1],
         # Sorting Network For N = 4, with Depth = 3
         [0, 2, 1, 3, 0, 1, 2, 3, 1, 2],
         # Sorting Network For N = 5, with Depth = 5
@@ -4,14 +4,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
+#include <type_traits>
 
 
+// 8 registers of 64 bytes, the largest multi register sort
+#define SARR_BYTES 512
+
 template<typename T, uint32_t n>
 struct sarr {
     typedef uint32_t aliasing_u32 __attribute__((aligned(1), may_alias));
 
 
-    T arr[64 / sizeof(T)] __attribute__((aligned(64)));
+    T arr[SARR_BYTES / sizeof(T)] __attribute__((aligned(64)));
 
     void
     finit() {
@@ -54,59 +58,163 @@ struct sarr {
     void
     randomize() {
         aliasing_u32 * _arr = (aliasing_u32 *)arr;
-        for (uint32_t i = 0; i < (64 / sizeof(uint32_t)); ++i) {
+        for (uint32_t i = 0; i < (SARR_BYTES / sizeof(uint32_t)); ++i) {
             _arr[i] = rand();
         }
     }
 };
 
-#define TYPE      [TYPE]
-#define N         [N]
-#define SORT_NAME [SORT_NAME]
-
-template<typename T, uint32_t n>
-struct vsort;
-
-[SORT_IMPL]
-
-
 #define TSIZE 1000
-    void
-    test() {
-        sarr<TYPE, N> s1;
-        sarr<TYPE, N> s2;
 
-        s1.binit();
-        memcpy(s2.arr, s1.arr, 64);
+[SORT_IMPL]
 
-        std::sort(s1.arr, s1.arr + N);
-        SORT_NAME(s2.arr);
-        assert(!memcmp(s1.arr, s2.arr, 64));
 
-        s1.finit();
-        memcpy(s2.arr, s1.arr, 64);
+template<typename T, uint32_t n, typename sort_impl>
+int
+test(const char * name) {
+    sarr<T, n> s1;
+    sarr<T, n> s2;
 
-        std::sort(s1.arr, s1.arr + N);
-        SORT_NAME(s2.arr);
-        assert(!memcmp(s1.arr, s2.arr, 64));
+    for (uint32_t i = 0; i < TSIZE + 3; ++i) {
+        if (i == 0) {
+            s1.binit();
+        }
+        else if (i == 1) {
+            s1.finit();
+        }
+        else if (i == 2) {
+            s1.ninit();
+        }
+        else {
+            s1.randomize();
+        }
+        memcpy(s2.arr, s1.arr, SARR_BYTES);
 
-        s1.ninit();
-        memcpy(s2.arr, s1.arr, 64);
+        std::sort(s1.arr, s1.arr + n);
+        sort_impl::sort(s2.arr);
+        if (memcmp(s1.arr, s2.arr, SARR_BYTES)) {
+            fprintf(stderr, "Failed: %s\n", name);
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        std::sort(s1.arr, s1.arr + N);
-        SORT_NAME(s2.arr);
-        assert(!memcmp(s1.arr, s2.arr, 64));
+// Argsort kernels (--payload-type index). The keys have to be sorted,
+// idx has to be a permutation of [0, n) that sorts them and idx past n
+// must not be written
+template<typename T, uint32_t n, typename sort_impl>
+int
+test_arg(const char * name) {
+    typedef std::make_unsigned_t<T> idx_t;
+    sarr<T, n>     s0;
+    sarr<T, n>     s1;
+    sarr<T, n>     s2;
+    sarr<idx_t, n> idx;
+    sarr<idx_t, n> canary;
+    memset(canary.arr, 0xa5, SARR_BYTES);
+
+    for (uint32_t i = 0; i < TSIZE + 3; ++i) {
+        if (i == 0) {
+            s0.binit();
+        }
+        else if (i == 1) {
+            s0.finit();
+        }
+        else if (i == 2) {
+            s0.ninit();
+        }
+        else {
+            s0.randomize();
+        }
+        memcpy(s1.arr, s0.arr, SARR_BYTES);
+        memcpy(s2.arr, s0.arr, SARR_BYTES);
+        memcpy(idx.arr, canary.arr, SARR_BYTES);
+
+        std::sort(s1.arr, s1.arr + n);
+        sort_impl::sort(s2.arr, idx.arr);
+
+        int  bad      = memcmp(s1.arr, s2.arr, SARR_BYTES) != 0;
+        bool seen[n]  = { false };
+        for (uint32_t j = 0; j < n; ++j) {
+            const uint32_t k = idx.arr[j];
+            if (k >= n || seen[k] || s0.arr[k] != s2.arr[j]) {
+                bad = 1;
+                break;
+            }
+            seen[k] = true;
+        }
+        bad |= memcmp(idx.arr + n,
+                      canary.arr + n,
+                      SARR_BYTES - n * sizeof(T)) != 0;
+        if (bad) {
+            fprintf(stderr, "Failed: %s\n", name);
+            return 1;
+        }
+    }
+    return 0;
+}
 
-        for (uint32_t i = 0; i < TSIZE; ++i) {
-            s1.randomize();
-            memcpy(s2.arr, s1.arr, 64);
+// Batch kernels (--batch). count arrays stride elements apart (an odd
+// count so the loop after the interleaved one runs too), the elements
+// between them must not be written
+template<typename T, uint32_t n, typename sort_impl>
+int
+test_batch(const char * name) {
+    constexpr uint32_t count  = 5;
+    constexpr uint32_t stride = n + 3;
+    constexpr uint32_t total  = count * stride;
+    T *                s1     = (T *)malloc(total * sizeof(T));
+    T *                s2     = (T *)malloc(total * sizeof(T));
+
+    int failed = 0;
+    for (uint32_t i = 0; i < TSIZE && failed == 0; ++i) {
+        for (uint32_t j = 0; j < total; ++j) {
+            s1[j] = rand();
+        }
+        memcpy(s2, s1, total * sizeof(T));
+        for (uint32_t j = 0; j < count; ++j) {
+            std::sort(s1 + j * stride, s1 + j * stride + n);
+        }
+        sort_impl::sort_batch(s2, count, stride);
+        if (memcmp(s1, s2, total * sizeof(T))) {
+            fprintf(stderr, "Failed: %s\n", name);
+            failed = 1;
+        }
+    }
+    free(s1);
+    free(s2);
+    return failed;
+}
 
-            std::sort(s1.arr, s1.arr + N);
-            SORT_NAME(s2.arr);
-            assert(!memcmp(s1.arr, s2.arr, 64));
+// Vertical kernels (--vertical) sort W contiguous arrays of n, nothing
+// past them may be written
+template<typename T, uint32_t n, uint32_t W, typename sort_impl>
+int
+test_vertical(const char * name) {
+    constexpr uint32_t total = W * n + 64 / sizeof(T);
+    T                  s1[total] __attribute__((aligned(64)));
+    T                  s2[total] __attribute__((aligned(64)));
+
+    for (uint32_t i = 0; i < TSIZE; ++i) {
+        for (uint32_t j = 0; j < total; ++j) {
+            s1[j] = i < 2 ? (i == 0 ? j : total - j) : rand();
+        }
+        memcpy(s2, s1, sizeof(s1));
+        for (uint32_t j = 0; j < W; ++j) {
+            std::sort(s1 + j * n, s1 + (j + 1) * n);
+        }
+        sort_impl::sort(s2);
+        if (memcmp(s1, s2, sizeof(s1))) {
+            fprintf(stderr, "Failed: %s\n", name);
+            return 1;
         }
     }
+    return 0;
+}
 
 int main() {
-    test();
+    int failed = 0;
+[TESTS]
+    return failed;
 }
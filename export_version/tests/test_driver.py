@@ -4,13 +4,45 @@ import cpufeature
 import os
 import sys
 import signal
-from itertools import permutations
+import argparse
+import hashlib
+import shlex
+import shutil
+import subprocess
+import tempfile
+from concurrent.futures import ThreadPoolExecutor, as_completed
+from itertools import combinations
 
 print("Driver To Test SIMD Sorting Network Exporter")
 print("Default behavior is to run all possible configurations")
 print(
     "To manually run a single test case; pass the test case flags as commandline arguments"
 )
+
+parser = argparse.ArgumentParser(allow_abbrev=False)
+parser.add_argument("-j",
+                    "--jobs",
+                    action="store",
+                    type=int,
+                    default=os.cpu_count(),
+                    help="number of exports / compiles to run at once")
+parser.add_argument("--per-binary",
+                    action="store",
+                    type=int,
+                    default=32,
+                    help="number of kernels compiled into each test binary")
+parser.add_argument(
+    "--no-cache",
+    action="store_true",
+    default=False,
+    help="ignore exported kernels and test binaries from previous runs")
+parser.add_argument(
+    "--cache-dir",
+    action="store",
+    default=os.path.join(tempfile.gettempdir(), "vsort_export_tests"),
+    help="directory for exported kernels and test binaries kept between runs")
+args, manual_flags = parser.parse_known_args()
+
 types = [
     "uint8_t", "uint16_t", "uint32_t", "uint64_t", "int8_t", "int16_t", "int32_t", "int64_t"
 ]
@@ -26,27 +58,54 @@ for f in avx512_flags:
 if add_64 is True:
     max_b.append(64)
 
-manual_cmdline = ""
-for i in range(1, len(sys.argv)):
-    manual_cmdline += sys.argv[i]
-    if i != len(sys.argv) - 1:
-        manual_cmdline += " "
-
-use_manual_cmdline = len(sys.argv) > 1
+manual_cmdline = " ".join(manual_flags)
+use_manual_cmdline = len(manual_flags) > 0
 
 algorithms = ["bitonic", "oddeven", "bosenelson", "batcher", "minimum", "best"]
 
 extra_flags_ops = ["-O uop", "-i", "--aligned", "-e"]
 
-export_template_file = "export_template.cc"
-exporter_exe = "../export.py"
-test_dir = "export_tests"
-tmp_file = ".tmp"
+# argsort kernels only differ from key sorts in the payload load / store
+arg_flags = ["--payload-type index", "--payload-type index -e"]
+
+# Wrappers / code generation modes that don't change the network, so
+# like arg_flags they are only run with "best"
+batch_flags = ["--batch", "--batch 3 -e"]
+vertical_flags = ["--vertical", "--vertical -e"]
+const_table_flags = ["--const-table", "--const-table -i"]
+# Only changes uint64_t kernels
+bias_flags = ["--bias-unsigned"]
+# Only changes kernels that would use zmm registers
+no_zmm_flags = ["--no-zmm"]
+
+# Multi register sorts (N past one register, up to 8 registers) are
+# slow to export so they get a few N per type and two networks
+multi_algorithms = ["bitonic", "best"]
+multi_flags = ["", "--const-table"]
+
+
+def get_multi_N(W):
+    return [W + 1, 3 * W - 1, 5 * W + 1, 8 * W]
+
+
+script_dir = os.path.dirname(os.path.realpath(__file__))
+export_template_file = os.path.join(script_dir, "export_template.cc")
+exporter_exe = os.path.join(script_dir, "..", "export.py")
+
+compiler = "g++"
+compile_flags = ["-O3", "-std=c++17", "-march=native", "-mtune=native"]
+
+# Exported kernels are keyed by a hash of export.py, the machine's
+# instruction sets (export.py picks instructions from them) and their
+# flags. Test binaries by a hash of the compiler (version, which
+# executable and what -march=native resolves to) and their source. Both
+# are reused across runs
+cache_dir = args.cache_dir
 
 
 def sig_exit(signum, empty):
     print("Exiting on Signal({})".format(str(signum)))
-    sys.exit(-1)
+    os._exit(-1)
 
 
 def arr_to_args(arr):
@@ -57,111 +116,252 @@ def arr_to_args(arr):
     return out
 
 
+# Flag order doesn't change the kernel so only combinations are run
 def get_flags(foptions):
     p = []
     for i in range(1, len(foptions)):
-        f_tuple = permutations(foptions, i)
+        f_tuple = combinations(foptions, i)
         for f in f_tuple:
             p.append(arr_to_args(list(f)))
 
     return p
 
 
-extra_flags = get_flags(extra_flags_ops)
-extra_flags.insert(0, "")
-
-signal.signal(signal.SIGINT, sig_exit)
-
-for max_bytes in max_b:
-    for i in range(0, len(types)):
-        min_N = max(4, int(4 / sizes[i]))
-        max_N = int(max_bytes / sizes[i]) + 1
-        for n in range(min_N, max_N):
-            for a in algorithms:
-                if a == "minimum" and n >= 32:
-                    continue
-                for f in extra_flags:
-                    tmp_file_full = "{}/{}".format(test_dir, tmp_file)
-                    os.system("mkdir -p {}".format(test_dir))
-                    os.system("rm -f " + tmp_file_full)
-
-                    cmd_flags = ""
-                    cmd = "./{} {} > " + tmp_file_full
-                    if use_manual_cmdline is True:
-                        cmd_flags = manual_cmdline
-                    elif max_bytes == 32:
-                        cmd_flags = "-N {} -T {} {} -c AVX512 --algorithm {}".format(
-                            n, types[i], f, a)
-                    else:
-                        cmd_flags = "-N {} -T {} {} --algorithm {}".format(
-                            n, types[i], f, a)
-
-                    cmd_flags += " --template "
-                    cmd = cmd.format(exporter_exe, cmd_flags)
-
-                    running = "Running: {}".format(cmd_flags)
-                    print(running, end="", flush=True)
-                    os.system(cmd)
-
-                    call_N = 0
-                    true_N = 0
-                    true_alg = ""
-                    true_T = ""
-                    sort_impl = ""
-                    for lines in open(tmp_file_full):
-                        if "Sort Size" in lines and ":" in lines and "Scaled" not in lines:
-                            tmp = lines.split()
-                            true_N = int(tmp[len(tmp) - 1])
-                        if "Sort Size" in lines and ":" in lines and "Scaled" in lines:
-                            tmp = lines.split()
-                            call_N = int(tmp[len(tmp) - 1])
-                        if "Network Generation Algorithm" in lines and ":" in lines:
-                            tmp = lines.split()
-                            true_alg = tmp[len(tmp) - 1]
-                        if "Underlying Sort Type" in lines and ":" in lines:
-                            tmp = lines.split()
-                            true_T = tmp[len(tmp) - 1]
-
-                        sort_impl += lines
-                    if call_N == 0:
-                        call_N = true_N
-
-                    export_driver_impl = ""
-                    for lines in open(export_template_file):
-                        export_driver_impl += lines
-
-                    export_driver_impl = export_driver_impl.replace(
-                        "[SORT_IMPL]", sort_impl)
-                    export_driver_impl = export_driver_impl.replace(
-                        "[TYPE]", true_T)
-                    export_driver_impl = export_driver_impl.replace(
-                        "[N]", str(true_N))
-
-                    func_name = "{}_{}_{}".format(true_alg, str(call_N),
-                                                  true_T)
-
-                    sname = cmd_flags.replace("--",
-                                              "-").replace(" -", "-").replace(
-                                                  " ", "_").replace("-", "_")
-
-                    export_driver_impl = export_driver_impl.replace(
-                        "[SORT_NAME]", "vsort<{}, {}>::sort".format("TYPE", "N"))
-
-                    fname = test_dir + "/" + sname + ".cc"
-                    f = open(fname, "w+")
-                    f.write(export_driver_impl)
-                    f.close()
-
-                    if os.system(
-                            "g++ -O3 -std=c++17 -march=native -mtune=native {} -o export_exe"
-                            .format(fname)) != 0:
-                        print("\nError Building " + sname)
-                        sys.exit(-1)
-                    if os.system("./export_exe") != 0:
-                        print("\nError Running " + sname)
-                        sys.exit(-1)
-                    print("- Passed".rjust(88 - len(running)), flush=True)
-
-                    os.system("rm -f export_exe")
-                    if use_manual_cmdline is True:
-                        sys.exit(0)
+def get_configs():
+    if use_manual_cmdline is True:
+        return [manual_cmdline]
+
+    extra_flags = get_flags(extra_flags_ops)
+    extra_flags.insert(0, "")
+
+    configs = []
+    for max_bytes in max_b:
+        constraint = ""
+        if max_bytes == 32:
+            constraint = "-c AVX512 "
+        for i in range(0, len(types)):
+            best_flags = (extra_flags + arg_flags + batch_flags +
+                          vertical_flags + const_table_flags)
+            if types[i] == "uint64_t":
+                best_flags = best_flags + bias_flags
+            if max_bytes == 64:
+                best_flags = best_flags + no_zmm_flags
+
+            min_N = max(4, int(4 / sizes[i]))
+            max_N = int(max_bytes / sizes[i]) + 1
+            for n in range(min_N, max_N):
+                for a in algorithms:
+                    if a == "minimum" and n >= 32:
+                        continue
+                    flags = extra_flags
+                    if a == "best":
+                        flags = best_flags
+                    for f in flags:
+                        configs.append("-N {} -T {} {} {}--algorithm {}".format(
+                            n, types[i], f, constraint, a))
+
+            for n in get_multi_N(int(max_bytes / sizes[i])):
+                for a in multi_algorithms:
+                    for f in multi_flags:
+                        configs.append("-N {} -T {} {} {}--algorithm {}".format(
+                            n, types[i], f, constraint, a))
+    return configs
+
+
+def hash_str(s):
+    return hashlib.sha256(s.encode("utf-8")).hexdigest()
+
+
+# Writes through a unique temporary so concurrent jobs never see a
+# partial file
+def write_file(path, content):
+    tmp_path = "{}.{}.tmp".format(path, os.getpid())
+    with open(tmp_path, "w+") as f:
+        f.write(content)
+    os.replace(tmp_path, path)
+
+
+def read_file(path):
+    with open(path) as f:
+        return f.read()
+
+
+def get_exporter_id():
+    return read_file(exporter_exe) + repr(
+        sorted(cpufeature.CPUFeature.items(), key=lambda f: f[0]))
+
+
+def get_compiler_id():
+    version = subprocess.run([compiler, "--version"],
+                             stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT)
+    # The cc1plus line of -v has the target features -march=native
+    # resolved to
+    target = subprocess.run([compiler] + compile_flags +
+                            ["-E", "-v", "-x", "c++", os.devnull],
+                            stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    target_lines = [
+        line for line in target.stdout.decode("utf-8", "ignore").split("\n")
+        if "cc1plus" in line
+    ]
+    return "{}\n{}\n{}".format(
+        str(shutil.which(compiler)),
+        version.stdout.decode("utf-8", "ignore"), "\n".join(target_lines))
+
+
+class Kernel():
+    def __init__(self, cmd_flags, exporter_hash):
+        self.cmd_flags = cmd_flags
+        self.key = hash_str(exporter_hash + cmd_flags)[:24]
+        self.name = "k_" + self.key
+        self.impl = ""
+        self.true_N = 0
+        self.true_T = ""
+        self.vertical_W = 0
+        self.error = None
+
+    def export(self):
+        cache_file = os.path.join(cache_dir, self.key + ".h")
+        if args.no_cache is False and os.path.exists(cache_file):
+            self.impl = read_file(cache_file)
+        else:
+            cmd = [sys.executable, exporter_exe] + shlex.split(
+                self.cmd_flags) + ["--template", "--name", self.name]
+            proc = subprocess.run(cmd,
+                                  stdout=subprocess.PIPE,
+                                  stderr=subprocess.STDOUT)
+            self.impl = proc.stdout.decode("utf-8", "ignore")
+            if proc.returncode != 0 or "Error" in self.impl:
+                self.error = "Error Exporting\n" + self.impl
+                return self
+            write_file(cache_file, self.impl)
+
+        for lines in self.impl.split("\n"):
+            if "Sort Size" in lines and ":" in lines and "Scaled" not in lines:
+                tmp = lines.split()
+                self.true_N = int(tmp[len(tmp) - 1])
+            if "Underlying Sort Type" in lines and ":" in lines:
+                tmp = lines.split()
+                self.true_T = tmp[len(tmp) - 1]
+            if "Arrays Sorted (Vertical)" in lines and ":" in lines:
+                tmp = lines.split()
+                self.vertical_W = int(tmp[len(tmp) - 1])
+        return self
+
+    def get_test(self):
+        test = "test"
+        test_args = "{}, {}".format(self.true_T, self.true_N)
+        if "--payload-type index" in self.cmd_flags:
+            test = "test_arg"
+        elif "--batch" in self.cmd_flags:
+            test = "test_batch"
+        elif "--vertical" in self.cmd_flags:
+            test = "test_vertical"
+            test_args += ", {}".format(self.vertical_W)
+        return "    failed |= {}<{}, {}<{}, {}>>(\"{}\");\n".format(
+            test, test_args, self.name, self.true_T, self.true_N, self.name)
+
+
+# Compiles (unless cached) and runs one binary testing all kernels.
+# Returns [(kernel, error)]
+def run_batch(kernels, template, compiler_hash):
+    sort_impl = ""
+    tests = ""
+    for k in kernels:
+        sort_impl += k.impl
+        tests += k.get_test()
+    src = template.replace("[SORT_IMPL]", sort_impl).replace("[TESTS]", tests)
+
+    src_hash = hash_str(compiler_hash + src)[:24]
+    exe = os.path.join(cache_dir, src_hash)
+    if args.no_cache is True or os.path.exists(exe) is False:
+        fname = exe + ".cc"
+        write_file(fname, src)
+        tmp_exe = "{}.{}.{}.tmp".format(exe, os.getpid(), id(kernels))
+        proc = subprocess.run([compiler] + compile_flags +
+                              [fname, "-o", tmp_exe],
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT)
+        if proc.returncode != 0:
+            return [(k, "Error Building\n" +
+                     proc.stdout.decode("utf-8", "ignore")) for k in kernels]
+        os.replace(tmp_exe, exe)
+        os.remove(fname)
+
+    proc = subprocess.run([exe], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if proc.returncode == 0:
+        return []
+    out = proc.stderr.decode("utf-8", "ignore")
+    failed = [k for k in kernels if "Failed: {}\n".format(k.name) in out]
+    if len(failed) == 0:
+        # crashed before reporting, any of them could be at fault
+        failed = kernels
+    return [(k, "Error Running\n" + out) for k in failed]
+
+
+# A batch that fails as a whole (doesn't build / crashes) is split
+# into single kernel binaries to find which kernels are broken
+def test_batch(kernels, template, compiler_hash):
+    errors = run_batch(kernels, template, compiler_hash)
+    if len(errors) <= 1 or len(kernels) == 1:
+        return errors
+    if len(errors) != len(kernels):
+        return errors
+    errors = []
+    for k in kernels:
+        errors += run_batch([k], template, compiler_hash)
+    return errors
+
+
+def main():
+    signal.signal(signal.SIGINT, sig_exit)
+    os.makedirs(cache_dir, exist_ok=True)
+
+    exporter_hash = hash_str(get_exporter_id())
+    compiler_hash = hash_str(get_compiler_id())
+    template = read_file(export_template_file)
+
+    kernels = [Kernel(c, exporter_hash) for c in get_configs()]
+    print("Exporting {} kernels ({} jobs)".format(len(kernels), args.jobs),
+          flush=True)
+
+    failures = []
+    with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        exported = []
+        for done, job in enumerate(
+                as_completed([pool.submit(k.export) for k in kernels])):
+            k = job.result()
+            if k.error is not None:
+                failures.append((k, k.error))
+                print("Failed: {}".format(k.cmd_flags), flush=True)
+            else:
+                exported.append(k)
+            if (done + 1) % 100 == 0:
+                print("Exported {} / {}".format(done + 1, len(kernels)),
+                      flush=True)
+
+        exported.sort(key=lambda k: k.key)
+        per_binary = max(1, args.per_binary)
+        batches = [
+            exported[i:i + per_binary]
+            for i in range(0, len(exported), per_binary)
+        ]
+        jobs = [pool.submit(test_batch, b, template, compiler_hash) for b in batches]
+        for done, job in enumerate(as_completed(jobs)):
+            errors = job.result()
+            for k, error in errors:
+                print("Failed: {}".format(k.cmd_flags), flush=True)
+            failures += errors
+            print("Tested {} / {} binaries".format(done + 1, len(batches)),
+                  flush=True)
+
+    for k, error in failures:
+        print("\n{}: {}\n{}".format(error.split("\n")[0], k.cmd_flags,
+                                    "\n".join(error.split("\n")[1:])))
+    print("{} / {} Passed".format(len(kernels) - len(failures), len(kernels)))
+    if len(failures) != 0:
+        sys.exit(-1)
+
+
+main()
@@ -3,6 +3,7 @@
 
 #include <immintrin.h>
 #include <stdint.h>
+#include <type_traits>
 #include <utility>
 
 #include <util/constexpr_util.h>
@@ -77,6 +78,43 @@ struct vec_types {
 };
 
 
+// Control vectors (permute / blend masks) outside of a network's stages
+// (merges, partial loads) are loaded from one aligned table per distinct
+// vector instead of being built with _mm*_set_epi*. Each is a single load
+// that never straddles a cache line. A network's stages load from its
+// network_constants instead. e is in _mm*_set_epi* order (last element
+// first).
+template<uint32_t size, uint32_t vec_size, typename seq, uint32_t... e>
+struct constant_table_impl;
+
+template<uint32_t size, uint32_t vec_size, uint32_t... seq, uint32_t... e>
+struct constant_table_impl<size,
+                           vec_size,
+                           std::integer_sequence<uint32_t, seq...>,
+                           e...> {
+    using elem_t = std::conditional_t<
+        size == sizeof(uint8_t),
+        uint8_t,
+        std::conditional_t<
+            size == sizeof(uint16_t),
+            uint16_t,
+            std::conditional_t<size == sizeof(uint32_t), uint32_t, uint64_t>>>;
+
+    static constexpr uint32_t n         = sizeof...(e);
+    static constexpr uint32_t _e[n]     = { static_cast<uint32_t>(e)... };
+    alignas(vec_size) static constexpr elem_t values[n] = {
+        static_cast<elem_t>(_e[(n - 1) - seq])...
+    };
+};
+
+template<uint32_t size, uint32_t vec_size, uint32_t... e>
+using constant_table =
+    constant_table_impl<size,
+                        vec_size,
+                        std::make_integer_sequence<uint32_t, sizeof...(e)>,
+                        e...>;
+
+
 template<typename T, uint32_t n, uint32_t... e>
 struct vector_ops_support_impl {
     static constexpr uint64_t shuffle_as_epi32_flag = (1UL) << 63;
@@ -157,6 +195,21 @@ struct vector_ops_support_impl {
         return blend_mask;
     }
 
+    // one bit per element (for AVX512 mask registers) set for the lanes
+    // that take the min of a compare exchange
+    static constexpr uint64_t
+    build_min_mask() {
+        constexpr uint32_t perm[n] = { static_cast<uint32_t>(e)... };
+
+        uint64_t min_mask = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (perm[(n - 1) - i] > i) {
+                min_mask |= ((1UL) << i);
+            }
+        }
+        return min_mask;
+    }
+
     template<uint64_t blend_mask, uint32_t... seq>
     static constexpr decltype(auto)
     build_blend_vec_initializer_kernel(
@@ -246,6 +299,67 @@ struct vector_ops_support_impl {
     }
 
 
+    template<uint32_t... shrunk_e>
+    static constexpr uint64_t
+    build_shuffle_mask_as_epi16_impl_wrapper(
+        std::integer_sequence<uint32_t, shrunk_e...> _shrunk_e) {
+        constexpr uint64_t shuffle_mask_lo =
+            build_shuffle_mask_impl<4, 4, 8, shrunk_e...>();
+        constexpr uint64_t shuffle_mask_hi =
+            build_shuffle_mask_impl<0, 4, 8, shrunk_e...>();
+        if constexpr (shuffle_mask_lo == 0 || shuffle_mask_hi == 0) {
+            return 0;
+        }
+        else {
+            return shuffle_mask_lo | (shuffle_mask_hi << 32);
+        }
+    }
+
+    // byte permutations that move aligned pairs of bytes together are
+    // pshuflw / pshufhw on the 16 bit view (no control vector)
+    static constexpr uint64_t
+    build_shuffle_mask_as_epi16() {
+        if constexpr (sizeof(T) != sizeof(uint8_t) ||
+                      n < sizeof(__m128i)) {
+            return 0;
+        }
+        else {
+            constexpr uint32_t perms[n] = { static_cast<uint32_t>(e)... };
+            for (uint32_t i = 0; i < n; i += 2) {
+                if ((perms[i] % 2) != 1 || perms[i + 1] != (perms[i] - 1)) {
+                    return 0;
+                }
+            }
+            return build_shuffle_mask_as_epi16_impl_wrapper(
+                scale_seq<T, uint16_t>());
+        }
+    }
+
+    // r * bits per element if every aligned group of group_bytes is
+    // rotated by r elements (element i of a group takes element
+    // (i + r) % group_n of it). A right rotate of the group by that many
+    // bits (vprord / vprorq or alignr for a 16 byte group). Otherwise 0
+    template<uint32_t group_bytes>
+    static constexpr uint32_t
+    rotate_bits() {
+        constexpr uint32_t group_n = group_bytes / sizeof(T);
+        if constexpr (group_n < 2 || group_n > n) {
+            return 0;
+        }
+        else {
+            constexpr uint32_t perms[n] = { static_cast<uint32_t>(e)... };
+
+            const uint32_t r = perms[n - 1] % group_n;
+            for (uint32_t i = 0; i < n; ++i) {
+                const uint32_t base = i - (i % group_n);
+                if (perms[(n - 1) - i] != base + ((i + r) % group_n)) {
+                    return 0;
+                }
+            }
+            return r * 8 * sizeof(T);
+        }
+    }
+
     static constexpr decltype(auto)
     build_shuffle_vec_initializer() {
         return scale_seq<T, uint8_t>();
@@ -349,6 +463,44 @@ struct vector_ops_support_impl {
     }
 
 
+    // k if every element i is swapped with element i ^ k (adjacent
+    // groups of k elements trade places), which is a rotate of groups of
+    // 2 * k elements. Otherwise 0
+    static constexpr uint32_t
+    swap_adjacent_distance() {
+        constexpr uint32_t perms[n] = { static_cast<uint32_t>(e)... };
+
+        for (uint32_t k = 1; k < n; k *= 2) {
+            bool is_swap = true;
+            for (uint32_t i = 0; i < n; ++i) {
+                is_swap = is_swap && (perms[(n - 1) - i] == (i ^ k));
+            }
+            if (is_swap) {
+                return k;
+            }
+        }
+        return 0;
+    }
+
+    // k if every element i takes element i ^ k (any k, i.e 3 reverses
+    // groups of 4). Most stages of bitonic / oddeven networks are one of
+    // these. Otherwise 0
+    static constexpr uint32_t
+    xor_distance() {
+        constexpr uint32_t perms[n] = { static_cast<uint32_t>(e)... };
+
+        for (uint32_t k = 1; k < n; ++k) {
+            bool is_xor = true;
+            for (uint32_t i = 0; i < n; ++i) {
+                is_xor = is_xor && (perms[(n - 1) - i] == (i ^ k));
+            }
+            if (is_xor) {
+                return k;
+            }
+        }
+        return 0;
+    }
+
     template<uint32_t lane_size, uint32_t ele_per_lane>
     static constexpr uint64_t
     across_lanes_mask_impl() {
@@ -393,6 +545,7 @@ struct blend_support {
     using vop_support_impl = vector_ops_support_impl<T, n, e...>;
 
     static constexpr uint64_t blend_mask = vop_support_impl::build_blend_mask();
+    static constexpr uint64_t min_mask   = vop_support_impl::build_min_mask();
 
     using blend_vec_initialize = decltype(
         vop_support_impl::template build_blend_vec_initializer<blend_mask>());
@@ -408,12 +561,292 @@ struct shuffle_support {
         vop_support_impl::build_shuffle_mask();
 
     static constexpr uint64_t in_same_lanes = vop_support_impl::in_same_lanes();
+    static constexpr uint32_t swap_adjacent =
+        vop_support_impl::swap_adjacent_distance();
+    static constexpr uint32_t xor_distance =
+        vop_support_impl::xor_distance();
+    static constexpr uint64_t shuffle_mask_as_epi16 =
+        vop_support_impl::build_shuffle_mask_as_epi16();
+    static constexpr uint32_t rotate_epi32_bits =
+        vop_support_impl::template rotate_bits<sizeof(uint32_t)>();
+    static constexpr uint32_t rotate_epi64_bits =
+        vop_support_impl::template rotate_bits<sizeof(uint64_t)>();
+    static constexpr uint32_t alignr_bytes =
+        vop_support_impl::template rotate_bits<sizeof(__m128i)>() / 8;
 
     using shuffle_vec_initialize =
         decltype(vop_support_impl::build_shuffle_vec_initializer());
 };
 
 
+// Bytes per 128 bit lane (not sizeof(__m128i), which warns with
+// -Wignored-attributes in a template argument)
+static constexpr uint32_t lane_bytes = 16;
+
+// Index of every byte within its 128 bit lane (_mm*_set_epi8 order).
+// XOR permutations of bytes within a lane are this ^ k
+template<uint32_t vec_size, uint32_t... seq>
+static constexpr decltype(auto)
+build_lane_iota_initializer(std::integer_sequence<uint32_t, seq...> _seq) {
+    return std::integer_sequence<uint32_t,
+                                 (((vec_size - 1) - seq) % lane_bytes)...>{};
+}
+
+template<uint32_t vec_size>
+using lane_iota_initialize = decltype(build_lane_iota_initializer<vec_size>(
+    std::make_integer_sequence<uint32_t, vec_size>{}));
+
+
+// A control vector of size byte elements, e in _mm*_set_epi* order
+template<uint32_t size, uint32_t... e>
+struct control {
+    static constexpr uint32_t nbytes = size * sizeof...(e);
+
+    // byte i in memory (little endian elements, last element of e first)
+    static constexpr uint8_t
+    byte(uint32_t i) {
+        constexpr uint32_t _e[sizeof...(e)] = { static_cast<uint32_t>(e)... };
+        return static_cast<uint8_t>(
+            static_cast<uint64_t>(_e[(sizeof...(e) - 1) - i / size]) >>
+            (8 * (i % size)));
+    }
+};
+
+template<uint32_t size, typename seq>
+struct seq_control_impl;
+
+template<uint32_t size, uint32_t... e>
+struct seq_control_impl<size, std::integer_sequence<uint32_t, e...>> {
+    using type = control<size, e...>;
+};
+
+// control from an *_initialize integer_sequence
+template<uint32_t size, typename seq>
+using seq_control = typename seq_control_impl<size, seq>::type;
+
+// pshufb control of an XOR permutation within lanes. Either derived
+// from iota (lane iota ^ xor_bytes) or loaded as plain, whichever
+// network_constants picks for the kernel
+template<uint32_t _xor_bytes, typename iota, typename plain>
+struct xor_control {
+    static constexpr uint32_t xor_bytes = _xor_bytes;
+};
+
+template<typename c>
+struct control_xor_bytes : std::integral_constant<uint32_t, 0> {};
+
+template<uint32_t xor_bytes, typename iota, typename plain>
+struct control_xor_bytes<xor_control<xor_bytes, iota, plain>>
+    : std::integral_constant<uint32_t, xor_bytes> {};
+
+// the control a kernel actually loads for c
+template<bool derive_xor_shuffle, typename c>
+struct resolve_control {
+    using type = c;
+};
+
+template<bool derive_xor_shuffle,
+         uint32_t xor_bytes,
+         typename iota,
+         typename plain>
+struct resolve_control<derive_xor_shuffle, xor_control<xor_bytes, iota, plain>> {
+    using type = std::conditional_t<derive_xor_shuffle, iota, plain>;
+};
+
+template<typename... controls>
+struct control_list {};
+
+constexpr control_list<>
+concat_controls() {
+    return {};
+}
+
+template<typename... a>
+constexpr control_list<a...>
+concat_controls(control_list<a...> _a) {
+    return {};
+}
+
+template<typename... a, typename... b, typename... lists>
+constexpr decltype(auto)
+concat_controls(control_list<a...> _a, control_list<b...> _b, lists... _lists) {
+    return concat_controls(control_list<a..., b...>{}, _lists...);
+}
+
+template<uint32_t nbytes, uint32_t align>
+struct alignas(align) aligned_bytes {
+    uint8_t v[nbytes];
+};
+
+// Every control vector of a network's stages (vector_ops::stage_controls)
+// in one aligned table, deduplicated and in stage order, so a kernel's
+// controls are contiguous cache lines instead of one constant per vector
+// wherever the linker put it. All controls are vec_size bytes so every
+// entry stays aligned.
+//
+// XOR shuffles are only derived from the lane iota when the kernel has at
+// least 2 distinct ones, so the iota replaces at least 2 loads. With one
+// (or none) deriving is a load plus a broadcast and a vpxor in place of
+// the one load.
+template<uint32_t vec_size, typename list>
+struct network_constants;
+
+template<uint32_t vec_size, typename... controls>
+struct network_constants<vec_size, control_list<controls...>> {
+    static constexpr uint32_t npos  = ~(0U);
+    static constexpr uint32_t nctrl = sizeof...(controls);
+
+    static constexpr uint32_t
+    distinct_xor_shuffles() {
+        constexpr uint32_t xor_bytes[nctrl + 1] = {
+            control_xor_bytes<controls>::value..., 0
+        };
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < nctrl; ++i) {
+            bool first = xor_bytes[i] != 0;
+            for (uint32_t j = 0; j < i; ++j) {
+                first = first && xor_bytes[j] != xor_bytes[i];
+            }
+            count += first;
+        }
+        return count;
+    }
+
+    static constexpr bool derive_xor_shuffle = distinct_xor_shuffles() >= 2;
+
+    template<typename c>
+    using resolve_t = typename resolve_control<derive_xor_shuffle, c>::type;
+
+    static_assert(((resolve_t<controls>::nbytes == vec_size) && ... && true));
+
+    typedef uint8_t (*byte_fn_t)(uint32_t);
+    static constexpr byte_fn_t byte_fns[nctrl + 1] = {
+        &resolve_t<controls>::byte..., nullptr
+    };
+
+    static constexpr bool
+    same(byte_fn_t a, byte_fn_t b) {
+        for (uint32_t i = 0; i < vec_size; ++i) {
+            if (a(i) != b(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // first control equal to control i
+    static constexpr uint32_t
+    first(uint32_t i) {
+        for (uint32_t j = 0; j < i; ++j) {
+            if (same(byte_fns[j], byte_fns[i])) {
+                return j;
+            }
+        }
+        return i;
+    }
+
+    static constexpr uint32_t
+    ndistinct() {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < nctrl; ++i) {
+            count += first(i) == i;
+        }
+        return count;
+    }
+
+    static constexpr uint32_t nbytes =
+        (ndistinct() ? ndistinct() : 1) * vec_size;
+
+    static constexpr aligned_bytes<nbytes, vec_size>
+    build() {
+        aligned_bytes<nbytes, vec_size> out{};
+        uint32_t                        pos = 0;
+        for (uint32_t i = 0; i < nctrl; ++i) {
+            if (first(i) == i) {
+                for (uint32_t j = 0; j < vec_size; ++j) {
+                    out.v[pos++] = byte_fns[i](j);
+                }
+            }
+        }
+        return out;
+    }
+
+    static constexpr aligned_bytes<nbytes, vec_size> table = build();
+
+    // byte offset of c in table, npos if it isn't there
+    template<typename c>
+    static constexpr uint32_t
+    offset() {
+        for (uint32_t i = 0; i < ndistinct() * vec_size; i += vec_size) {
+            bool found = true;
+            for (uint32_t j = 0; j < vec_size; ++j) {
+                found = found && table.v[i + j] == c::byte(j);
+            }
+            if (found) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    // byte offset of control<size, e...>, which a stage of the network
+    // loads so it has to be in the table
+    template<uint32_t size, uint32_t... e>
+    static constexpr uint32_t
+    control_offset() {
+        constexpr uint32_t _offset = offset<control<size, e...>>();
+        static_assert(_offset != npos,
+                      "stage_controls doesn't match vector_ops");
+        return _offset;
+    }
+};
+
+
+
+// Constants for a register holding the first partial_n elements of an
+// array. _mm_set order of fill_size byte elements (8 byte T is split in
+// two so the constant tables can hold it). keep is all ones over the
+// partial_n elements and tail_max is get_max<T>() in the lanes past them
+template<typename T, uint32_t vec_size, uint32_t partial_n>
+struct partial_fill_support {
+    static constexpr uint32_t fill_size =
+        sizeof(T) > sizeof(uint32_t) ? sizeof(uint32_t) : sizeof(T);
+    static constexpr uint32_t words_per_elem = sizeof(T) / fill_size;
+    static constexpr uint32_t n_words        = vec_size / fill_size;
+    static constexpr uint64_t word_mask = (1UL << (8 * fill_size)) - 1;
+    static constexpr uint64_t max_bits  = static_cast<uint64_t>(get_max<T>());
+
+    template<uint32_t... seq>
+    static constexpr decltype(auto)
+    build_keep_initializer(std::integer_sequence<uint32_t, seq...> _seq) {
+        return std::integer_sequence<
+            uint32_t,
+            ((((n_words - 1) - seq) / words_per_elem) < partial_n
+                 ? static_cast<uint32_t>(word_mask)
+                 : 0)...>{};
+    }
+
+    template<uint32_t... seq>
+    static constexpr decltype(auto)
+    build_tail_max_initializer(std::integer_sequence<uint32_t, seq...> _seq) {
+        return std::integer_sequence<
+            uint32_t,
+            ((((n_words - 1) - seq) / words_per_elem) < partial_n
+                 ? 0
+                 : static_cast<uint32_t>(
+                       (max_bits >> (8 * fill_size *
+                                     (((n_words - 1) - seq) %
+                                      words_per_elem))) &
+                       word_mask))...>{};
+    }
+
+    using keep_initialize = decltype(build_keep_initializer(
+        std::make_integer_sequence<uint32_t, n_words>{}));
+    using tail_max_initialize = decltype(build_tail_max_initializer(
+        std::make_integer_sequence<uint32_t, n_words>{}));
+};
+
+
 template<typename T, uint32_t n, uint32_t... e>
 struct shuffle_across_lane_support {
     using vop_support_impl = vector_ops_support_impl<T, n, e...>;
@@ -451,6 +884,12 @@ struct avail_instructions {
     static constexpr uint32_t AVX512VBMI    = 0;
 #endif
 
+#if defined __AVX512VBMI2__
+    static constexpr uint32_t AVX512VBMI2 = 1;
+#else
+    static constexpr uint32_t AVX512VBMI2   = 0;
+#endif
+
 #if defined __AVX512BW__
     static constexpr uint32_t AVX512BW = 1;
 #else
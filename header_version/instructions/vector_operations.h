@@ -4,21 +4,52 @@
 #include <immintrin.h>
 #include <mmintrin.h>
 #include <stdint.h>
+#include <string.h>
 #include <xmmintrin.h>
+#include <type_traits>
 #include <utility>
 
 #include <instructions/vector_operation_support.h>
 #include <util/cpp_attributes.h>
 #include <util/display.h>
 
+// simd_instructions::GENERIC passes __m256i / __m512i around without AVX,
+// everything is always inlined so the ABI notes don't apply
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
 namespace vsort {
 
-enum simd_instructions { AVX = 0, AVX2 = 1, AVX512 = 2 };
+enum simd_instructions {
+    GENERIC = 0,
+    SSE2    = 1,
+    SSE4_1  = 2,
+    AVX     = 3,
+    AVX2    = 4,
+    AVX512  = 5,
+    // AVX512 instructions (AVX512VL / AVX512BW) on xmm / ymm registers
+    // only. Memory sorts that don't fit a ymm register sort both halves
+    // in ymm registers and merge them, so no zmm register is touched
+    AVX512_YMM = 6
+};
 enum builtin_usage {
     BUILTIN_FIRST    = 0,
     BUILTIN_FALLBACK = 1,
     BUILTIN_NONE     = 2
 };
+enum cmp_exchange_usage {
+    MIN_MAX_BLEND      = 0,
+    MASK_MIN_MAX       = 1,
+    BIAS_MIN_MAX_BLEND = 2
+};
+// extra_memory argument of vec_load / vec_store / sort
+enum extra_memory_usage {
+    NO_EXTRA_MEMORY = 0,
+    EXTRA_MEMORY    = 1,
+    PAGE_OVERREAD   = 2
+};
 namespace vop {
 
 static constexpr simd_instructions simd_instructions_default =
@@ -27,7 +58,13 @@ static constexpr simd_instructions simd_instructions_default =
      internal::avail_instructions::AVX512VBMI |
      internal::avail_instructions::AVX512BW)
         ? simd_instructions::AVX512
-        : simd_instructions::AVX2;
+        : (internal::avail_instructions::AVX2
+               ? simd_instructions::AVX2
+               : (internal::avail_instructions::SSE4_1
+                      ? simd_instructions::SSE4_1
+                      : (internal::avail_instructions::SSE2
+                             ? simd_instructions::SSE2
+                             : simd_instructions::GENERIC)));
 
 static constexpr builtin_usage builtin_perm_default =
     (internal::avail_instructions::CLANG_BUILTIN
@@ -36,53 +73,263 @@ static constexpr builtin_usage builtin_perm_default =
                 ? builtin_usage::BUILTIN_FALLBACK
                 : builtin_usage::BUILTIN_NONE));
 
+static constexpr cmp_exchange_usage cmp_exchange_default =
+    simd_instructions_default == simd_instructions::AVX512
+        ? cmp_exchange_usage::MASK_MIN_MAX
+        : cmp_exchange_usage::MIN_MAX_BLEND;
+
 
 namespace internal {
 
 
+// constants is the network_constants of the network being built (see
+// sortgen::internal::sort_builder) or void
 template<typename T,
          simd_instructions simd_set,
          builtin_usage     builtin_perm,
-         uint32_t          vec_size>
+         uint32_t          vec_size,
+         typename constants = void>
 struct vector_ops;
 
-template<typename T, simd_instructions simd_set, builtin_usage builtin_perm>
-struct vector_ops<T, simd_set, builtin_perm, sizeof(__m64)> {
+template<typename T, builtin_usage builtin_perm, uint32_t _vec_size>
+struct generic_vector_ops;
+
+// How a register holding only the first partial_n < n elements of an
+// array is loaded / stored. Lanes past partial_n are always loaded as
+// get_max<T>() so a network over the whole register (best for n > 32)
+// leaves them at the end.
+enum class partial_access {
+    // AVX512 masked load merged into a broadcast max / masked store
+    MASK,
+    // maskload / maskstore of the 4 byte words that are wholly in the
+    // array. The last 1 - 3 bytes of 1 / 2 byte elements are one 4 byte
+    // load ending at partial_n (overlapping the words before it, if
+    // there are any) and scalar stores
+    MASK_WORDS,
+    // through a register sized buffer, no masked instructions
+    MEMCPY
+};
+
+// The one place partial loads / stores are decided, vec_ops only
+// provide the primitives (vec_load_full, vec_fill_max ...).
+//
+// With PAGE_OVERREAD a partial load reads the whole register if it
+// doesn't cross into the next page (the page arr is in is mapped so
+// this can't fault) and blends the max fill in, otherwise it is the
+// same as NO_EXTRA_MEMORY. Stores always only write partial_n elements.
+template<typename T, simd_instructions simd_set, typename vec_ops>
+struct partial_memory_ops {
+    static constexpr uint32_t n        = vec_ops::n;
+    static constexpr uint32_t vec_size = vec_ops::vec_size;
+    using reg_t                        = typename vec_ops::reg_t;
+
+    static constexpr uintptr_t page_size = 4096;
+
+    static constexpr partial_access access =
+        (simd_set >= simd_instructions::AVX512 &&
+         vec_size >= sizeof(__m128i) &&
+         (vec_size == sizeof(__m512i) || avail_instructions::AVX512VL) &&
+         (sizeof(T) >= sizeof(uint32_t) ? avail_instructions::AVX512F
+                                        : avail_instructions::AVX512BW))
+            ? partial_access::MASK
+            : ((simd_set >= simd_instructions::AVX &&
+                vec_size >= sizeof(__m128i))
+                   ? partial_access::MASK_WORDS
+                   : partial_access::MEMCPY);
+
+    // MASK_WORDS
+    static constexpr uint32_t elems_per_word =
+        sizeof(T) >= sizeof(uint32_t) ? 1 : sizeof(uint32_t) / sizeof(T);
+
+    static bool ALWAYS_INLINE
+    within_page(T * const arr) {
+        return (reinterpret_cast<uintptr_t>(arr) & (page_size - 1)) <=
+               page_size - vec_size;
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static reg_t ALWAYS_INLINE
+    vec_load(T * const arr) {
+        if constexpr (partial_n == n ||
+                      extra_memory == extra_memory_usage::EXTRA_MEMORY) {
+            return vec_ops::template vec_load_full<aligned>(arr);
+        }
+        else if constexpr (extra_memory == extra_memory_usage::PAGE_OVERREAD &&
+                           access != partial_access::MASK) {
+            // an aligned register never crosses a page
+            if (aligned || BRANCH_LIKELY(within_page(arr))) {
+                return vec_ops::template vec_fill_max<partial_n, false>(
+                    vec_ops::template vec_load_full<aligned>(arr));
+            }
+            return vec_load<partial_n, aligned, NO_EXTRA_MEMORY>(arr);
+        }
+        else if constexpr (access == partial_access::MASK) {
+            return vec_ops::template vec_mask_load<partial_n>(arr);
+        }
+        else if constexpr (access == partial_access::MASK_WORDS) {
+            constexpr uint32_t full_words = partial_n / elems_per_word;
+            constexpr uint32_t tail_n     = partial_n % elems_per_word;
+
+            reg_t v = vec_ops::template vec_maskload_words<
+                full_words * (sizeof(T) * elems_per_word / sizeof(uint32_t))>(
+                arr);
+            if constexpr (tail_n) {
+                uint32_t tail = 0;
+                if constexpr (full_words) {
+                    memcpy(&tail,
+                           arr + (partial_n - elems_per_word),
+                           sizeof(uint32_t));
+                    tail >>= 8 * sizeof(T) * (elems_per_word - tail_n);
+                }
+                else {
+                    memcpy(&tail, arr, partial_n * sizeof(T));
+                }
+                v = vec_ops::template vec_insert_word<full_words>(v, tail);
+            }
+            return vec_ops::template vec_fill_max<partial_n, true>(v);
+        }
+        else /* access == partial_access::MEMCPY */ {
+            reg_t v = vec_ops::vec_broadcast_max();
+            memcpy(&v, arr, partial_n * sizeof(T));
+            return v;
+        }
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static void ALWAYS_INLINE
+    vec_store(T * const arr, reg_t v) {
+        if constexpr (partial_n == n ||
+                      extra_memory == extra_memory_usage::EXTRA_MEMORY) {
+            vec_ops::template vec_store_full<aligned>(arr, v);
+        }
+        else if constexpr (access == partial_access::MASK) {
+            vec_ops::template vec_mask_store<partial_n>(arr, v);
+        }
+        else if constexpr (access == partial_access::MASK_WORDS) {
+            constexpr uint32_t full_words = partial_n / elems_per_word;
+            constexpr uint32_t tail_n     = partial_n % elems_per_word;
+
+            vec_ops::template vec_maskstore_words<
+                full_words * (sizeof(T) * elems_per_word / sizeof(uint32_t))>(
+                arr,
+                v);
+            if constexpr (tail_n) {
+                const uint32_t tail =
+                    vec_ops::template vec_extract_word<full_words>(v);
+                memcpy(arr + full_words * elems_per_word,
+                       &tail,
+                       tail_n * sizeof(T));
+            }
+        }
+        else /* access == partial_access::MEMCPY */ {
+            memcpy(arr, &v, partial_n * sizeof(T));
+        }
+    }
+};
+
+// pshufb control of an in lane permutation (vector_ops::build_shuffle_vec).
+// XOR permutations (xor_bytes != 0) can be derived as the lane iota ^
+// xor_bytes with AVX2 (broadcast from a register). Whether they are is up
+// to the network_constants (derive_xor_shuffle), otherwise the control is
+// loaded
+template<typename T, uint32_t n, simd_instructions simd_set, uint32_t... e>
+struct shuffle_control_support {
+    using vop_support = shuffle_support<T, n, e...>;
+
+    static constexpr uint32_t xor_distance_bytes =
+        vop_support::xor_distance * sizeof(T);
+    static constexpr uint32_t xor_bytes =
+        (xor_distance_bytes < lane_bytes &&
+         simd_set >= simd_instructions::AVX2 && avail_instructions::AVX2)
+            ? xor_distance_bytes
+            : 0;
+
+    using plain_control =
+        seq_control<sizeof(uint8_t),
+                    typename vop_support::shuffle_vec_initialize>;
+
+    using controls = std::conditional_t<
+        xor_bytes != 0,
+        control_list<xor_control<
+            xor_bytes,
+            seq_control<sizeof(uint8_t), lane_iota_initialize<n * sizeof(T)>>,
+            plain_control>>,
+        control_list<plain_control>>;
+};
+
+// Whether constants derives the XOR shuffles from the lane iota. Not for
+// controls outside of a network (constants is void), there is nothing to
+// share the iota with
+template<typename constants>
+struct derive_xor_shuffle
+    : std::integral_constant<bool, constants::derive_xor_shuffle> {};
+
+template<>
+struct derive_xor_shuffle<void> : std::false_type {};
+
+template<typename T,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         typename constants>
+struct vector_ops<T, simd_set, builtin_perm, sizeof(__m64), constants> {
     static constexpr uint32_t vec_size = sizeof(__m64);
     static constexpr uint32_t n        = vec_size / sizeof(T);
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr void ALWAYS_INLINE
-    vec_store(T * const arr, __m64 v) {
-        memcpoy(arr, &v, partial_n * sizeof(T));
+    using reg_t      = __m64;
+    using memory_ops = partial_memory_ops<T, simd_set, vector_ops>;
+
+    template<uint32_t aligned>
+    static __m64 ALWAYS_INLINE
+    vec_load_full(T * const arr) {
+        return *((__m64 *)arr);
     }
 
-    template<uint32_t partial_n, uint32_t... indices>
-    static constexpr __m64 ALWAYS_INLINE
-    vec_load_impl(T * const                                   arr,
-                  std::integer_sequence<uint32_t, indices...> _indices) {
-        __m64 v;
+    template<uint32_t aligned>
+    static void ALWAYS_INLINE
+    vec_store_full(T * const arr, __m64 v) {
+        *((__m64 *)arr) = v;
+    }
+
+    static __m64 ALWAYS_INLINE CONST_ATTR
+    vec_broadcast_max() {
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            v = _mm_set1_pi8(get_max<T>());
+            return _mm_set1_pi8(get_max<T>());
         }
         else /* sizeof(T) == sizeof(uint16_t) */ {
-            v = _mm_set1_pi16(get_max<T>());
+            return _mm_set1_pi16(get_max<T>());
         }
-        memcpy(&v, arr, partial_n * sizeof(T));
-        return v;
+    }
+
+    // MMX has no and / or with constants worth loading, 8 bytes are
+    // filled in a general purpose register
+    template<uint32_t partial_n, bool zero_tail>
+    static __m64 ALWAYS_INLINE CONST_ATTR
+    vec_fill_max(__m64 v) {
+        constexpr uint64_t keep = (1UL << (8 * sizeof(T) * partial_n)) - 1;
+        constexpr uint64_t broadcast_max =
+            static_cast<uint64_t>(
+                static_cast<typename std::make_unsigned<T>::type>(
+                    get_max<T>())) *
+            (~(0UL) / ((1UL << (8 * sizeof(T))) - 1));
+        uint64_t bits = _mm_cvtm64_si64(v);
+        if constexpr (!zero_tail) {
+            bits &= keep;
+        }
+        return _mm_cvtsi64_m64(bits | (broadcast_max & (~keep)));
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr void ALWAYS_INLINE
+    vec_store(T * const arr, __m64 v) {
+        memory_ops::template vec_store<partial_n, aligned, extra_memory>(arr,
+                                                                         v);
     }
 
     template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
     static constexpr __m64 ALWAYS_INLINE
     vec_load(T * const arr) {
-        if constexpr (partial_n == n || extra_memory) {
-            return *((__m64 *)arr);
-        }
-        else {
-            return vec_load_impl<partial_n>(
-                arr,
-                std::make_integer_sequence<uint32_t, n>{});
-        }
+        return memory_ops::template vec_load<partial_n, aligned, extra_memory>(
+            arr);
     }
 
     template<uint32_t... e>
@@ -96,6 +343,13 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m64)> {
         }
     }
 
+    // controls are _mm_set_pi* (see compare_exchange_controls)
+    template<cmp_exchange_usage cmp_exchange, uint32_t... e>
+    static constexpr internal::control_list<>
+    stage_controls() {
+        return {};
+    }
+
     static __m64 ALWAYS_INLINE CONST_ATTR
     vec_min(__m64 v1, __m64 v2) {
 
@@ -182,233 +436,185 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m64)> {
 
 };  // namespace internal
 
-template<typename T, simd_instructions simd_set, builtin_usage builtin_perm>
-struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
+template<typename T,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         typename constants>
+struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i), constants> {
     static constexpr uint32_t vec_size = sizeof(__m128i);
     static constexpr uint32_t n        = vec_size / sizeof(T);
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr void ALWAYS_INLINE
-    vec_store(T * const arr, __m128i v) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm_store_si128((__m128i *)arr, v);
-            }
-            else {
-                return _mm_storeu_si128((__m128i *)arr, v);
-            }
+    // what the SSE2 / SSE4_1 tiers can't do with intrinsics
+    using generic_ops = generic_vector_ops<T, builtin_perm, vec_size>;
+
+    using reg_t      = __m128i;
+    using memory_ops = partial_memory_ops<T, simd_set, vector_ops>;
+
+    template<uint32_t aligned>
+    static __m128i ALWAYS_INLINE
+    vec_load_full(T * const arr) {
+        if constexpr (aligned) {
+            return _mm_load_si128((__m128i *)arr);
         }
-        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                _mm_mask_compressstoreu_epi8((T * const)arr,
-                                             (1UL << partial_n) - 1,
-                                             v);
-            }
-            else {
-                _mm_maskstore_epi32((int32_t * const)arr,
-                                    _mm_set_epi32((partial_n >= 16) << 31,
-                                                  (partial_n >= 12) << 31,
-                                                  (partial_n >= 8) << 31,
-                                                  (partial_n >= 4) << 31),
-                                    v);
-                if constexpr (partial_n % (sizeof(uint32_t) / sizeof(T))) {
-                    constexpr uint32_t rounded_n =
-                        partial_n & (~((sizeof(uint32_t) / sizeof(T)) - 1));
-                    constexpr uint32_t shift = 8 * sizeof(T);
-
-                    const uint32_t remainder = _mm_extract_epi32(
-                        v,
-                        partial_n / (sizeof(uint32_t) / sizeof(T)));
-                    arr[rounded_n] = remainder & ((1 << shift) - 1);
-                    if constexpr ((partial_n % (sizeof(uint32_t) / sizeof(T))) >
-                                  1) {
-                        arr[rounded_n + 1] =
-                            (remainder >> shift) & ((1 << shift) - 1);
-                    }
-                    if constexpr ((partial_n % (sizeof(uint32_t) / sizeof(T))) >
-                                  2) {
-                        arr[rounded_n + 2] =
-                            (remainder >> (2 * shift)) & ((1 << shift) - 1);
-                    }
-                }
-            }
+        else {
+            return _mm_loadu_si128((__m128i *)arr);
+        }
+    }
+
+    template<uint32_t aligned>
+    static void ALWAYS_INLINE
+    vec_store_full(T * const arr, __m128i v) {
+        if constexpr (aligned) {
+            _mm_store_si128((__m128i *)arr, v);
+        }
+        else {
+            _mm_storeu_si128((__m128i *)arr, v);
+        }
+    }
+
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_broadcast_max() {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            return _mm_set1_epi8(get_max<T>());
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                _mm_mask_compressstoreu_epi16((T * const)arr,
-                                              (1UL << partial_n) - 1,
-                                              v);
-            }
-            else {
-                _mm_maskstore_epi32((int32_t * const)arr,
-                                    _mm_set_epi32((partial_n >= 8) << 31,
-                                                  (partial_n >= 6) << 31,
-                                                  (partial_n >= 4) << 31,
-                                                  (partial_n >= 2) << 31),
-                                    v);
-                if constexpr (partial_n % (sizeof(uint32_t) / sizeof(T))) {
-                    constexpr uint32_t rounded_n =
-                        partial_n & (~((sizeof(uint32_t) / sizeof(T)) - 1));
-                    constexpr uint32_t shift = 8 * sizeof(T);
-
-                    const uint32_t remainder = _mm_extract_epi32(
-                        v,
-                        partial_n / (sizeof(uint32_t) / sizeof(T)));
-                    arr[rounded_n] = remainder & ((1 << shift) - 1);
-                }
-            }
+            return _mm_set1_epi16(get_max<T>());
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                _mm_mask_compressstoreu_epi32((T * const)arr,
-                                              (1UL << partial_n) - 1,
-                                              v);
-            }
-            else {
-                _mm_maskstore_epi32((T * const)arr,
-                                    _mm_set_epi32((partial_n >= 4) << 31,
-                                                  (partial_n >= 3) << 31,
-                                                  (partial_n >= 2) << 31,
-                                                  (partial_n >= 1) << 31),
-                                    v);
-            }
+            return _mm_set1_epi32(get_max<T>());
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                _mm_mask_compressstoreu_epi64((T * const)arr,
-                                              (1UL << partial_n) - 1,
-                                              v);
-            }
-            else {
-                _mm_maskstore_epi64(
-                    (T * const)arr,
-                    _mm_set_epi64x(((uint64_t)(partial_n >= 2)) << 63,
-                                   ((uint64_t)(partial_n >= 1)) << 63),
-                    v);
-            }
+            return _mm_set1_epi64x(get_max<T>());
         }
     }
 
-    template<uint32_t partial_n, uint32_t... indices>
-    static constexpr __m128i ALWAYS_INLINE
-    vec_load_impl(T * const                                   arr,
-                  std::integer_sequence<uint32_t, indices...> _indices) {
+    // AVX512
+    template<uint32_t partial_n>
+    static __m128i ALWAYS_INLINE
+    vec_mask_load(T * const arr) {
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                return _mm_mask_loadu_epi8(_mm_set1_epi8(get_max<T>()),
-                                           (1UL << partial_n) - 1,
-                                           (T * const)arr);
-            }
-            else {
-                __m128i or_mask = _mm_set_epi8(
-                    ((indices < (n - partial_n)) ? get_max<T>() : 0)...);
-                __m128i v =
-                    _mm_maskload_epi32((int32_t * const)arr,
-                                       _mm_set_epi32((partial_n >= 12) << 31,
-                                                     (partial_n >= 8) << 31,
-                                                     (partial_n >= 4) << 31,
-                                                     (partial_n >= 0) << 31));
-                if constexpr (std::is_signed<T>::value) {
-                    v                = _mm_or_si128(v, or_mask);
-                    __m128i xor_mask = _mm_set_epi8(
-                        ((indices < (n - partial_n)) ? (~get_max<T>()) : 0)...);
-                    return _mm_xor_si128(v, xor_mask);
-                }
-                else {
-                    return _mm_or_si128(v, or_mask);
-                }
-            }
+            return _mm_mask_loadu_epi8(vec_broadcast_max(),
+                                       (1UL << partial_n) - 1,
+                                       (T * const)arr);
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                return _mm_mask_loadu_epi16(_mm_set1_epi16(get_max<T>()),
-                                            (1UL << partial_n) - 1,
-                                            (T * const)arr);
-            }
-            else {
-                __m128i or_mask = _mm_set_epi16(
-                    ((indices < (n - partial_n)) ? get_max<T>() : 0)...);
-                __m128i v =
-                    _mm_maskload_epi32((int32_t * const)arr,
-                                       _mm_set_epi32((partial_n >= 6) << 31,
-                                                     (partial_n >= 4) << 31,
-                                                     (partial_n >= 2) << 31,
-                                                     (partial_n >= 0) << 31));
-                if constexpr (std::is_signed<T>::value) {
-                    v                = _mm_or_si128(v, or_mask);
-                    __m128i xor_mask = _mm_set_epi16(
-                        ((indices < (n - partial_n)) ? (~get_max<T>()) : 0)...);
-                    return _mm_xor_si128(v, xor_mask);
-                }
-                else {
-                    return _mm_or_si128(v, or_mask);
-                }
-            }
+            return _mm_mask_loadu_epi16(vec_broadcast_max(),
+                                        (1UL << partial_n) - 1,
+                                        (T * const)arr);
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                return _mm_mask_loadu_epi32(_mm_set1_epi32(get_max<T>()),
-                                            (1UL << partial_n) - 1,
-                                            (T * const)arr);
-            }
-            else {
-                return _mm_maskload_epi32(
-                    (T * const)arr,
-                    _mm_set_epi32((partial_n >= 4) << 31,
-                                  (partial_n >= 3) << 31,
-                                  (partial_n >= 2) << 31,
-                                  (partial_n >= 1) << 31));
-            }
+            return _mm_mask_loadu_epi32(vec_broadcast_max(),
+                                        (1UL << partial_n) - 1,
+                                        (T * const)arr);
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                return _mm_mask_loadu_epi64(_mm_set1_epi64x(get_max<T>()),
-                                            (1UL << partial_n) - 1,
-                                            (T * const)arr);
-            }
-            else {
-                return _mm_maskload_epi64(
-                    (T * const)arr,
-                    _mm_set_epi64x(((uint64_t)(partial_n >= 2)) << 63,
-                                   ((uint64_t)(partial_n >= 1)) << 63));
-            }
+            return _mm_mask_loadu_epi64(vec_broadcast_max(),
+                                        (1UL << partial_n) - 1,
+                                        (T * const)arr);
         }
     }
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr __m128i ALWAYS_INLINE
-    vec_load(T * const arr) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm_load_si128((__m128i *)arr);
-            }
-            else {
-                return _mm_loadu_si128((__m128i *)arr);
-            }
+    template<uint32_t partial_n>
+    static void ALWAYS_INLINE
+    vec_mask_store(T * const arr, __m128i v) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            _mm_mask_storeu_epi8((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            _mm_mask_storeu_epi16((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            _mm_mask_storeu_epi32((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            _mm_mask_storeu_epi64((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+    }
+
+    // the first `words` 4 byte words of arr
+    template<uint32_t words>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_words_mask() {
+        return build_set_vec<
+            sizeof(uint32_t),
+            (words > 3) ? ~(0U) : 0,
+            (words > 2) ? ~(0U) : 0,
+            (words > 1) ? ~(0U) : 0,
+            (words > 0) ? ~(0U) : 0>();
+    }
+
+    template<uint32_t words>
+    static __m128i ALWAYS_INLINE
+    vec_maskload_words(T * const arr) {
+        if constexpr (simd_set >= simd_instructions::AVX2) {
+            // AVX2
+            return _mm_maskload_epi32((int32_t const *)arr,
+                                      vec_words_mask<words>());
         }
         else {
-            return vec_load_impl<partial_n>(
-                arr,
-                std::make_integer_sequence<uint32_t, n>{});
+            // AVX
+            return _mm_castps_si128(
+                _mm_maskload_ps((float const *)arr, vec_words_mask<words>()));
+        }
+    }
+
+    template<uint32_t words>
+    static void ALWAYS_INLINE
+    vec_maskstore_words(T * const arr, __m128i v) {
+        if constexpr (simd_set >= simd_instructions::AVX2) {
+            // AVX2
+            _mm_maskstore_epi32((int32_t *)arr, vec_words_mask<words>(), v);
+        }
+        else {
+            // AVX
+            _mm_maskstore_ps((float *)arr,
+                             vec_words_mask<words>(),
+                             _mm_castsi128_ps(v));
         }
     }
 
+    template<uint32_t idx>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_insert_word(__m128i v, uint32_t w) {
+        return _mm_insert_epi32(v, w, idx);
+    }
+
+    template<uint32_t idx>
+    static uint32_t ALWAYS_INLINE CONST_ATTR
+    vec_extract_word(__m128i v) {
+        return _mm_extract_epi32(v, idx);
+    }
+
+    // lanes past partial_n to get_max<T>(), zero_tail if they are known
+    // to be zero (skips clearing them)
+    template<uint32_t partial_n, bool zero_tail>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_fill_max(__m128i v) {
+        using fill = partial_fill_support<T, vec_size, partial_n>;
+        if constexpr (!zero_tail) {
+            v = _mm_and_si128(v,
+                              build_set_vec_wrapper<fill::fill_size>(
+                                  typename fill::keep_initialize{}));
+        }
+        return _mm_or_si128(v,
+                            build_set_vec_wrapper<fill::fill_size>(
+                                typename fill::tail_max_initialize{}));
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr void ALWAYS_INLINE
+    vec_store(T * const arr, __m128i v) {
+        memory_ops::template vec_store<partial_n, aligned, extra_memory>(arr,
+                                                                         v);
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr __m128i ALWAYS_INLINE
+    vec_load(T * const arr) {
+        return memory_ops::template vec_load<partial_n, aligned, extra_memory>(
+            arr);
+    }
+
     template<uint32_t... e>
     static __m128i ALWAYS_INLINE CONST_ATTR
     builtin_shuffle_impl(__m128i v) {
@@ -493,44 +699,89 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m128i ALWAYS_INLINE CONST_ATTR
+    static __m128i ALWAYS_INLINE CONST_ATTR
     build_set_vec() {
-        if constexpr ((size == sizeof(uint8_t)) ||
-                      ((size == 0) && (sizeof(T) == sizeof(uint8_t)))) {
-            // SSE2
-            return _mm_set_epi8(e...);
-        }
-        else if constexpr ((size == sizeof(uint16_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint16_t)))) {
-            // SSE2
-            return _mm_set_epi16(e...);
-        }
-        else if constexpr ((size == sizeof(uint32_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint32_t)))) {
+        constexpr uint32_t elem_size = size == 0 ? sizeof(T) : size;
+        if constexpr (std::is_void<constants>::value) {
             // SSE2
-            return _mm_set_epi32(e...);
+            return _mm_load_si128((const __m128i *)internal::constant_table<elem_size,
+                                                                   vec_size,
+                                                                   e...>::values);
         }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
+        else {
+            // otherwise every vector is folded into its own constant pool
+            // entry. Not volatile so the kernel computes the base once
+            const uint8_t * table = constants::table.v;
+            COMPILER_OPAQUE_PTR(table);
             // SSE2
-            return _mm_set_epi64x(e...);
+            return _mm_load_si128(
+                (const __m128i *)(table + constants::template control_offset<
+                                         elem_size,
+                                         e...>()));
         }
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m128i ALWAYS_INLINE CONST_ATTR
+    static __m128i ALWAYS_INLINE CONST_ATTR
     build_set_vec_wrapper(std::integer_sequence<uint32_t, e...> _e) {
         return build_set_vec<size, e...>();
     }
 
+    template<uint32_t size, uint32_t... e>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    build_set_vec_wrapper(internal::control<size, e...> _c) {
+        return build_set_vec<size, e...>();
+    }
+
+    // pshufb control vector of an in lane permutation. XOR permutations
+    // are derived from the byte iota when the network has at least 2 of
+    // them, so its stages share one load of the iota instead of loading
+    // a control vector each
+    template<uint32_t... e>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    build_shuffle_vec() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
+
+        constexpr uint32_t xor_bytes =
+            internal::shuffle_control_support<T, n, simd_set, e...>::xor_bytes;
+        if constexpr (xor_bytes != 0 &&
+                      internal::derive_xor_shuffle<constants>::value) {
+            __m128i iota = build_set_vec_wrapper<sizeof(uint8_t)>(
+                internal::lane_iota_initialize<sizeof(__m128i)>{});
+            // otherwise folded back into one constant per permutation
+            COMPILER_OPAQUE_VEC(iota);
+            // AVX2 (broadcast from a register)
+            return _mm_xor_si128(iota, _mm_set1_epi8(xor_bytes));
+        }
+        else {
+            return build_set_vec_wrapper<sizeof(uint8_t)>(
+                typename vop_support::shuffle_vec_initialize{});
+        }
+    }
+
+    // SSE2 compare and select, v1 where cmp_mask is set
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_select(__m128i cmp_mask, __m128i v1, __m128i v2) {
+        // SSE2
+        return _mm_or_si128(_mm_and_si128(cmp_mask, v1),
+                            _mm_andnot_si128(cmp_mask, v2));
+    }
+
     static __m128i ALWAYS_INLINE CONST_ATTR
     vec_min(__m128i v1, __m128i v2) {
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
             if constexpr (std::is_signed<T>::value) {
-                // SSE4.1
-                return _mm_min_epi8(v1, v2);
+                if constexpr (simd_set >= simd_instructions::SSE4_1) {
+                    // SSE4.1
+                    return _mm_min_epi8(v1, v2);
+                }
+                else {
+                    // SSE2
+                    return vec_select(_mm_cmpgt_epi8(v1, v2), v2, v1);
+                }
             }
             else {
-                // SSE4.1
+                // SSE2
                 return _mm_min_epu8(v1, v2);
             }
         }
@@ -539,13 +790,33 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
                 // SSE2
                 return _mm_min_epi16(v1, v2);
             }
+            else if constexpr (simd_set >= simd_instructions::SSE4_1) {
+                // SSE4.1
+                return _mm_min_epu16(v1, v2);
+            }
             else {
+                // v1 - max(v1 - v2, 0)
                 // SSE2
-                return _mm_min_epu16(v1, v2);
+                return _mm_sub_epi16(v1, _mm_subs_epu16(v1, v2));
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (std::is_signed<T>::value) {
+            if constexpr (simd_set < simd_instructions::SSE4_1) {
+                __m128i cmp_mask;
+                if constexpr (std::is_signed<T>::value) {
+                    // SSE2
+                    cmp_mask = _mm_cmpgt_epi32(v1, v2);
+                }
+                else {
+                    // SSE2
+                    __m128i sign_bits = _mm_set1_epi32((1U) << 31);
+                    // SSE2
+                    cmp_mask = _mm_cmpgt_epi32(_mm_xor_si128(v1, sign_bits),
+                                               _mm_xor_si128(v2, sign_bits));
+                }
+                return vec_select(cmp_mask, v2, v1);
+            }
+            else if constexpr (std::is_signed<T>::value) {
                 // SSE4.1
                 return _mm_min_epi32(v1, v2);
             }
@@ -568,6 +839,11 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
                     return _mm_min_epu64(v1, v2);
                 }
             }
+            else if constexpr (simd_set < simd_instructions::AVX &&
+                               !internal::avail_instructions::SSE4_2) {
+                // no cmpgt_epi64
+                return generic_ops::vec_min(v1, v2);
+            }
             else {
                 if constexpr (std::is_signed<T>::value) {
                     // SSE4.2
@@ -594,11 +870,17 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
     vec_max(__m128i v1, __m128i v2) {
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
             if constexpr (std::is_signed<T>::value) {
-                // SSE4.1
-                return _mm_max_epi8(v1, v2);
+                if constexpr (simd_set >= simd_instructions::SSE4_1) {
+                    // SSE4.1
+                    return _mm_max_epi8(v1, v2);
+                }
+                else {
+                    // SSE2
+                    return vec_select(_mm_cmpgt_epi8(v1, v2), v1, v2);
+                }
             }
             else {
-                // SSE4.1
+                // SSE2
                 return _mm_max_epu8(v1, v2);
             }
         }
@@ -607,19 +889,39 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
                 // SSE2
                 return _mm_max_epi16(v1, v2);
             }
+            else if constexpr (simd_set >= simd_instructions::SSE4_1) {
+                // SSE4.1
+                return _mm_max_epu16(v1, v2);
+            }
             else {
+                // v2 + max(v1 - v2, 0)
                 // SSE2
-                return _mm_max_epu16(v1, v2);
+                return _mm_add_epi16(v2, _mm_subs_epu16(v1, v2));
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (std::is_signed<T>::value) {
-                // SSE4.1
-                return _mm_max_epi32(v1, v2);
-            }
-            else {
-                // SSE4.1
-                return _mm_max_epu32(v1, v2);
+            if constexpr (simd_set < simd_instructions::SSE4_1) {
+                __m128i cmp_mask;
+                if constexpr (std::is_signed<T>::value) {
+                    // SSE2
+                    cmp_mask = _mm_cmpgt_epi32(v1, v2);
+                }
+                else {
+                    // SSE2
+                    __m128i sign_bits = _mm_set1_epi32((1U) << 31);
+                    // SSE2
+                    cmp_mask = _mm_cmpgt_epi32(_mm_xor_si128(v1, sign_bits),
+                                               _mm_xor_si128(v2, sign_bits));
+                }
+                return vec_select(cmp_mask, v1, v2);
+            }
+            else if constexpr (std::is_signed<T>::value) {
+                // SSE4.1
+                return _mm_max_epi32(v1, v2);
+            }
+            else {
+                // SSE4.1
+                return _mm_max_epu32(v1, v2);
             }
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
@@ -636,6 +938,11 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
                     return _mm_max_epu64(v1, v2);
                 }
             }
+            else if constexpr (simd_set < simd_instructions::AVX &&
+                               !internal::avail_instructions::SSE4_2) {
+                // no cmpgt_epi64
+                return generic_ops::vec_max(v1, v2);
+            }
             else {
                 if constexpr (std::is_signed<T>::value) {
                     // SSE4.2
@@ -657,6 +964,51 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
         }
     }
 
+    // blend_epi32 mask as a blend_epi16 mask
+    static constexpr uint32_t
+    blend_mask_as_epi16(uint64_t blend_mask) {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (blend_mask & (1UL << i)) {
+                mask |= 3U << (2 * i);
+            }
+        }
+        return mask;
+    }
+
+    // SSE2 has no blend, v2 where the lane's bit of blend_mask is set
+    template<uint64_t blend_mask, uint32_t... seq>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_blend_select(__m128i                                 v1,
+                     __m128i                                 v2,
+                     std::integer_sequence<uint32_t, seq...> _seq) {
+        constexpr uint32_t nbits = sizeof...(seq);
+        if constexpr (nbits == 16) {
+            // SSE2
+            return vec_select(
+                _mm_set_epi8(
+                    ((blend_mask >> ((nbits - 1) - seq)) & 1 ? -1 : 0)...),
+                v2,
+                v1);
+        }
+        else if constexpr (nbits == 8) {
+            // SSE2
+            return vec_select(
+                _mm_set_epi16(
+                    ((blend_mask >> ((nbits - 1) - seq)) & 1 ? -1 : 0)...),
+                v2,
+                v1);
+        }
+        else {
+            // SSE2
+            return vec_select(
+                _mm_set_epi32(
+                    ((blend_mask >> ((nbits - 1) - seq)) & 1 ? -1 : 0)...),
+                v2,
+                v1);
+        }
+    }
+
     template<uint32_t... e>
     static __m128i ALWAYS_INLINE CONST_ATTR
     vec_blend(__m128i v1, __m128i v2) {
@@ -664,7 +1016,17 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
 
         constexpr uint64_t blend_mask = vop_support::blend_mask;
 
-        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+        if constexpr (simd_set < simd_instructions::SSE4_1) {
+            // 64 bit elements have an epi32 mask
+            return vec_blend_select<blend_mask>(
+                v1,
+                v2,
+                std::make_integer_sequence<uint32_t,
+                                           sizeof(T) >= sizeof(uint32_t)
+                                               ? 4
+                                               : n>{});
+        }
+        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
             if constexpr (simd_set >= simd_instructions::AVX512 &&
                           internal::avail_instructions::AVX512VL &&
                           internal::avail_instructions::AVX512BW) {
@@ -692,6 +1054,12 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
                 return _mm_blend_epi16(v1, v2, blend_mask);
             }
         }
+        else if constexpr (simd_set < simd_instructions::AVX2) {
+            // 32 / 64 bit elements, build_blend_mask will create proper
+            // mask for epi64
+            // SSE4.1
+            return _mm_blend_epi16(v1, v2, blend_mask_as_epi16(blend_mask));
+        }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
             // AVX2
             return _mm_blend_epi32(v1, v2, blend_mask);
@@ -703,6 +1071,106 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
         }
     }
 
+    // Compare exchange of v1 and its permutation v2 as a max and a min
+    // masked into it (AVX512 mask registers), one fewer instruction than
+    // min, max and blend
+    template<uint32_t... e>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_mask_min_max(__m128i v1, __m128i v2) {
+        using vop_support = internal::blend_support<T, n, e...>;
+
+        constexpr uint64_t min_mask = vop_support::min_mask;
+        __m128i s_max = vec_max(v1, v2);
+
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512BW) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL & AVX512BW
+                    return _mm_mask_min_epi8(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL & AVX512BW
+                    return _mm_mask_min_epu8(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512BW) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL & AVX512BW
+                    return _mm_mask_min_epi16(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL & AVX512BW
+                    return _mm_mask_min_epu16(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL
+                    return _mm_mask_min_epi32(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL
+                    return _mm_mask_min_epu32(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL
+                    return _mm_mask_min_epi64(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL
+                    return _mm_mask_min_epu64(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+    }
+
+    // pshuflw / pshufhw, skipping a half that isn't moved
+    template<uint64_t shuffle_mask>
+    static __m128i ALWAYS_INLINE CONST_ATTR
+    vec_shuffle_as_epi16(__m128i v) {
+        constexpr uint32_t shuffle_mask_lo = shuffle_mask;
+        constexpr uint32_t shuffle_mask_hi = (shuffle_mask >> 32);
+        if constexpr (shuffle_mask_lo == 0xe4) {
+            // SSE2
+            return _mm_shufflehi_epi16(v, shuffle_mask_hi);
+        }
+        else if constexpr (shuffle_mask_hi == 0xe4) {
+            // SSE2
+            return _mm_shufflelo_epi16(v, shuffle_mask_lo);
+        }
+        else {
+            // SSE2
+            return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, shuffle_mask_lo),
+                                       shuffle_mask_hi);
+        }
+    }
+
     template<uint32_t... e>
     static __m128i ALWAYS_INLINE CONST_ATTR
     vec_permutate_manual(__m128i v) {
@@ -711,39 +1179,106 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
         constexpr uint64_t shuffle_mask = vop_support::shuffle_mask;
 
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            // SSE3
-            if constexpr (shuffle_mask & vop_support::shuffle_as_epi32_flag) {
+            if constexpr (vop_support::swap_adjacent == 1 &&
+                          simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512VBMI2) {
+                // swaps every pair of bytes
+                // AVX512VL & AVX512VBMI2
+                return _mm_shldi_epi16(v, v, 8);
+            }
+            else if constexpr (vop_support::swap_adjacent * sizeof(T) == 2 &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // swaps every pair of 16 bit words
+                // AVX512VL
+                return _mm_rol_epi32(v, 16);
+            }
+            else if constexpr (shuffle_mask &
+                               vop_support::shuffle_as_epi32_flag) {
+                // SSE2
                 return _mm_shuffle_epi32(v, shuffle_mask & 0xff);
             }
+            else if constexpr (vop_support::rotate_epi32_bits &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // rotates every group of 4 bytes
+                // AVX512VL
+                return _mm_ror_epi32(v, vop_support::rotate_epi32_bits);
+            }
+            else if constexpr (vop_support::rotate_epi64_bits &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // rotates every group of 8 bytes
+                // AVX512VL
+                return _mm_ror_epi64(v, vop_support::rotate_epi64_bits);
+            }
+            else if constexpr (vop_support::shuffle_mask_as_epi16 &&
+                               (simd_set < simd_instructions::SSE4_1 ||
+                                (vop_support::shuffle_mask_as_epi16 &
+                                 0xffffffff) == 0xe4 ||
+                                (vop_support::shuffle_mask_as_epi16 >> 32) ==
+                                    0xe4)) {
+                return vec_shuffle_as_epi16<
+                    vop_support::shuffle_mask_as_epi16>(v);
+            }
+            else if constexpr (vop_support::alignr_bytes &&
+                               simd_set >= simd_instructions::SSE4_1) {
+                // rotates the register by alignr_bytes
+                // SSSE3
+                return _mm_alignr_epi8(v, v, vop_support::alignr_bytes);
+            }
+            else if constexpr (simd_set < simd_instructions::SSE4_1) {
+                // no pshufb
+                return generic_ops::template vec_permutate<e...>(v);
+            }
             else {
+                // SSSE3
                 return _mm_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<0>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (shuffle_mask) {
+            if constexpr (vop_support::swap_adjacent * sizeof(T) == 2 &&
+                          simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                // swaps every pair of 16 bit words
+                // AVX512VL
+                return _mm_rol_epi32(v, 16);
+            }
+            else if constexpr (shuffle_mask) {
                 if constexpr (shuffle_mask &
                               vop_support::shuffle_as_epi32_flag) {
                     // SSE2
                     return _mm_shuffle_epi32(v, shuffle_mask & 0xff);
                 }
+                else if constexpr (vop_support::rotate_epi64_bits &&
+                                   simd_set >= simd_instructions::AVX512 &&
+                                   internal::avail_instructions::AVX512VL) {
+                    // rotates every group of 4 words
+                    // AVX512VL
+                    return _mm_ror_epi64(v, vop_support::rotate_epi64_bits);
+                }
                 else {
-                    constexpr uint32_t shuffle_mask_lo = shuffle_mask;
-                    constexpr uint32_t shuffle_mask_hi = (shuffle_mask >> 32);
-
-                    // SSE2
-                    return _mm_shufflehi_epi16(
-                        _mm_shufflelo_epi16(v, shuffle_mask_lo),
-                        shuffle_mask_hi);
+                    return vec_shuffle_as_epi16<shuffle_mask>(v);
                 }
             }
+            else if constexpr (vop_support::alignr_bytes &&
+                               simd_set >= simd_instructions::SSE4_1) {
+                // rotates the register by alignr_bytes
+                // SSSE3
+                return _mm_alignr_epi8(v, v, vop_support::alignr_bytes);
+            }
+            else if constexpr (simd_set < simd_instructions::SSE4_1) {
+                // no pshufb
+                return generic_ops::template vec_permutate<e...>(v);
+            }
             else {
+                // SSSE3
                 return _mm_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<sizeof(uint8_t)>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
@@ -768,314 +1303,331 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m128i)> {
             return vec_permutate_manual<e...>(v);
         }
     }
-};
-
 
-template<typename T, simd_instructions simd_set, builtin_usage builtin_perm>
-struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
+    // The control vectors compare_exchange<e...> loads, what
+    // vec_permutate / vec_blend / vec_mask_min_max above pick. Every
+    // build_set_vec of a network stage has to be in here
+    // (network_constants::control_offset static_asserts it)
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    shuffle_controls() {
+        return typename internal::
+            shuffle_control_support<T, n, simd_set, e...>::controls{};
+    }
 
-    static constexpr uint32_t vec_size = sizeof(__m256i);
-    static constexpr uint32_t n        = vec_size / sizeof(T);
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    permutate_controls() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr void ALWAYS_INLINE
-    vec_store(T * const arr, __m256i v) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm256_store_si256((__m256i *)arr, v);
-            }
-            else {
-                return _mm256_storeu_si256((__m256i *)arr, v);
-            }
+        if constexpr ((avail_instructions::BUILTIN_SHUFFLE &&
+                       builtin_perm == builtin_usage::BUILTIN_FIRST) ||
+                      simd_set < simd_instructions::SSE4_1) {
+            return internal::control_list<>{};
         }
         else if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                _mm256_mask_compressstoreu_epi8((T * const)arr,
-                                                (1UL << partial_n) - 1,
-                                                v);
+            if constexpr ((vop_support::swap_adjacent == 1 &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL &&
+                           internal::avail_instructions::AVX512VBMI2) ||
+                          (vop_support::swap_adjacent * sizeof(T) == 2 &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL) ||
+                          (vop_support::shuffle_mask &
+                           vop_support::shuffle_as_epi32_flag) ||
+                          ((vop_support::rotate_epi32_bits ||
+                            vop_support::rotate_epi64_bits) &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL) ||
+                          (vop_support::shuffle_mask_as_epi16 &&
+                           ((vop_support::shuffle_mask_as_epi16 &
+                             0xffffffff) == 0xe4 ||
+                            (vop_support::shuffle_mask_as_epi16 >> 32) ==
+                                0xe4)) ||
+                          vop_support::alignr_bytes) {
+                return internal::control_list<>{};
             }
             else {
-                _mm256_maskstore_epi32((int32_t * const)arr,
-                                       _mm256_set_epi32((partial_n >= 32) << 31,
-                                                        (partial_n >= 28) << 31,
-                                                        (partial_n >= 24) << 31,
-                                                        (partial_n >= 20) << 31,
-                                                        (partial_n >= 16) << 31,
-                                                        (partial_n >= 12) << 31,
-                                                        (partial_n >= 8) << 31,
-                                                        (partial_n >= 4) << 31),
-                                       v);
-                if constexpr (partial_n % (sizeof(uint32_t) / sizeof(T))) {
-                    constexpr uint32_t rounded_n =
-                        partial_n & (~((sizeof(uint32_t) / sizeof(T)) - 1));
-                    constexpr uint32_t shift = 8 * sizeof(T);
-
-                    const uint32_t remainder = _mm256_extract_epi32(
-                        v,
-                        partial_n / (sizeof(uint32_t) / sizeof(T)));
-                    arr[rounded_n] = remainder & ((1 << shift) - 1);
-                    if constexpr ((partial_n % (sizeof(uint32_t) / sizeof(T))) >
-                                  1) {
-                        arr[rounded_n + 1] =
-                            (remainder >> shift) & ((1 << shift) - 1);
-                    }
-                    if constexpr ((partial_n % (sizeof(uint32_t) / sizeof(T))) >
-                                  2) {
-                        arr[rounded_n + 2] =
-                            (remainder >> (2 * shift)) & ((1 << shift) - 1);
-                    }
-                }
+                return shuffle_controls<e...>();
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                _mm256_mask_compressstoreu_epi16((T * const)arr,
-                                                 (1UL << partial_n) - 1,
-                                                 v);
+            if constexpr ((vop_support::swap_adjacent * sizeof(T) == 2 &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL) ||
+                          vop_support::shuffle_mask ||
+                          vop_support::alignr_bytes) {
+                return internal::control_list<>{};
             }
             else {
-                _mm256_maskstore_epi32((int32_t * const)arr,
-                                       _mm256_set_epi32((partial_n >= 16) << 31,
-                                                        (partial_n >= 14) << 31,
-                                                        (partial_n >= 12) << 31,
-                                                        (partial_n >= 10) << 31,
-                                                        (partial_n >= 8) << 31,
-                                                        (partial_n >= 6) << 31,
-                                                        (partial_n >= 4) << 31,
-                                                        (partial_n >= 2) << 31),
-                                       v);
-                if constexpr (partial_n % (sizeof(uint32_t) / sizeof(T))) {
-                    constexpr uint32_t rounded_n =
-                        partial_n & (~((sizeof(uint32_t) / sizeof(T)) - 1));
-                    constexpr uint32_t shift = 8 * sizeof(T);
-
-                    const uint32_t remainder = _mm256_extract_epi32(
-                        v,
-                        partial_n / (sizeof(uint32_t) / sizeof(T)));
-                    arr[rounded_n] = remainder & ((1 << shift) - 1);
-                }
+                return shuffle_controls<e...>();
             }
         }
-        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                _mm256_mask_compressstoreu_epi32((T * const)arr,
-                                                 (1UL << partial_n) - 1,
-                                                 v);
-            }
-            else {
-                _mm256_maskstore_epi32((int32_t * const)arr,
-                                       _mm256_set_epi32((partial_n >= 8) << 31,
-                                                        (partial_n >= 7) << 31,
-                                                        (partial_n >= 6) << 31,
-                                                        (partial_n >= 5) << 31,
-                                                        (partial_n >= 4) << 31,
-                                                        (partial_n >= 3) << 31,
-                                                        (partial_n >= 2) << 31,
-                                                        (partial_n >= 1) << 31),
-                                       v);
-            }
+        else {
+            return internal::control_list<>{};
         }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
+    }
 
-                _mm256_mask_compressstoreu_epi64((T * const)arr,
-                                                 (1UL << partial_n) - 1,
-                                                 v);
-            }
-            else {
-                _mm256_maskstore_epi64(
-                    (T * const)arr,
-                    _mm256_set_epi64x((partial_n >= 4) << 31,
-                                      (partial_n >= 3) << 31,
-                                      (partial_n >= 2) << 31,
-                                      (partial_n >= 1) << 31),
-                    v);
-            }
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    blend_controls() {
+        using vop_support = internal::blend_support<T, n, e...>;
+
+        if constexpr (sizeof(T) == sizeof(uint8_t) &&
+                      simd_set >= simd_instructions::SSE4_1 &&
+                      !(simd_set >= simd_instructions::AVX512 &&
+                        internal::avail_instructions::AVX512VL &&
+                        internal::avail_instructions::AVX512BW)) {
+            return internal::control_list<internal::seq_control<
+                sizeof(T),
+                typename vop_support::blend_vec_initialize>>{};
+        }
+        else {
+            return internal::control_list<>{};
         }
     }
 
-    template<uint32_t partial_n, uint32_t... indices>
-    static constexpr __m256i ALWAYS_INLINE
-    vec_load_impl(T * const                                   arr,
-                  std::integer_sequence<uint32_t, indices...> _indices) {
-        if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                return _mm256_mask_loadu_epi8(_mm256_set1_epi8(get_max<T>()),
-                                              (1UL << partial_n) - 1,
-                                              (T * const)arr);
-            }
-            else {
-                __m256i or_mask = _mm256_set_epi8(
-                    ((indices < (n - partial_n)) ? get_max<T>() : 0)...);
-                __m256i v = _mm256_maskload_epi32(
-                    (int32_t * const)arr,
-                    _mm256_set_epi32((partial_n >= 28) << 31,
-                                     (partial_n >= 24) << 31,
-                                     (partial_n >= 20) << 31,
-                                     (partial_n >= 16) << 31,
-                                     (partial_n >= 12) << 31,
-                                     (partial_n >= 8) << 31,
-                                     (partial_n >= 4) << 31,
-                                     (partial_n >= 0) << 31));
-                if constexpr (std::is_signed<T>::value) {
-                    v                = _mm256_or_si256(v, or_mask);
-                    __m256i xor_mask = _mm256_set_epi8(
-                        ((indices < (n - partial_n)) ? (~get_max<T>()) : 0)...);
-                    return _mm256_xor_si256(v, xor_mask);
-                }
-                else {
-                    return _mm256_or_si256(v, or_mask);
-                }
-            }
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    mask_min_max_controls() {
+        if constexpr (simd_set >= simd_instructions::AVX512 &&
+                      internal::avail_instructions::AVX512VL &&
+                      (sizeof(T) >= sizeof(uint32_t) ||
+                       internal::avail_instructions::AVX512BW)) {
+            return internal::control_list<>{};
         }
-        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512BW) {
-                return _mm256_mask_loadu_epi16(_mm256_set1_epi16(get_max<T>()),
-                                               (1UL << partial_n) - 1,
-                                               (T * const)arr);
-            }
-            else {
-                __m256i or_mask = _mm256_set_epi16(
-                    ((indices < (n - partial_n)) ? get_max<T>() : 0)...);
-                __m256i v = _mm256_maskload_epi32(
-                    (int32_t * const)arr,
-                    _mm256_set_epi32((partial_n >= 14) << 31,
-                                     (partial_n >= 12) << 31,
-                                     (partial_n >= 10) << 31,
-                                     (partial_n >= 8) << 31,
-                                     (partial_n >= 6) << 31,
-                                     (partial_n >= 4) << 31,
-                                     (partial_n >= 2) << 31,
-                                     (partial_n >= 0) << 31));
-                if constexpr (std::is_signed<T>::value) {
-                    v                = _mm256_or_si256(v, or_mask);
-                    __m256i xor_mask = _mm256_set_epi16(
-                        ((indices < (n - partial_n)) ? (~get_max<T>()) : 0)...);
-                    return _mm256_xor_si256(v, xor_mask);
-                }
-                else {
-                    return _mm256_or_si256(v, or_mask);
-                }
-            }
+        else {
+            return blend_controls<e...>();
         }
-        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                return _mm256_mask_loadu_epi32(_mm256_set1_epi32(get_max<T>()),
-                                               (1UL << partial_n) - 1,
-                                               (T * const)arr);
-            }
-            else {
-                return _mm256_maskload_epi32(
-                    (int32_t * const)arr,
-                    _mm256_set_epi32((partial_n >= 8) << 31,
-                                     (partial_n >= 7) << 31,
-                                     (partial_n >= 6) << 31,
-                                     (partial_n >= 5) << 31,
-                                     (partial_n >= 4) << 31,
-                                     (partial_n >= 3) << 31,
-                                     (partial_n >= 2) << 31,
-                                     (partial_n >= 1) << 31));
-            }
+    }
+
+    template<cmp_exchange_usage cmp_exchange, uint32_t... e>
+    static constexpr decltype(auto)
+    stage_controls() {
+        if constexpr (cmp_exchange == cmp_exchange_usage::MASK_MIN_MAX) {
+            return internal::concat_controls(permutate_controls<e...>(),
+                                             mask_min_max_controls<e...>());
         }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
-            if constexpr (simd_set >= simd_instructions::AVX512 &&
-                          internal::avail_instructions::AVX512VL &&
-                          internal::avail_instructions::AVX512F) {
-                return _mm256_mask_loadu_epi64(_mm256_set1_epi64x(get_max<T>()),
-                                               (1UL << partial_n) - 1,
-                                               (T * const)arr);
-            }
-            else {
-                return _mm256_maskload_epi64(
-                    (T * const)arr,
-                    _mm256_set_epi64x((partial_n >= 4) << 31,
-                                      (partial_n >= 3) << 31,
-                                      (partial_n >= 2) << 31,
-                                      (partial_n >= 1) << 31));
-            }
+        else {
+            return internal::concat_controls(permutate_controls<e...>(),
+                                             blend_controls<e...>());
         }
     }
+};
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr __m256i ALWAYS_INLINE
-    vec_load(T * const arr) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm256_load_si256((__m256i *)arr);
-            }
-            else {
-                return _mm256_loadu_si256((__m256i *)arr);
-            }
+
+template<typename T,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         typename constants>
+struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i), constants> {
+
+    static constexpr uint32_t vec_size = sizeof(__m256i);
+    static constexpr uint32_t n        = vec_size / sizeof(T);
+
+    using reg_t      = __m256i;
+    using memory_ops = partial_memory_ops<T, simd_set, vector_ops>;
+
+    template<uint32_t aligned>
+    static __m256i ALWAYS_INLINE
+    vec_load_full(T * const arr) {
+        if constexpr (aligned) {
+            return _mm256_load_si256((__m256i *)arr);
         }
         else {
-            return vec_load_impl<partial_n>(
-                arr,
-                std::make_integer_sequence<uint32_t, n>{});
+            return _mm256_loadu_si256((__m256i *)arr);
+        }
+    }
+
+    template<uint32_t aligned>
+    static void ALWAYS_INLINE
+    vec_store_full(T * const arr, __m256i v) {
+        if constexpr (aligned) {
+            _mm256_store_si256((__m256i *)arr, v);
+        }
+        else {
+            _mm256_storeu_si256((__m256i *)arr, v);
         }
     }
 
-    template<uint32_t... e>
     static __m256i ALWAYS_INLINE CONST_ATTR
-    builtin_shuffle_impl(__m256i v) {
+    vec_broadcast_max() {
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
-#if defined(__clang__)
-            return (__m256i)__builtin_shufflevector(
-                (internal::vec_types::vec32x1)v,
-                (internal::vec_types::vec32x1)v,
-                e...);
-#elif defined(__GNUC__)
-            return (__m256i)__builtin_shuffle(
-                (internal::vec_types::vec32x1)v,
-                (internal::vec_types::vec32x1)_mm256_set_epi8(e...));
-#else
-            return v;
-#endif
+            return _mm256_set1_epi8(get_max<T>());
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-#if defined(__clang__)
-            return (__m256i)__builtin_shufflevector(
-                (internal::vec_types::vec16x2)v,
-                (internal::vec_types::vec16x2)v,
-                e...);
-#elif defined(__GNUC__)
-            return (__m256i)__builtin_shuffle(
-                (internal::vec_types::vec16x2)v,
-                (internal::vec_types::vec16x2)_mm256_set_epi16(e...));
-#else
-            return v;
-#endif
+            return _mm256_set1_epi16(get_max<T>());
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-#if defined(__clang__)
-            return (__m256i)__builtin_shufflevector(
-                (internal::vec_types::vec8x4)v,
-                (internal::vec_types::vec8x4)v,
-                e...);
-#elif defined(__GNUC__)
-            return (__m256i)__builtin_shuffle(
-                (internal::vec_types::vec8x4)v,
-                (internal::vec_types::vec8x4)_mm256_set_epi32(e...));
-#else
-            return v;
-#endif
+            return _mm256_set1_epi32(get_max<T>());
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
-#if defined(__clang__)
-            return (__m256i)__builtin_shufflevector(
+            return _mm256_set1_epi64x(get_max<T>());
+        }
+    }
+
+    // AVX512
+    template<uint32_t partial_n>
+    static __m256i ALWAYS_INLINE
+    vec_mask_load(T * const arr) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            return _mm256_mask_loadu_epi8(vec_broadcast_max(),
+                                          (1UL << partial_n) - 1,
+                                          (T * const)arr);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            return _mm256_mask_loadu_epi16(vec_broadcast_max(),
+                                           (1UL << partial_n) - 1,
+                                           (T * const)arr);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            return _mm256_mask_loadu_epi32(vec_broadcast_max(),
+                                           (1UL << partial_n) - 1,
+                                           (T * const)arr);
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            return _mm256_mask_loadu_epi64(vec_broadcast_max(),
+                                           (1UL << partial_n) - 1,
+                                           (T * const)arr);
+        }
+    }
+
+    template<uint32_t partial_n>
+    static void ALWAYS_INLINE
+    vec_mask_store(T * const arr, __m256i v) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            _mm256_mask_storeu_epi8((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            _mm256_mask_storeu_epi16((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            _mm256_mask_storeu_epi32((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            _mm256_mask_storeu_epi64((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+    }
+
+    // the first `words` 4 byte words of arr
+    template<uint32_t words>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    vec_words_mask() {
+        return build_set_vec<
+            sizeof(uint32_t),
+            (words > 7) ? ~(0U) : 0,
+            (words > 6) ? ~(0U) : 0,
+            (words > 5) ? ~(0U) : 0,
+            (words > 4) ? ~(0U) : 0,
+            (words > 3) ? ~(0U) : 0,
+            (words > 2) ? ~(0U) : 0,
+            (words > 1) ? ~(0U) : 0,
+            (words > 0) ? ~(0U) : 0>();
+    }
+
+    template<uint32_t words>
+    static __m256i ALWAYS_INLINE
+    vec_maskload_words(T * const arr) {
+        return _mm256_maskload_epi32((int32_t const *)arr,
+                                     vec_words_mask<words>());
+    }
+
+    template<uint32_t words>
+    static void ALWAYS_INLINE
+    vec_maskstore_words(T * const arr, __m256i v) {
+        _mm256_maskstore_epi32((int32_t *)arr, vec_words_mask<words>(), v);
+    }
+
+    template<uint32_t idx>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    vec_insert_word(__m256i v, uint32_t w) {
+        return _mm256_blend_epi32(v, _mm256_set1_epi32(w), 1 << idx);
+    }
+
+    template<uint32_t idx>
+    static uint32_t ALWAYS_INLINE CONST_ATTR
+    vec_extract_word(__m256i v) {
+        return _mm256_extract_epi32(v, idx);
+    }
+
+    // lanes past partial_n to get_max<T>(), zero_tail if they are known
+    // to be zero (skips clearing them)
+    template<uint32_t partial_n, bool zero_tail>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    vec_fill_max(__m256i v) {
+        using fill = partial_fill_support<T, vec_size, partial_n>;
+        if constexpr (!zero_tail) {
+            v = _mm256_and_si256(v,
+                                 build_set_vec_wrapper<fill::fill_size>(
+                                     typename fill::keep_initialize{}));
+        }
+        return _mm256_or_si256(v,
+                               build_set_vec_wrapper<fill::fill_size>(
+                                   typename fill::tail_max_initialize{}));
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr void ALWAYS_INLINE
+    vec_store(T * const arr, __m256i v) {
+        memory_ops::template vec_store<partial_n, aligned, extra_memory>(arr,
+                                                                         v);
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr __m256i ALWAYS_INLINE
+    vec_load(T * const arr) {
+        return memory_ops::template vec_load<partial_n, aligned, extra_memory>(
+            arr);
+    }
+
+    template<uint32_t... e>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    builtin_shuffle_impl(__m256i v) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+#if defined(__clang__)
+            return (__m256i)__builtin_shufflevector(
+                (internal::vec_types::vec32x1)v,
+                (internal::vec_types::vec32x1)v,
+                e...);
+#elif defined(__GNUC__)
+            return (__m256i)__builtin_shuffle(
+                (internal::vec_types::vec32x1)v,
+                (internal::vec_types::vec32x1)_mm256_set_epi8(e...));
+#else
+            return v;
+#endif
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+#if defined(__clang__)
+            return (__m256i)__builtin_shufflevector(
+                (internal::vec_types::vec16x2)v,
+                (internal::vec_types::vec16x2)v,
+                e...);
+#elif defined(__GNUC__)
+            return (__m256i)__builtin_shuffle(
+                (internal::vec_types::vec16x2)v,
+                (internal::vec_types::vec16x2)_mm256_set_epi16(e...));
+#else
+            return v;
+#endif
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+#if defined(__clang__)
+            return (__m256i)__builtin_shufflevector(
+                (internal::vec_types::vec8x4)v,
+                (internal::vec_types::vec8x4)v,
+                e...);
+#elif defined(__GNUC__)
+            return (__m256i)__builtin_shuffle(
+                (internal::vec_types::vec8x4)v,
+                (internal::vec_types::vec8x4)_mm256_set_epi32(e...));
+#else
+            return v;
+#endif
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+#if defined(__clang__)
+            return (__m256i)__builtin_shufflevector(
                 (internal::vec_types::vec4x8)v,
                 (internal::vec_types::vec4x8)v,
                 e...);
@@ -1112,35 +1664,66 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m256i ALWAYS_INLINE CONST_ATTR
+    static __m256i ALWAYS_INLINE CONST_ATTR
     build_set_vec() {
-        if constexpr ((size == sizeof(uint8_t)) ||
-                      ((size == 0) && (sizeof(T) == sizeof(uint8_t)))) {
-            // SSE2
-            return _mm256_set_epi8(e...);
-        }
-        else if constexpr ((size == sizeof(uint16_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint16_t)))) {
-            // SSE2
-            return _mm256_set_epi16(e...);
+        constexpr uint32_t elem_size = size == 0 ? sizeof(T) : size;
+        if constexpr (std::is_void<constants>::value) {
+            // AVX
+            return _mm256_load_si256((const __m256i *)internal::constant_table<elem_size,
+                                                                   vec_size,
+                                                                   e...>::values);
         }
-        else if constexpr ((size == sizeof(uint32_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint32_t)))) {
-            // SSE2
-            return _mm256_set_epi32(e...);
-        }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
-            // SSE2
-            return _mm256_set_epi64x(e...);
+        else {
+            // otherwise every vector is folded into its own constant pool
+            // entry. Not volatile so the kernel computes the base once
+            const uint8_t * table = constants::table.v;
+            COMPILER_OPAQUE_PTR(table);
+            // AVX
+            return _mm256_load_si256(
+                (const __m256i *)(table + constants::template control_offset<
+                                         elem_size,
+                                         e...>()));
         }
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m256i ALWAYS_INLINE CONST_ATTR
+    static __m256i ALWAYS_INLINE CONST_ATTR
     build_set_vec_wrapper(std::integer_sequence<uint32_t, e...> _e) {
         return build_set_vec<size, e...>();
     }
 
+    template<uint32_t size, uint32_t... e>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    build_set_vec_wrapper(internal::control<size, e...> _c) {
+        return build_set_vec<size, e...>();
+    }
+
+    // pshufb control vector of an in lane permutation. XOR permutations
+    // are derived from the byte iota when the network has at least 2 of
+    // them, so its stages share one load of the iota instead of loading
+    // a control vector each
+    template<uint32_t... e>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    build_shuffle_vec() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
+
+        constexpr uint32_t xor_bytes =
+            internal::shuffle_control_support<T, n, simd_set, e...>::xor_bytes;
+        if constexpr (xor_bytes != 0 &&
+                      internal::derive_xor_shuffle<constants>::value) {
+            __m256i iota = build_set_vec_wrapper<sizeof(uint8_t)>(
+                internal::lane_iota_initialize<sizeof(__m256i)>{});
+            // otherwise folded back into one constant per permutation
+            COMPILER_OPAQUE_VEC(iota);
+            // AVX2 (broadcast from a register)
+            return _mm256_xor_si256(iota, _mm256_set1_epi8(xor_bytes));
+        }
+        else {
+            return build_set_vec_wrapper<sizeof(uint8_t)>(
+                typename vop_support::shuffle_vec_initialize{});
+        }
+    }
+
 
     static __m256i ALWAYS_INLINE CONST_ATTR
     vec_min(__m256i v1, __m256i v2) {
@@ -1340,6 +1923,104 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
     }
 
 
+    template<uint32_t... e>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    vec_mask_min_max(__m256i v1, __m256i v2) {
+        using vop_support = internal::blend_support<T, n, e...>;
+
+        constexpr uint64_t min_mask = vop_support::min_mask;
+        __m256i s_max = vec_max(v1, v2);
+
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512BW) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL & AVX512BW
+                    return _mm256_mask_min_epi8(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL & AVX512BW
+                    return _mm256_mask_min_epu8(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512BW) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL & AVX512BW
+                    return _mm256_mask_min_epi16(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL & AVX512BW
+                    return _mm256_mask_min_epu16(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL
+                    return _mm256_mask_min_epi32(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL
+                    return _mm256_mask_min_epu32(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            if constexpr (simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                if constexpr (std::is_signed<T>::value) {
+                    // AVX512VL
+                    return _mm256_mask_min_epi64(s_max, min_mask, v1, v2);
+                }
+                else {
+                    // AVX512VL
+                    return _mm256_mask_min_epu64(s_max, min_mask, v1, v2);
+                }
+            }
+            else {
+                return vec_blend<e...>(s_max, vec_min(v1, v2));
+            }
+        }
+    }
+
+    // vpshuflw / vpshufhw, skipping a half that isn't moved
+    template<uint64_t shuffle_mask>
+    static __m256i ALWAYS_INLINE CONST_ATTR
+    vec_shuffle_as_epi16(__m256i v) {
+        constexpr uint32_t shuffle_mask_lo = shuffle_mask;
+        constexpr uint32_t shuffle_mask_hi = (shuffle_mask >> 32);
+        if constexpr (shuffle_mask_lo == 0xe4) {
+            // AVX2
+            return _mm256_shufflehi_epi16(v, shuffle_mask_hi);
+        }
+        else if constexpr (shuffle_mask_hi == 0xe4) {
+            // AVX2
+            return _mm256_shufflelo_epi16(v, shuffle_mask_lo);
+        }
+        else {
+            // AVX2
+            return _mm256_shufflehi_epi16(
+                _mm256_shufflelo_epi16(v, shuffle_mask_lo),
+                shuffle_mask_hi);
+        }
+    }
+
     template<uint32_t... e>
     static __m256i ALWAYS_INLINE CONST_ATTR
     vec_permutate_manual(__m256i v) {
@@ -1348,25 +2029,67 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
         constexpr uint64_t shuffle_mask = vop_support::shuffle_mask;
 
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr (vop_support::swap_adjacent == 1 &&
+                          simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL &&
+                          internal::avail_instructions::AVX512VBMI2) {
+                // swaps every pair of bytes
+                // AVX512VL & AVX512VBMI2
+                return _mm256_shldi_epi16(v, v, 8);
+            }
+            else if constexpr (vop_support::swap_adjacent * sizeof(T) == 2 &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // swaps every pair of 16 bit words
+                // AVX512VL
+                return _mm256_rol_epi32(v, 16);
+            }
+            else if constexpr (vop_support::rotate_epi32_bits &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // rotates every group of 4 bytes
+                // AVX512VL
+                return _mm256_ror_epi32(v, vop_support::rotate_epi32_bits);
+            }
+            else if constexpr (vop_support::rotate_epi64_bits &&
+                               simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL) {
+                // rotates every group of 8 bytes
+                // AVX512VL
+                return _mm256_ror_epi64(v, vop_support::rotate_epi64_bits);
+            }
             // gcc misses some optimizations
-            if constexpr (shuffle_mask) {
+            else if constexpr (shuffle_mask) {
                 // AVX2
                 if constexpr (shuffle_mask &
                               vop_support::shuffle_as_epi32_flag) {
                     return _mm256_shuffle_epi32(v, shuffle_mask & 0xff);
                 }
+                else if constexpr (vop_support::shuffle_mask_as_epi16 &&
+                                   ((vop_support::shuffle_mask_as_epi16 &
+                                     0xffffffff) == 0xe4 ||
+                                    (vop_support::shuffle_mask_as_epi16 >>
+                                     32) == 0xe4)) {
+                    return vec_shuffle_as_epi16<
+                        vop_support::shuffle_mask_as_epi16>(v);
+                }
+                else if constexpr (vop_support::alignr_bytes) {
+                    // rotates each 16 byte lane by alignr_bytes
+                    return _mm256_alignr_epi8(v, v, vop_support::alignr_bytes);
+                }
                 else {
                     return _mm256_shuffle_epi8(
                         v,
-                        build_set_vec_wrapper<0>(
-                            typename vop_support::shuffle_vec_initialize{}));
+                        build_shuffle_vec<e...>());
                 }
             }
             else if constexpr (simd_set >= simd_instructions::AVX512 &&
                                internal::avail_instructions::AVX512VL &&
                                internal::avail_instructions::AVX512VBMI) {
                 // AVX512VL & AVX512VBMI
-                return _mm256_permutexvar_epi8(_mm256_set_epi8(e...), v);
+                return _mm256_permutexvar_epi8(
+                    build_set_vec<sizeof(uint8_t), e...>(),
+                    v);
             }
             // this is true if all movement is within lane
 
@@ -1398,7 +2121,14 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
             }
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (shuffle_mask) {
+            if constexpr (vop_support::swap_adjacent * sizeof(T) == 2 &&
+                          simd_set >= simd_instructions::AVX512 &&
+                          internal::avail_instructions::AVX512VL) {
+                // swaps every pair of 16 bit words
+                // AVX512VL
+                return _mm256_rol_epi32(v, 16);
+            }
+            else if constexpr (shuffle_mask) {
 
                 if constexpr (shuffle_mask &
                               vop_support::shuffle_as_epi32_flag) {
@@ -1406,28 +2136,35 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
                     // AVX2
                     return _mm256_shuffle_epi32(v, shuffle_mask & 0xff);
                 }
+                else if constexpr (vop_support::rotate_epi64_bits &&
+                                   simd_set >= simd_instructions::AVX512 &&
+                                   internal::avail_instructions::AVX512VL) {
+                    // rotates every group of 4 words
+                    // AVX512VL
+                    return _mm256_ror_epi64(v, vop_support::rotate_epi64_bits);
+                }
                 else {
-                    constexpr uint32_t shuffle_mask_lo = shuffle_mask;
-                    constexpr uint32_t shuffle_mask_hi = (shuffle_mask >> 32);
-
-                    // AVX2
-                    return _mm256_shufflehi_epi16(
-                        _mm256_shufflelo_epi16(v, shuffle_mask_lo),
-                        shuffle_mask_hi);
+                    return vec_shuffle_as_epi16<shuffle_mask>(v);
                 }
             }
+            else if constexpr (vop_support::alignr_bytes) {
+                // rotates each 16 byte lane by alignr_bytes
+                // AVX2
+                return _mm256_alignr_epi8(v, v, vop_support::alignr_bytes);
+            }
             else if constexpr (vop_support::in_same_lanes) {
                 // AVX2
                 return _mm256_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<sizeof(uint8_t)>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
             else if constexpr (simd_set >= simd_instructions::AVX512 &&
                                internal::avail_instructions::AVX512VL &&
                                internal::avail_instructions::AVX512BW) {
                 // AVX512VL & AVX512BW
-                return _mm256_permutexvar_epi16(_mm256_set_epi16(e...), v);
+                return _mm256_permutexvar_epi16(
+                    build_set_vec<sizeof(uint16_t), e...>(),
+                    v);
             }
 
 
@@ -1464,12 +2201,13 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
             else if constexpr (vop_support::in_same_lanes) {
                 return _mm256_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<1>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
             else {
                 // AVX2
-                return _mm256_permutevar8x32_epi32(v, _mm256_set_epi32(e...));
+                return _mm256_permutevar8x32_epi32(
+                    v,
+                    build_set_vec<sizeof(uint32_t), e...>());
             }
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
@@ -1495,82 +2233,281 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m256i)> {
             return vec_permutate_manual<e...>(v);
         }
     }
-};
 
-template<typename T, simd_instructions simd_set, builtin_usage builtin_perm>
-struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
+    // The control vectors compare_exchange<e...> loads, what
+    // vec_permutate / vec_blend / vec_mask_min_max above pick. Every
+    // build_set_vec of a network stage has to be in here
+    // (network_constants::control_offset static_asserts it)
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    shuffle_controls() {
+        return typename internal::
+            shuffle_control_support<T, n, simd_set, e...>::controls{};
+    }
 
-    static constexpr uint32_t vec_size = sizeof(__m512i);
-    static constexpr uint32_t n        = vec_size / sizeof(T);
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    permutate_controls() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
+        using across_lane_support =
+            internal::shuffle_across_lane_support<T, n, e...>;
+        using across_lane_controls = internal::control_list<
+            internal::seq_control<
+                sizeof(uint8_t),
+                typename across_lane_support::across_lanes_same_vec_initialize>,
+            internal::seq_control<
+                sizeof(uint8_t),
+                typename across_lane_support::
+                    across_lanes_other_vec_initialize>>;
 
+        constexpr uint64_t shuffle_mask = vop_support::shuffle_mask;
+        constexpr bool     builtin_fallback =
+            internal::avail_instructions::BUILTIN_SHUFFLE &&
+            builtin_perm == builtin_usage::BUILTIN_FALLBACK;
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr void ALWAYS_INLINE
-    vec_store(T * const arr, __m512i v) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm512_store_si512((__m512i *)arr, v);
+        if constexpr (avail_instructions::BUILTIN_SHUFFLE &&
+                      builtin_perm == builtin_usage::BUILTIN_FIRST) {
+            return internal::control_list<>{};
+        }
+        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr ((vop_support::swap_adjacent == 1 &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL &&
+                           internal::avail_instructions::AVX512VBMI2) ||
+                          ((vop_support::swap_adjacent * sizeof(T) == 2 ||
+                            vop_support::rotate_epi32_bits ||
+                            vop_support::rotate_epi64_bits) &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL)) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (shuffle_mask) {
+                if constexpr ((shuffle_mask &
+                               vop_support::shuffle_as_epi32_flag) ||
+                              (vop_support::shuffle_mask_as_epi16 &&
+                               ((vop_support::shuffle_mask_as_epi16 &
+                                 0xffffffff) == 0xe4 ||
+                                (vop_support::shuffle_mask_as_epi16 >> 32) ==
+                                    0xe4)) ||
+                              vop_support::alignr_bytes) {
+                    return internal::control_list<>{};
+                }
+                else {
+                    return shuffle_controls<e...>();
+                }
+            }
+            else if constexpr (simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL &&
+                               internal::avail_instructions::AVX512VBMI) {
+                return internal::control_list<
+                    internal::control<sizeof(uint8_t), e...>>{};
+            }
+            else if constexpr (builtin_fallback) {
+                return internal::control_list<>{};
             }
             else {
-                return _mm512_storeu_si512((__m512i *)arr, v);
+                return across_lane_controls{};
             }
         }
-        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            _mm512_mask_compressstoreu_epi8((T * const)arr,
-                                            (1UL << partial_n) - 1,
-                                            v);
-        }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            _mm512_mask_compressstoreu_epi16((T * const)arr,
-                                             (1UL << partial_n) - 1,
-                                             v);
+            if constexpr ((vop_support::swap_adjacent * sizeof(T) == 2 &&
+                           simd_set >= simd_instructions::AVX512 &&
+                           internal::avail_instructions::AVX512VL) ||
+                          shuffle_mask || vop_support::alignr_bytes) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                return shuffle_controls<e...>();
+            }
+            else if constexpr (simd_set >= simd_instructions::AVX512 &&
+                               internal::avail_instructions::AVX512VL &&
+                               internal::avail_instructions::AVX512BW) {
+                return internal::control_list<
+                    internal::control<sizeof(uint16_t), e...>>{};
+            }
+            else if constexpr (builtin_fallback) {
+                return internal::control_list<>{};
+            }
+            else {
+                return across_lane_controls{};
+            }
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            _mm512_mask_compressstoreu_epi32((T * const)arr,
-                                             (1UL << partial_n) - 1,
-                                             v);
+            if constexpr (shuffle_mask) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                return shuffle_controls<e...>();
+            }
+            else {
+                return internal::control_list<
+                    internal::control<sizeof(uint32_t), e...>>{};
+            }
         }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
-            _mm512_mask_compressstoreu_epi64((T * const)arr,
-                                             (1UL << partial_n) - 1,
-                                             v);
+        else {
+            return internal::control_list<>{};
         }
     }
 
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    blend_controls() {
+        using vop_support = internal::blend_support<T, n, e...>;
 
-    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
-    static constexpr __m512i ALWAYS_INLINE
-    vec_load(T * const arr) {
-        if constexpr (partial_n == n || extra_memory) {
-            if constexpr (aligned) {
-                return _mm512_load_si512((__m512i *)arr);
-            }
-            else {
-                return _mm512_loadu_si512((__m512i *)arr);
-            }
+        constexpr uint64_t blend_mask = vop_support::blend_mask;
+        constexpr bool     mask_mov   = simd_set >= simd_instructions::AVX512 &&
+                                  internal::avail_instructions::AVX512VL &&
+                                  internal::avail_instructions::AVX512BW;
+
+        if constexpr ((sizeof(T) == sizeof(uint8_t) ||
+                       (sizeof(T) == sizeof(uint16_t) &&
+                        (blend_mask & 0xff) != ((blend_mask >> 8) & 0xff))) &&
+                      !mask_mov) {
+            return internal::control_list<internal::seq_control<
+                sizeof(uint8_t),
+                typename vop_support::blend_vec_initialize>>{};
         }
-        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
-            return _mm512_mask_loadu_epi8(_mm512_set1_epi8(get_max<T>()),
+        else {
+            return internal::control_list<>{};
+        }
+    }
+
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    mask_min_max_controls() {
+        if constexpr (simd_set >= simd_instructions::AVX512 &&
+                      internal::avail_instructions::AVX512VL &&
+                      (sizeof(T) >= sizeof(uint32_t) ||
+                       internal::avail_instructions::AVX512BW)) {
+            return internal::control_list<>{};
+        }
+        else {
+            return blend_controls<e...>();
+        }
+    }
+
+    template<cmp_exchange_usage cmp_exchange, uint32_t... e>
+    static constexpr decltype(auto)
+    stage_controls() {
+        if constexpr (cmp_exchange == cmp_exchange_usage::MASK_MIN_MAX) {
+            return internal::concat_controls(permutate_controls<e...>(),
+                                             mask_min_max_controls<e...>());
+        }
+        else {
+            return internal::concat_controls(permutate_controls<e...>(),
+                                             blend_controls<e...>());
+        }
+    }
+};
+
+template<typename T,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         typename constants>
+struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i), constants> {
+
+    static constexpr uint32_t vec_size = sizeof(__m512i);
+    static constexpr uint32_t n        = vec_size / sizeof(T);
+
+
+    using reg_t      = __m512i;
+    using memory_ops = partial_memory_ops<T, simd_set, vector_ops>;
+
+    template<uint32_t aligned>
+    static __m512i ALWAYS_INLINE
+    vec_load_full(T * const arr) {
+        if constexpr (aligned) {
+            return _mm512_load_si512((__m512i *)arr);
+        }
+        else {
+            return _mm512_loadu_si512((__m512i *)arr);
+        }
+    }
+
+    template<uint32_t aligned>
+    static void ALWAYS_INLINE
+    vec_store_full(T * const arr, __m512i v) {
+        if constexpr (aligned) {
+            _mm512_store_si512((__m512i *)arr, v);
+        }
+        else {
+            _mm512_storeu_si512((__m512i *)arr, v);
+        }
+    }
+
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    vec_broadcast_max() {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            return _mm512_set1_epi8(get_max<T>());
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            return _mm512_set1_epi16(get_max<T>());
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            return _mm512_set1_epi32(get_max<T>());
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            return _mm512_set1_epi64(get_max<T>());
+        }
+    }
+
+    // AVX512
+    template<uint32_t partial_n>
+    static __m512i ALWAYS_INLINE
+    vec_mask_load(T * const arr) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            return _mm512_mask_loadu_epi8(vec_broadcast_max(),
                                           (1UL << partial_n) - 1,
                                           (T * const)arr);
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            return _mm512_mask_loadu_epi16(_mm512_set1_epi16(get_max<T>()),
+            return _mm512_mask_loadu_epi16(vec_broadcast_max(),
                                            (1UL << partial_n) - 1,
                                            (T * const)arr);
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
-            return _mm512_mask_loadu_epi32(_mm512_set1_epi32(get_max<T>()),
+            return _mm512_mask_loadu_epi32(vec_broadcast_max(),
                                            (1UL << partial_n) - 1,
                                            (T * const)arr);
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
-            return _mm512_mask_loadu_epi64(_mm512_set1_epi64(get_max<T>()),
+            return _mm512_mask_loadu_epi64(vec_broadcast_max(),
                                            (1UL << partial_n) - 1,
                                            (T * const)arr);
         }
     }
 
+    template<uint32_t partial_n>
+    static void ALWAYS_INLINE
+    vec_mask_store(T * const arr, __m512i v) {
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            _mm512_mask_storeu_epi8((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            _mm512_mask_storeu_epi16((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            _mm512_mask_storeu_epi32((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            _mm512_mask_storeu_epi64((T * const)arr, (1UL << partial_n) - 1, v);
+        }
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr void ALWAYS_INLINE
+    vec_store(T * const arr, __m512i v) {
+        memory_ops::template vec_store<partial_n, aligned, extra_memory>(arr,
+                                                                         v);
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr __m512i ALWAYS_INLINE
+    vec_load(T * const arr) {
+        return memory_ops::template vec_load<partial_n, aligned, extra_memory>(
+            arr);
+    }
+
     template<uint32_t... e>
     static __m512i ALWAYS_INLINE CONST_ATTR
     builtin_shuffle_impl(__m512i v) {
@@ -1655,35 +2592,66 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m512i ALWAYS_INLINE CONST_ATTR
+    static __m512i ALWAYS_INLINE CONST_ATTR
     build_set_vec() {
-        if constexpr ((size == sizeof(uint8_t)) ||
-                      ((size == 0) && (sizeof(T) == sizeof(uint8_t)))) {
-            // SSE2
-            return _mm512_set_epi8(e...);
-        }
-        else if constexpr ((size == sizeof(uint16_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint16_t)))) {
-            // SSE2
-            return _mm512_set_epi16(e...);
-        }
-        else if constexpr ((size == sizeof(uint32_t)) ||
-                           ((size == 0) && (sizeof(T) == sizeof(uint32_t)))) {
-            // SSE2
-            return _mm512_set_epi32(e...);
+        constexpr uint32_t elem_size = size == 0 ? sizeof(T) : size;
+        if constexpr (std::is_void<constants>::value) {
+            // AVX512F
+            return _mm512_load_si512((const __m512i *)internal::constant_table<elem_size,
+                                                                   vec_size,
+                                                                   e...>::values);
         }
-        else /* sizeof(T) == sizeof(uint64_t) */ {
-            // SSE2
-            return _mm512_set_epi64(e...);
+        else {
+            // otherwise every vector is folded into its own constant pool
+            // entry. Not volatile so the kernel computes the base once
+            const uint8_t * table = constants::table.v;
+            COMPILER_OPAQUE_PTR(table);
+            // AVX512F
+            return _mm512_load_si512(
+                (const __m512i *)(table + constants::template control_offset<
+                                         elem_size,
+                                         e...>()));
         }
     }
 
     template<uint32_t size, uint32_t... e>
-    static constexpr __m512i ALWAYS_INLINE CONST_ATTR
+    static __m512i ALWAYS_INLINE CONST_ATTR
     build_set_vec_wrapper(std::integer_sequence<uint32_t, e...> _e) {
         return build_set_vec<size, e...>();
     }
 
+    template<uint32_t size, uint32_t... e>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    build_set_vec_wrapper(internal::control<size, e...> _c) {
+        return build_set_vec<size, e...>();
+    }
+
+    // pshufb control vector of an in lane permutation. XOR permutations
+    // are derived from the byte iota when the network has at least 2 of
+    // them, so its stages share one load of the iota instead of loading
+    // a control vector each
+    template<uint32_t... e>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    build_shuffle_vec() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
+
+        constexpr uint32_t xor_bytes =
+            internal::shuffle_control_support<T, n, simd_set, e...>::xor_bytes;
+        if constexpr (xor_bytes != 0 &&
+                      internal::derive_xor_shuffle<constants>::value) {
+            __m512i iota = build_set_vec_wrapper<sizeof(uint8_t)>(
+                internal::lane_iota_initialize<sizeof(__m512i)>{});
+            // otherwise folded back into one constant per permutation
+            COMPILER_OPAQUE_VEC(iota);
+            // AVX512F (broadcast from a register)
+            return _mm512_xor_si512(iota, _mm512_set1_epi8(xor_bytes));
+        }
+        else {
+            return build_set_vec_wrapper<sizeof(uint8_t)>(
+                typename vop_support::shuffle_vec_initialize{});
+        }
+    }
+
 
     static __m512i ALWAYS_INLINE CONST_ATTR
     vec_min(__m512i v1, __m512i v2) {
@@ -1801,6 +2769,139 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
     }
 
 
+    template<uint32_t... e>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    vec_mask_min_max(__m512i v1, __m512i v2) {
+        using vop_support = internal::blend_support<T, n, e...>;
+
+        constexpr uint64_t min_mask = vop_support::min_mask;
+        __m512i s_max = vec_max(v1, v2);
+
+        if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr (std::is_signed<T>::value) {
+                // AVX512BW
+                return _mm512_mask_min_epi8(s_max, min_mask, v1, v2);
+            }
+            else {
+                // AVX512BW
+                return _mm512_mask_min_epu8(s_max, min_mask, v1, v2);
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            if constexpr (std::is_signed<T>::value) {
+                // AVX512BW
+                return _mm512_mask_min_epi16(s_max, min_mask, v1, v2);
+            }
+            else {
+                // AVX512BW
+                return _mm512_mask_min_epu16(s_max, min_mask, v1, v2);
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            if constexpr (std::is_signed<T>::value) {
+                // AVX512F
+                return _mm512_mask_min_epi32(s_max, min_mask, v1, v2);
+            }
+            else {
+                // AVX512F
+                return _mm512_mask_min_epu32(s_max, min_mask, v1, v2);
+            }
+        }
+        else /* sizeof(T) == sizeof(uint64_t) */ {
+            if constexpr (std::is_signed<T>::value) {
+                // AVX512F
+                return _mm512_mask_min_epi64(s_max, min_mask, v1, v2);
+            }
+            else {
+                // AVX512F
+                return _mm512_mask_min_epu64(s_max, min_mask, v1, v2);
+            }
+        }
+    }
+
+    // Byte permutation without AVX512VBMI. For each destination word one
+    // vpermw brings the word holding the source of its low byte and one
+    // the word holding the source of its high byte. vpshufb then picks
+    // the byte out of the moved word (which is in the destination word's
+    // lane) and the high bytes are merged with a mask.
+    // lo_src_idx, hi_src_idx and byte_idx
+    template<uint32_t... e, uint32_t... seq>
+    static constexpr decltype(auto)
+    epi8_as_epi16_controls(std::integer_sequence<uint32_t, seq...> _seq) {
+        // perms[(n - 1) - i] is the source of byte i
+        constexpr uint32_t perms[n] = { static_cast<uint32_t>(e)... };
+
+        return internal::control_list<
+            internal::control<
+                sizeof(uint16_t),
+                (perms[(n - 1) - 2 * ((n / 2 - 1) - seq)] / 2)...>,
+            internal::control<
+                sizeof(uint16_t),
+                (perms[(n - 2) - 2 * ((n / 2 - 1) - seq)] / 2)...>,
+            internal::control<
+                sizeof(uint16_t),
+                ((((2 * ((n / 2 - 1) - seq)) % 16) +
+                  (perms[(n - 1) - 2 * ((n / 2 - 1) - seq)] % 2)) |
+                 ((((2 * ((n / 2 - 1) - seq)) % 16) +
+                   (perms[(n - 2) - 2 * ((n / 2 - 1) - seq)] % 2))
+                  << 8))...>>{};
+    }
+
+    template<typename lo_src_control,
+             typename hi_src_control,
+             typename byte_control>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    vec_permutate_epi8_as_epi16_kernel(
+        __m512i v,
+        internal::control_list<lo_src_control, hi_src_control, byte_control>
+            _controls) {
+        __m512i lo_src_idx = build_set_vec_wrapper(lo_src_control{});
+        __m512i hi_src_idx = build_set_vec_wrapper(hi_src_control{});
+        __m512i byte_idx   = build_set_vec_wrapper(byte_control{});
+
+        // AVX512BW
+        __m512i lo_bytes = _mm512_shuffle_epi8(
+            _mm512_permutexvar_epi16(lo_src_idx, v),
+            byte_idx);
+        // AVX512BW
+        return _mm512_mask_shuffle_epi8(
+            lo_bytes,
+            0xaaaaaaaaaaaaaaaaUL,
+            _mm512_permutexvar_epi16(hi_src_idx, v),
+            byte_idx);
+    }
+
+    template<uint32_t... e>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    vec_permutate_epi8_as_epi16(__m512i v) {
+        return vec_permutate_epi8_as_epi16_kernel(
+            v,
+            epi8_as_epi16_controls<e...>(
+                std::make_integer_sequence<uint32_t, n / 2>{}));
+    }
+
+    // vpshuflw / vpshufhw, skipping a half that isn't moved
+    template<uint64_t shuffle_mask>
+    static __m512i ALWAYS_INLINE CONST_ATTR
+    vec_shuffle_as_epi16(__m512i v) {
+        constexpr uint32_t shuffle_mask_lo = shuffle_mask;
+        constexpr uint32_t shuffle_mask_hi = (shuffle_mask >> 32);
+        if constexpr (shuffle_mask_lo == 0xe4) {
+            // AVX512BW
+            return _mm512_shufflehi_epi16(v, shuffle_mask_hi);
+        }
+        else if constexpr (shuffle_mask_hi == 0xe4) {
+            // AVX512BW
+            return _mm512_shufflelo_epi16(v, shuffle_mask_lo);
+        }
+        else {
+            // AVX512BW
+            return _mm512_shufflehi_epi16(
+                _mm512_shufflelo_epi16(v, shuffle_mask_lo),
+                shuffle_mask_hi);
+        }
+    }
+
     template<uint32_t... e>
     static __m512i ALWAYS_INLINE CONST_ATTR
     vec_permutate_manual(__m512i v) {
@@ -1808,24 +2909,106 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
 
         constexpr uint64_t shuffle_mask = vop_support::shuffle_mask;
         if constexpr (sizeof(T) == sizeof(uint8_t)) {
-
-            if constexpr (shuffle_mask & vop_support::shuffle_as_epi32_flag) {
+            if constexpr (vop_support::swap_adjacent == 1 &&
+                          internal::avail_instructions::AVX512VBMI2) {
+                // swaps every pair of bytes
+                // AVX512VBMI2
+                return _mm512_shldi_epi16(v, v, 8);
+            }
+            else if constexpr (vop_support::swap_adjacent * sizeof(T) == 2) {
+                // swaps every pair of 16 bit words
+                // AVX512F
+                return _mm512_rol_epi32(v, 16);
+            }
+            else if constexpr (shuffle_mask &
+                               vop_support::shuffle_as_epi32_flag) {
                 // AVX512F
                 return _mm512_shuffle_epi32(
                     v,
                     (_MM_PERM_ENUM)(shuffle_mask & 0xff));
             }
-            // AVX512VBMI
-            return _mm512_permutexvar_epi8(_mm512_set_epi8(e...), v);
+            else if constexpr (vop_support::rotate_epi32_bits) {
+                // rotates every group of 4 bytes
+                // AVX512F
+                return _mm512_ror_epi32(v, vop_support::rotate_epi32_bits);
+            }
+            else if constexpr (vop_support::rotate_epi64_bits) {
+                // rotates every group of 8 bytes
+                // AVX512F
+                return _mm512_ror_epi64(v, vop_support::rotate_epi64_bits);
+            }
+            else if constexpr (vop_support::shuffle_mask_as_epi16 &&
+                               ((vop_support::shuffle_mask_as_epi16 &
+                                 0xffffffff) == 0xe4 ||
+                                (vop_support::shuffle_mask_as_epi16 >> 32) ==
+                                    0xe4)) {
+                return vec_shuffle_as_epi16<
+                    vop_support::shuffle_mask_as_epi16>(v);
+            }
+            else if constexpr (vop_support::alignr_bytes) {
+                // rotates each 16 byte lane by alignr_bytes
+                // AVX512BW
+                return _mm512_alignr_epi8(v, v, vop_support::alignr_bytes);
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                // AVX512BW
+                return _mm512_shuffle_epi8(
+                    v,
+                    build_shuffle_vec<e...>());
+            }
+            else if constexpr (internal::avail_instructions::AVX512VBMI) {
+                // AVX512VBMI
+                return _mm512_permutexvar_epi8(
+                    build_set_vec<sizeof(uint8_t), e...>(),
+                    v);
+            }
+            else if constexpr (internal::avail_instructions::BUILTIN_SHUFFLE &&
+                               builtin_perm ==
+                                   builtin_usage::BUILTIN_FALLBACK) {
+                return builtin_shuffle<e...>(v);
+            }
+            else {
+                return vec_permutate_epi8_as_epi16<e...>(v);
+            }
         }
         else if constexpr (sizeof(T) == sizeof(uint16_t)) {
-            if constexpr (shuffle_mask & vop_support::shuffle_as_epi32_flag) {
+            if constexpr (vop_support::swap_adjacent * sizeof(T) == 2) {
+                // swaps every pair of 16 bit words
+                // AVX512F
+                return _mm512_rol_epi32(v, 16);
+            }
+            else if constexpr (shuffle_mask &
+                               vop_support::shuffle_as_epi32_flag) {
                 return _mm512_shuffle_epi32(
                     v,
                     (_MM_PERM_ENUM)(shuffle_mask & 0xff));
             }
-            // AVX512BW
-            return _mm512_permutexvar_epi16(_mm512_set_epi16(e...), v);
+            else if constexpr (vop_support::rotate_epi64_bits) {
+                // rotates every group of 4 words
+                // AVX512F
+                return _mm512_ror_epi64(v, vop_support::rotate_epi64_bits);
+            }
+            else if constexpr (shuffle_mask) {
+                return vec_shuffle_as_epi16<shuffle_mask>(v);
+            }
+            else if constexpr (vop_support::alignr_bytes) {
+                // rotates each 16 byte lane by alignr_bytes
+                // AVX512BW
+                return _mm512_alignr_epi8(v, v, vop_support::alignr_bytes);
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                // vpshufb is 1 uop, vpermw 2
+                // AVX512BW
+                return _mm512_shuffle_epi8(
+                    v,
+                    build_shuffle_vec<e...>());
+            }
+            else {
+                // AVX512BW
+                return _mm512_permutexvar_epi16(
+                    build_set_vec<sizeof(uint16_t), e...>(),
+                    v);
+            }
         }
         else if constexpr (sizeof(T) == sizeof(uint32_t)) {
             if constexpr (shuffle_mask) {
@@ -1835,12 +3018,13 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
             else if constexpr (vop_support::in_same_lanes) {
                 return _mm512_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<1>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
             else {
                 // AVX512F
-                return _mm512_permutexvar_epi32(_mm512_set_epi32(e...), v);
+                return _mm512_permutexvar_epi32(
+                    build_set_vec<sizeof(uint32_t), e...>(),
+                    v);
             }
         }
         else /* sizeof(T) == sizeof(uint64_t) */ {
@@ -1860,12 +3044,13 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
             else if constexpr (vop_support::in_same_lanes) {
                 return _mm512_shuffle_epi8(
                     v,
-                    build_set_vec_wrapper<1>(
-                        typename vop_support::shuffle_vec_initialize{}));
+                    build_shuffle_vec<e...>());
             }
             else {
                 // AVX512F
-                return _mm512_permutexvar_epi64(_mm512_set_epi64(e...), v);
+                return _mm512_permutexvar_epi64(
+                    build_set_vec<sizeof(uint64_t), e...>(),
+                    v);
             }
         }
     }
@@ -1881,7 +3066,282 @@ struct vector_ops<T, simd_set, builtin_perm, sizeof(__m512i)> {
             return vec_permutate_manual<e...>(v);
         }
     }
+
+    // The control vectors compare_exchange<e...> loads, what
+    // vec_permutate above picks. Every
+    // build_set_vec of a network stage has to be in here
+    // (network_constants::control_offset static_asserts it)
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    shuffle_controls() {
+        return typename internal::
+            shuffle_control_support<T, n, simd_set, e...>::controls{};
+    }
+
+    template<uint32_t... e>
+    static constexpr decltype(auto)
+    permutate_controls() {
+        using vop_support = internal::shuffle_support<T, n, e...>;
+
+        constexpr uint64_t shuffle_mask = vop_support::shuffle_mask;
+
+        if constexpr (avail_instructions::BUILTIN_SHUFFLE &&
+                      builtin_perm == builtin_usage::BUILTIN_FIRST) {
+            return internal::control_list<>{};
+        }
+        else if constexpr (sizeof(T) == sizeof(uint8_t)) {
+            if constexpr ((vop_support::swap_adjacent == 1 &&
+                           internal::avail_instructions::AVX512VBMI2) ||
+                          vop_support::swap_adjacent * sizeof(T) == 2 ||
+                          (shuffle_mask & vop_support::shuffle_as_epi32_flag) ||
+                          vop_support::rotate_epi32_bits ||
+                          vop_support::rotate_epi64_bits ||
+                          (vop_support::shuffle_mask_as_epi16 &&
+                           ((vop_support::shuffle_mask_as_epi16 &
+                             0xffffffff) == 0xe4 ||
+                            (vop_support::shuffle_mask_as_epi16 >> 32) ==
+                                0xe4)) ||
+                          vop_support::alignr_bytes) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                return shuffle_controls<e...>();
+            }
+            else if constexpr (internal::avail_instructions::AVX512VBMI) {
+                return internal::control_list<
+                    internal::control<sizeof(uint8_t), e...>>{};
+            }
+            else if constexpr (internal::avail_instructions::BUILTIN_SHUFFLE &&
+                               builtin_perm ==
+                                   builtin_usage::BUILTIN_FALLBACK) {
+                return internal::control_list<>{};
+            }
+            else {
+                return epi8_as_epi16_controls<e...>(
+                    std::make_integer_sequence<uint32_t, n / 2>{});
+            }
+        }
+        else if constexpr (sizeof(T) == sizeof(uint16_t)) {
+            if constexpr (vop_support::swap_adjacent * sizeof(T) == 2 ||
+                          shuffle_mask || vop_support::rotate_epi64_bits ||
+                          vop_support::alignr_bytes) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                return shuffle_controls<e...>();
+            }
+            else {
+                return internal::control_list<
+                    internal::control<sizeof(uint16_t), e...>>{};
+            }
+        }
+        else {
+            if constexpr (shuffle_mask) {
+                return internal::control_list<>{};
+            }
+            else if constexpr (vop_support::in_same_lanes) {
+                return shuffle_controls<e...>();
+            }
+            else {
+                return internal::control_list<
+                    internal::control<sizeof(T), e...>>{};
+            }
+        }
+    }
+
+    template<cmp_exchange_usage cmp_exchange, uint32_t... e>
+    static constexpr decltype(auto)
+    stage_controls() {
+        // vec_blend / vec_mask_min_max only use mask registers
+        return permutate_controls<e...>();
+    }
 };
+
+
+// simd_instructions::GENERIC. Min, max, blend and permute only use GCC /
+// Clang vector extensions so this builds for any target and the compiler
+// lowers it to what the target has (i.e pminsd / pblendw with SSE4.1,
+// scalar code otherwise). Registers are still the __m*i types.
+template<typename T, builtin_usage builtin_perm, uint32_t _vec_size>
+struct generic_vector_ops {
+    static constexpr uint32_t vec_size = _vec_size;
+    static constexpr uint32_t n        = vec_size / sizeof(T);
+
+    using vec_t = typename vec_types::get_vec_t<T, n>::type;
+    typedef T gvec_t __attribute__((vector_size(vec_size)));
+
+    // comparison results / shuffle indexes
+    typedef typename std::make_signed<T>::type gmask_elem_t;
+    typedef gmask_elem_t gmask_t __attribute__((vector_size(vec_size)));
+
+    using reg_t      = vec_t;
+    using memory_ops = partial_memory_ops<T, simd_instructions::GENERIC,
+                                          generic_vector_ops>;
+
+    template<uint32_t aligned>
+    static vec_t ALWAYS_INLINE
+    vec_load_full(T * const arr) {
+        if constexpr (aligned) {
+            return *((vec_t *)arr);
+        }
+        else {
+            vec_t v;
+            memcpy(&v, arr, vec_size);
+            return v;
+        }
+    }
+
+    template<uint32_t aligned>
+    static void ALWAYS_INLINE
+    vec_store_full(T * const arr, vec_t v) {
+        if constexpr (aligned) {
+            *((vec_t *)arr) = v;
+        }
+        else {
+            memcpy(arr, &v, vec_size);
+        }
+    }
+
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_broadcast_max() {
+        return (vec_t)(gvec_t{} + get_max<T>());
+    }
+
+    template<uint32_t partial_n, uint32_t... seq>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_fill_max_impl(vec_t v, std::integer_sequence<uint32_t, seq...> _seq) {
+        return shuffle2<(seq < partial_n ? seq : seq + n)...>(
+            v,
+            vec_broadcast_max());
+    }
+
+    template<uint32_t partial_n, bool zero_tail>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_fill_max(vec_t v) {
+        return vec_fill_max_impl<partial_n>(
+            v,
+            std::make_integer_sequence<uint32_t, n>{});
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr void ALWAYS_INLINE
+    vec_store(T * const arr, vec_t v) {
+        memory_ops::template vec_store<partial_n, aligned, extra_memory>(arr,
+                                                                         v);
+    }
+
+    template<uint32_t partial_n, uint32_t aligned, uint32_t extra_memory>
+    static constexpr vec_t ALWAYS_INLINE
+    vec_load(T * const arr) {
+        return memory_ops::template vec_load<partial_n, aligned, extra_memory>(
+            arr);
+    }
+
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_min(vec_t v1, vec_t v2) {
+        gvec_t _v1 = (gvec_t)v1;
+        gvec_t _v2 = (gvec_t)v2;
+#if defined(__clang__)
+        gvec_t cmp_mask = (gvec_t)(_v1 < _v2);
+        return (vec_t)((_v1 & cmp_mask) | (_v2 & ~cmp_mask));
+#else
+        return (vec_t)(_v1 < _v2 ? _v1 : _v2);
+#endif
+    }
+
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_max(vec_t v1, vec_t v2) {
+        gvec_t _v1 = (gvec_t)v1;
+        gvec_t _v2 = (gvec_t)v2;
+#if defined(__clang__)
+        gvec_t cmp_mask = (gvec_t)(_v1 > _v2);
+        return (vec_t)((_v1 & cmp_mask) | (_v2 & ~cmp_mask));
+#else
+        return (vec_t)(_v1 > _v2 ? _v1 : _v2);
+#endif
+    }
+
+    // lane i is lane idx[i] of v1 ++ v2
+    template<uint32_t... idx>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    shuffle2(vec_t v1, vec_t v2) {
+#if defined(__clang__)
+        return (vec_t)__builtin_shufflevector((gvec_t)v1, (gvec_t)v2, idx...);
+#else
+        return (vec_t)__builtin_shuffle(
+            (gvec_t)v1,
+            (gvec_t)v2,
+            gmask_t{ static_cast<gmask_elem_t>(idx)... });
+#endif
+    }
+
+    // Same lanes as vector_ops::vec_blend, v2 where the lane's pair is
+    // above it
+    template<uint32_t... e, uint32_t... seq>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_blend_impl(vec_t                                   v1,
+                   vec_t                                   v2,
+                   std::integer_sequence<uint32_t, seq...> _seq) {
+        constexpr uint32_t perm[n] = { static_cast<uint32_t>(e)... };
+        return shuffle2<(perm[(n - 1) - seq] > seq ? seq + n : seq)...>(v1,
+                                                                        v2);
+    }
+
+    template<uint32_t... e>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_blend(vec_t v1, vec_t v2) {
+        return vec_blend_impl<e...>(v1,
+                                    v2,
+                                    std::make_integer_sequence<uint32_t, n>{});
+    }
+
+    template<uint32_t... e>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_mask_min_max(vec_t v1, vec_t v2) {
+        return vec_blend<e...>(vec_max(v1, v2), vec_min(v1, v2));
+    }
+
+    // no control vectors, the compiler builds the shuffles / blends
+    template<cmp_exchange_usage cmp_exchange, uint32_t... e>
+    static constexpr control_list<>
+    stage_controls() {
+        return {};
+    }
+
+    // e is lane n - 1 first (like _mm_set_epi*)
+    template<uint32_t... e, uint32_t... seq>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_permutate_impl(vec_t v, std::integer_sequence<uint32_t, seq...> _seq) {
+        constexpr uint32_t perm[n] = { static_cast<uint32_t>(e)... };
+        return shuffle2<perm[(n - 1) - seq]...>(v, v);
+    }
+
+    template<uint32_t... e>
+    static vec_t ALWAYS_INLINE CONST_ATTR
+    vec_permutate(vec_t v) {
+        return vec_permutate_impl<e...>(
+            v,
+            std::make_integer_sequence<uint32_t, n>{});
+    }
+};
+
+// Register sizes as plain integers, sizeof(__m128i) in the template
+// argument below warns with -Wignored-attributes
+static constexpr uint32_t xmm_size = 16;
+
+// GENERIC for everything. Below AVX2 there are no integer ymm / zmm
+// instructions and below SSE4_1 no pshufb for the __m64 ops
+template<typename T,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         uint32_t          vec_size,
+         typename constants = void>
+using select_vector_ops = std::conditional_t<
+    simd_set == simd_instructions::GENERIC ||
+        (simd_set < simd_instructions::AVX2 && vec_size > xmm_size) ||
+        (simd_set < simd_instructions::SSE4_1 && vec_size < xmm_size),
+    generic_vector_ops<T, builtin_perm, vec_size>,
+    vector_ops<T, simd_set, builtin_perm, vec_size, constants>>;
 }  // namespace internal
 
 template<typename T, uint32_t n>
@@ -1896,7 +3356,7 @@ template<typename T,
 constexpr vec_t<T, n> ALWAYS_INLINE
 vec_load(T * const arr) {
     using vec_ops = typename internal::
-        vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
+        select_vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
     return vec_ops::template vec_load<n, aligned, extra_memory>(arr);
 }
 
@@ -1909,21 +3369,99 @@ template<typename T,
 constexpr void ALWAYS_INLINE
 vec_store(T * const arr, vec_t<T, n> v) {
     using vec_ops = typename internal::
-        vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
+        select_vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
     vec_ops::template vec_store<n, aligned, extra_memory>(arr, v);
 }
 
 
+// first partial_n elements of arr in a register of n
 template<typename T,
          uint32_t          n,
-         simd_instructions simd_set,
-         builtin_usage     builtin_perm,
+         uint32_t          partial_n,
+         uint32_t          aligned,
+         uint32_t          extra_memory,
+         simd_instructions simd_set = vop::simd_instructions_default>
+constexpr vec_t<T, n> ALWAYS_INLINE
+vec_load_partial(T * const arr) {
+    using vec_ops = typename internal::
+        select_vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
+    return vec_ops::template vec_load<partial_n, aligned, extra_memory>(arr);
+}
+
+template<typename T,
+         uint32_t          n,
+         uint32_t          partial_n,
+         uint32_t          aligned,
+         uint32_t          extra_memory,
+         simd_instructions simd_set = vop::simd_instructions_default>
+constexpr void ALWAYS_INLINE
+vec_store_partial(T * const arr, vec_t<T, n> v) {
+    using vec_ops = typename internal::
+        select_vector_ops<T, simd_set, BUILTIN_FIRST, sizeof(vec_t<T, n>)>;
+    vec_ops::template vec_store<partial_n, aligned, extra_memory>(arr, v);
+}
+
+
+// Without AVX512VL unsigned 64 bit min / max flip the sign bit of both
+// operands before every compare. With BIAS_MIN_MAX_BLEND the sign bit
+// is flipped once before / after the network and the keys are sorted
+// as signed. The flip is an SSE2 xor for xmm and an AVX2 xor for ymm,
+// below AVX2 ymm networks are sorted as is.
+template<typename T, uint32_t n, simd_instructions simd_set>
+static constexpr bool bias_unsigned =
+    std::is_same<T, uint64_t>::value && simd_set != simd_instructions::GENERIC &&
+    (sizeof(vec_t<T, n>) == internal::xmm_size ||
+     (sizeof(vec_t<T, n>) == 2 * internal::xmm_size &&
+      simd_set >= simd_instructions::AVX2)) &&
+    !(simd_set >= simd_instructions::AVX512 &&
+      internal::avail_instructions::AVX512F &&
+      internal::avail_instructions::AVX512VL);
+
+template<typename T, uint32_t n>
+constexpr vec_t<T, n> ALWAYS_INLINE CONST_ATTR
+vec_flip_sign(vec_t<T, n> v) {
+    if constexpr (sizeof(vec_t<T, n>) == sizeof(__m128)) {
+        // SSE2
+        return _mm_xor_si128(v, _mm_set1_epi64x((1UL) << 63));
+    }
+    else {
+        // AVX2
+        return _mm256_xor_si256(v, _mm256_set1_epi64x((1UL) << 63));
+    }
+}
+
+
+// The control vectors compare_exchange<..., e...> loads (a
+// internal::control_list)
+template<typename T,
+         uint32_t           n,
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange,
+         uint32_t... e>
+constexpr decltype(auto)
+compare_exchange_controls(std::integer_sequence<uint32_t, e...> _e) {
+    using vec_ops = internal::select_vector_ops<T,
+                                                simd_set,
+                                                builtin_perm,
+                                                sizeof(vec_t<T, n>)>;
+    return vec_ops::template stage_controls<cmp_exchange, e...>();
+}
+
+// constants is the network_constants holding the stage's control vectors
+// (see sortgen::internal::sort_builder) or void
+template<typename T,
+         uint32_t           n,
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange,
+         typename constants,
          uint32_t... e>
 constexpr vec_t<T, n> ALWAYS_INLINE CONST_ATTR
 compare_exchange(vec_t<T, n> v) {
     if constexpr (sizeof(T) * n < sizeof(__m64)) {
         using vec_ops =
-            typename internal::vector_ops<T, simd_set, builtin_perm, 8>;
+            internal::select_vector_ops<T, simd_set, builtin_perm, 8>;
         vec_t<T, n> cmp = vec_ops::template vec_permutate<7, 6, 5, 4, e...>(v);
         vec_t<T, n> s_min = vec_ops::vec_min(v, cmp);
         vec_t<T, n> s_max = vec_ops::vec_max(v, cmp);
@@ -1932,18 +3470,65 @@ compare_exchange(vec_t<T, n> v) {
         return ret;
     }
     else {
-        using vec_ops = typename internal::
-            vector_ops<T, simd_set, builtin_perm, sizeof(T) * n>;
-        vec_t<T, n> cmp   = vec_ops::template vec_permutate<e...>(v);
-        vec_t<T, n> s_min = vec_ops::vec_min(v, cmp);
-        vec_t<T, n> s_max = vec_ops::vec_max(v, cmp);
-        vec_t<T, n> ret   = vec_ops::template vec_blend<e...>(s_max, s_min);
-        return ret;
+        using vec_ops = internal::select_vector_ops<T,
+                                                    simd_set,
+                                                    builtin_perm,
+                                                    sizeof(T) * n,
+                                                    constants>;
+        vec_t<T, n> cmp = vec_ops::template vec_permutate<e...>(v);
+        // no mask registers for __m64
+        if constexpr (cmp_exchange == cmp_exchange_usage::MASK_MIN_MAX &&
+                      sizeof(T) * n > sizeof(__m64)) {
+            return vec_ops::template vec_mask_min_max<e...>(v, cmp);
+        }
+        else {
+            vec_t<T, n> s_min = vec_ops::vec_min(v, cmp);
+            vec_t<T, n> s_max = vec_ops::vec_max(v, cmp);
+            vec_t<T, n> ret =
+                vec_ops::template vec_blend<e...>(s_max, s_min);
+            return ret;
+        }
     }
 }
 
 
+// First layer of merging two sorted registers. hi is reversed so the
+// min / max leave lo with the lower half of the elements and both lo
+// and hi bitonic (finished with a single register bitonic merge)
+template<typename T,
+         uint32_t          n,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm,
+         uint32_t... seq>
+constexpr void ALWAYS_INLINE
+merge_exchange_impl(vec_t<T, n> &                          lo,
+                    vec_t<T, n> &                          hi,
+                    std::integer_sequence<uint32_t, seq...> _seq) {
+    using vec_ops =
+        internal::select_vector_ops<T, simd_set, builtin_perm, sizeof(T) * n>;
+    vec_t<T, n> hi_reversed = vec_ops::template vec_permutate<seq...>(hi);
+    hi                      = vec_ops::vec_max(lo, hi_reversed);
+    lo                      = vec_ops::vec_min(lo, hi_reversed);
+}
+
+template<typename T,
+         uint32_t          n,
+         simd_instructions simd_set,
+         builtin_usage     builtin_perm>
+constexpr void ALWAYS_INLINE
+merge_exchange(vec_t<T, n> & lo, vec_t<T, n> & hi) {
+    merge_exchange_impl<T, n, simd_set, builtin_perm>(
+        lo,
+        hi,
+        std::make_integer_sequence<uint32_t, n>{});
+}
+
+
 }  // namespace vop
 
 }  // namespace vsort
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 #endif
@@ -3,72 +3,46 @@
 
 #include <stdint.h>
 
-#include <util/integer_range.h>
+#include <networks/network_builder.h>
 
 namespace vsort {
 namespace network {
 namespace internal {
 
 template<uint32_t n>
-struct balanced_network {
-
-    template<uint32_t i, uint32_t j, uint32_t curr>
-    static constexpr decltype(auto)
-    balanced_create_pairs() {
-        if constexpr (i < next_p2(n)) {
-            if constexpr (j < (curr / 2)) {
-                constexpr uint32_t wire1 = i + j;
-                constexpr uint32_t wire2 = (i + curr) - (j + 1);
-                if constexpr (wire1 < n && wire2 < n) {
-                    return merge<uint32_t>(
-                        std::integer_sequence<uint32_t, wire1, wire2>{},
-                        balanced_create_pairs<i, j + 1, curr>());
-                }
-                else {
-                    return balanced_create_pairs<i, j + 1, curr>();
+struct balanced_network_impl {
+
+    template<typename pairs_t>
+    static constexpr void
+    balanced_create_pairs(pairs_t & pairs, uint32_t curr) {
+        for (uint32_t i = 0; i < next_p2(n); i += curr) {
+            for (uint32_t j = 0; j < (curr / 2); ++j) {
+                const uint32_t wire1 = i + j;
+                const uint32_t wire2 = (i + curr) - (j + 1);
+                if (wire1 < n && wire2 < n) {
+                    pairs.add(wire1, wire2);
                 }
             }
-            else {
-                return balanced_create_pairs<i + curr, 0, curr>();
-            }
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
-        }
-    }
-
-    template<uint32_t curr>
-    static constexpr decltype(auto)
-    balanced_outer() {
-        if constexpr (curr > 1) {
-            return merge<uint32_t>(balanced_create_pairs<0, 0, curr>(),
-                                   balanced_outer<curr / 2>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
         }
     }
 
-    template<uint32_t iter>
-    static constexpr decltype(auto)
-    balanced_sort_kernel() {
-        if constexpr (iter > 1) {
-            return merge<uint32_t>(balanced_outer<next_p2(n)>(),
-                                   balanced_sort_kernel<iter / 2>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    generate(pairs_t & pairs) {
+        for (uint32_t iter = next_p2(n); iter > 1; iter /= 2) {
+            for (uint32_t curr = next_p2(n); curr > 1; curr /= 2) {
+                balanced_create_pairs(pairs, curr);
+            }
         }
     }
+};
 
-    static constexpr decltype(auto)
-    balanced_sort() {
-        return balanced_sort_kernel<next_p2(n)>();
-    }
-
-    using network = decltype(balanced_sort());
+template<uint32_t n>
+struct balanced_network {
+    using network = network_builder<balanced_network_impl<n>>;
 };
 
+
 }  // namespace internal
 }  // namespace network
 }  // namespace vsort
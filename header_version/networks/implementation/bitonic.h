@@ -3,77 +3,82 @@
 
 #include <stdint.h>
 
-#include <networks/transformations.h>
-#include <util/integer_range.h>
+#include <networks/network_builder.h>
 
 namespace vsort {
 namespace network {
 namespace internal {
 template<uint32_t n>
-struct bitonic_network {
-
+struct bitonic_network_impl {
 
-    template<uint32_t lo, uint32_t s, uint32_t offset, uint32_t order>
-    static constexpr decltype(auto)
-    bitonic_create_pairs() {
-        if constexpr (s != lo) {
-            if constexpr (order) {
-                return merge<uint32_t>(
-                    std::integer_sequence<uint32_t, lo, lo + offset>{},
-                    bitonic_create_pairs<lo + 1, s, offset, order>());
+    template<typename pairs_t>
+    static constexpr void
+    bitonic_create_pairs(pairs_t & pairs,
+                         uint32_t  lo,
+                         uint32_t  s,
+                         uint32_t  offset,
+                         uint32_t  order) {
+        for (uint32_t i = lo; i < s; ++i) {
+            if (order) {
+                pairs.add(i, i + offset);
             }
             else {
-                return merge<uint32_t>(
-                    std::integer_sequence<uint32_t, lo + offset, lo>{},
-                    bitonic_create_pairs<lo + 1, s, offset, order>());
+                pairs.add(i + offset, i);
             }
         }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
-        }
     }
 
-    template<uint32_t lo, uint32_t s, uint32_t order>
-    static constexpr decltype(auto)
-    bitonic_merge() {
-        if constexpr (s > 1) {
-            constexpr uint32_t m = next_p2(s) >> 1;
-            constexpr auto     _new_pairs =
-                bitonic_create_pairs<lo, (lo + s) - (m), m, order>();
-            constexpr auto _pairs_lo = bitonic_merge<lo, m, order>();
-            constexpr auto _pairs_hi = bitonic_merge<lo + m, s - m, order>();
-            return merge<uint32_t>(_new_pairs,
-                                   merge<uint32_t>(_pairs_lo, _pairs_hi));
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    bitonic_merge(pairs_t & pairs, uint32_t lo, uint32_t s, uint32_t order) {
+        if (s > 1) {
+            const uint32_t m = next_p2(s) >> 1;
+            bitonic_create_pairs(pairs, lo, (lo + s) - (m), m, order);
+            bitonic_merge(pairs, lo, m, order);
+            bitonic_merge(pairs, lo + m, s - m, order);
         }
     }
 
-    template<uint32_t lo, uint32_t s, uint32_t order>
-    static constexpr decltype(auto)
-    bitonic_sort_kernel() {
-        if constexpr (s > 1) {
-            constexpr uint32_t m         = s >> 1;
-            constexpr auto     _pairs_lo = bitonic_sort_kernel<lo, m, !order>();
-            constexpr auto     _pairs_hi =
-                bitonic_sort_kernel<lo + m, s - m, order>();
-            return merge<uint32_t>(merge<uint32_t>(_pairs_lo, _pairs_hi),
-                                   bitonic_merge<lo, s, order>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    bitonic_sort_kernel(pairs_t & pairs,
+                        uint32_t  lo,
+                        uint32_t  s,
+                        uint32_t  order) {
+        if (s > 1) {
+            const uint32_t m = s >> 1;
+            bitonic_sort_kernel(pairs, lo, m, !order);
+            bitonic_sort_kernel(pairs, lo + m, s - m, order);
+            bitonic_merge(pairs, lo, s, order);
         }
     }
 
 
-    static constexpr decltype(auto)
-    bitonic_sort() {
-        return bitonic_sort_kernel<0, n, 1>();
+    template<typename pairs_t>
+    static constexpr void
+    generate(pairs_t & pairs) {
+        bitonic_sort_kernel(pairs, 0, n, 1);
     }
+};
 
-    using network =
-        typename transform::unidirectional<n, decltype(bitonic_sort())>::type;
+template<uint32_t n>
+struct bitonic_network {
+    using network = network_builder<bitonic_network_impl<n>, 1>;
+};
+
+// only the final merge, sorts a bitonic sequence
+template<uint32_t n>
+struct bitonic_merge_network_impl {
+    template<typename pairs_t>
+    static constexpr void
+    generate(pairs_t & pairs) {
+        bitonic_network_impl<n>::bitonic_merge(pairs, 0, n, 1);
+    }
+};
+
+template<uint32_t n>
+struct bitonic_merge_network {
+    using network = network_builder<bitonic_merge_network_impl<n>, 1>;
 };
 
 
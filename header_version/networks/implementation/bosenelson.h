@@ -7,7 +7,7 @@
 
 #include <stdint.h>
 
-#include <util/integer_range.h>
+#include <networks/network_builder.h>
 
 
 namespace vsort {
@@ -15,63 +15,64 @@ namespace network {
 namespace internal {
 
 template<uint32_t n>
-struct bosenelson_network {
-
-    template<uint32_t i, uint32_t length_i, uint32_t j, uint32_t length_j>
-    static constexpr decltype(auto)
-    bosenelson_merge() {
-        if constexpr (length_i == 1 && length_j == 1) {
-            return std::integer_sequence<uint32_t, i, j>{};
+struct bosenelson_network_impl {
+
+    template<typename pairs_t>
+    static constexpr void
+    bosenelson_merge(pairs_t & pairs,
+                     uint32_t  i,
+                     uint32_t  length_i,
+                     uint32_t  j,
+                     uint32_t  length_j) {
+        if (length_i == 1 && length_j == 1) {
+            pairs.add(i, j);
         }
-        else if constexpr (length_i == 1 && length_j == 2) {
-            return std::integer_sequence<uint32_t, i, j + 1, i, j>{};
+        else if (length_i == 1 && length_j == 2) {
+            pairs.add(i, j + 1);
+            pairs.add(i, j);
         }
-        else if constexpr (length_i == 2 && length_j == 1) {
-            return std::integer_sequence<uint32_t, i, j, i + 1, j>{};
+        else if (length_i == 2 && length_j == 1) {
+            pairs.add(i, j);
+            pairs.add(i + 1, j);
         }
         else {
-            constexpr uint32_t i_mid = length_i / 2;
-            constexpr uint32_t j_mid =
+            const uint32_t i_mid = length_i / 2;
+            const uint32_t j_mid =
                 (length_i & 0x1) ? (length_j / 2) : ((length_j + 1) / 2);
 
-            constexpr auto _pairs0 = bosenelson_merge<i, i_mid, j, j_mid>();
-            constexpr auto _pairs1 = bosenelson_merge<i + i_mid,
-                                                      length_i - i_mid,
-                                                      j + j_mid,
-                                                      length_j - j_mid>();
-            constexpr auto _pairs2 =
-                bosenelson_merge<i + i_mid, length_i - i_mid, j, j_mid>();
-            return merge<uint32_t>(merge<uint32_t>(_pairs0, _pairs1), _pairs2);
+            bosenelson_merge(pairs, i, i_mid, j, j_mid);
+            bosenelson_merge(pairs,
+                             i + i_mid,
+                             length_i - i_mid,
+                             j + j_mid,
+                             length_j - j_mid);
+            bosenelson_merge(pairs, i + i_mid, length_i - i_mid, j, j_mid);
         }
     }
 
-    template<uint32_t i, uint32_t length>
-    static constexpr decltype(auto)
-    bosenelson_split() {
-        if constexpr (length >= 2) {
-            constexpr uint32_t mid       = length >> 1;
-            constexpr auto     _pairs_lo = bosenelson_split<i, mid>();
-            constexpr auto     _pairs_hi =
-                bosenelson_split<i + mid, length - mid>();
-            return merge<uint32_t>(
-                merge<uint32_t>(_pairs_lo, _pairs_hi),
-                bosenelson_merge<i, mid, i + mid, length - mid>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    bosenelson_split(pairs_t & pairs, uint32_t i, uint32_t length) {
+        if (length >= 2) {
+            const uint32_t mid = length >> 1;
+            bosenelson_split(pairs, i, mid);
+            bosenelson_split(pairs, i + mid, length - mid);
+            bosenelson_merge(pairs, i, mid, i + mid, length - mid);
         }
     }
 
-    static constexpr decltype(auto)
-    bosenelson_sort() {
-        return bosenelson_split<0, n>();
+    template<typename pairs_t>
+    static constexpr void
+    generate(pairs_t & pairs) {
+        bosenelson_split(pairs, 0, n);
     }
+};
 
-    using network = decltype(bosenelson_sort());
-
+template<uint32_t n>
+struct bosenelson_network {
+    using network = network_builder<bosenelson_network_impl<n>>;
 };
 
-    
 
 }  // namespace internal
 }  // namespace network
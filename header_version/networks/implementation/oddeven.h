@@ -3,76 +3,63 @@
 
 #include <stdint.h>
 
-#include <util/integer_range.h>
+#include <networks/network_builder.h>
 
 namespace vsort {
 namespace network {
 namespace internal {
 
 template<uint32_t n>
-struct oddeven_network {
+struct oddeven_network_impl {
 
-    template<uint32_t i, uint32_t j>
-    static constexpr decltype(auto)
-    oddeven_create_pair() {
-        if constexpr (i < n && j < n) {
-            return std::integer_sequence<uint32_t, i, j>{};
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
-        }
-    }
-
-    template<uint32_t i, uint32_t lo, uint32_t s, uint32_t r, uint32_t m>
-    static constexpr decltype(auto)
-    oddeven_create_pairs() {
-        if constexpr ((i + r) < (lo + s)) {
-            return merge<uint32_t>(oddeven_create_pair<i, i + r>(),
-                            oddeven_create_pairs<i + m, lo, s, r, m>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    oddeven_create_pair(pairs_t & pairs, uint32_t i, uint32_t j) {
+        if (i < n && j < n) {
+            pairs.add(i, j);
         }
     }
 
-    template<uint32_t lo, uint32_t s, uint32_t r>
-    static constexpr decltype(auto)
-    oddeven_merge() {
-        constexpr uint32_t m = 2 * r;
-        if constexpr (m < s) {
-            auto constexpr _pairs_lo = oddeven_merge<lo, s, m>();
-            auto constexpr _pairs_hi = oddeven_merge<lo + r, s, m>();
-            return merge<uint32_t>(merge<uint32_t>(_pairs_lo, _pairs_hi),
-                                   oddeven_create_pairs<lo + r, lo, s, r, m>());
+    template<typename pairs_t>
+    static constexpr void
+    oddeven_merge(pairs_t & pairs, uint32_t lo, uint32_t s, uint32_t r) {
+        const uint32_t m = 2 * r;
+        if (m < s) {
+            oddeven_merge(pairs, lo, s, m);
+            oddeven_merge(pairs, lo + r, s, m);
+            for (uint32_t i = lo + r; (i + r) < (lo + s); i += m) {
+                oddeven_create_pair(pairs, i, i + r);
+            }
         }
         else {
-            return oddeven_create_pair<lo, lo + r>();
+            oddeven_create_pair(pairs, lo, lo + r);
         }
     }
 
-    template<uint32_t lo, uint32_t s>
-    static constexpr decltype(auto)
-    oddeven_sort_kernel() {
-        if constexpr (s > 1) {
-            constexpr uint32_t m         = s / 2;
-            constexpr auto     _pairs_lo = oddeven_sort_kernel<lo, m>();
-            constexpr auto     _pairs_hi = oddeven_sort_kernel<lo + m, m>();
-            return merge<uint32_t>(merge<uint32_t>(_pairs_lo, _pairs_hi),
-                                   oddeven_merge<lo, s, 1>());
-        }
-        else {
-            return std::make_integer_sequence<uint32_t, 0>{};
+    template<typename pairs_t>
+    static constexpr void
+    oddeven_sort_kernel(pairs_t & pairs, uint32_t lo, uint32_t s) {
+        if (s > 1) {
+            const uint32_t m = s / 2;
+            oddeven_sort_kernel(pairs, lo, m);
+            oddeven_sort_kernel(pairs, lo + m, m);
+            oddeven_merge(pairs, lo, s, 1);
         }
     }
 
-    static constexpr decltype(auto)
-    oddeven_sort() {
-        return oddeven_sort_kernel<0, next_p2(n)>();
+    template<typename pairs_t>
+    static constexpr void
+    generate(pairs_t & pairs) {
+        oddeven_sort_kernel(pairs, 0, next_p2(n));
     }
+};
 
-    using network = decltype(oddeven_sort());
+template<uint32_t n>
+struct oddeven_network {
+    using network = network_builder<oddeven_network_impl<n>>;
 };
 
+
 }  // namespace internal
 }  // namespace network
 }  // namespace vsort
@@ -0,0 +1,78 @@
+#ifndef _NETWORK_BUILDER_H_
+#define _NETWORK_BUILDER_H_
+
+#include <stdint.h>
+#include <utility>
+
+#include <networks/transformations.h>
+
+namespace vsort {
+namespace network {
+namespace internal {
+
+// Networks are generated by constexpr functions writing comparison pairs
+// into a pairs_t. They are run twice, once with network_pairs_counter to
+// get the size and once with network_pairs<size> to get the pairs, and
+// only then expanded into a std::integer_sequence. This is much cheaper
+// to compile than building the sequence with recursive merge<uint32_t>.
+struct network_pairs_counter {
+    constexpr network_pairs_counter() : size() {}
+
+    constexpr void
+    add(uint32_t x, uint32_t y) {
+        size += 2;
+    }
+
+    uint32_t size;
+};
+
+template<uint32_t capacity>
+struct network_pairs {
+    constexpr network_pairs() : arr(), size() {}
+
+    constexpr void
+    add(uint32_t x, uint32_t y) {
+        arr[size]     = x;
+        arr[size + 1] = y;
+        size += 2;
+    }
+
+    uint32_t arr[capacity];
+    uint32_t size;
+};
+
+// network_impl must have:
+//     template<typename pairs_t>
+//     static constexpr void generate(pairs_t & pairs);
+template<typename network_impl, uint32_t unidirectional = 0>
+struct network_builder {
+    static constexpr uint32_t
+    get_size() {
+        network_pairs_counter counter = network_pairs_counter();
+        network_impl::generate(counter);
+        return counter.size;
+    }
+
+    static constexpr uint32_t size = get_size();
+
+    // size 0 arrays are not allowed, only size elements are expanded
+    using pairs_t = network_pairs<size ? size : 1>;
+
+    static constexpr pairs_t
+    build() {
+        pairs_t pairs = pairs_t();
+        network_impl::generate(pairs);
+        if constexpr (unidirectional) {
+            transform::internal::make_unidirectional(pairs.arr, size);
+        }
+        return pairs;
+    }
+
+    static constexpr pairs_t pairs = build();
+};
+
+}  // namespace internal
+}  // namespace network
+}  // namespace vsort
+
+#endif
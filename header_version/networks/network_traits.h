@@ -0,0 +1,109 @@
+#ifndef _NETWORK_TRAITS_H_
+#define _NETWORK_TRAITS_H_
+
+#include <stdint.h>
+#include <utility>
+
+#include <util/constexpr_util.h>
+
+namespace vsort {
+namespace network {
+namespace internal {
+
+// Metadata for a network after transform::group and
+// transform::permutation. Every group of rounded_n indexes is one
+// compare_exchange stage where position i holds the partner of element
+// (rounded_n - 1) - i. Every stage holds each of [0, rounded_n) exactly
+// once so rounded_n is just the largest index + 1.
+template<uint32_t ele_size, uint32_t... e>
+struct network_traits_impl {
+    static constexpr uint32_t size = sizeof...(e);
+    static_assert(size != 0);
+
+    // 16 byte lanes, any vector that fits in an xmm register is in lane
+    static constexpr uint32_t lane_bytes = 16;
+
+    constexpr network_traits_impl()
+        : rounded_n(), depth(), comparators(), lane_crossing_stages() {
+        constexpr uint32_t perms[size] = { static_cast<uint32_t>(e)... };
+
+        for (uint32_t i = 0; i < size; ++i) {
+            if (perms[i] >= rounded_n) {
+                rounded_n = perms[i] + 1;
+            }
+        }
+        depth = size / rounded_n;
+
+        for (uint32_t i = 0; i < depth; ++i) {
+            uint32_t crosses_lane = 0;
+            for (uint32_t j = 0; j < rounded_n; ++j) {
+                const uint32_t ele     = (rounded_n - 1) - j;
+                const uint32_t partner = perms[i * rounded_n + j];
+                if (partner > ele) {
+                    ++comparators;
+                }
+                if ((ele * ele_size) / lane_bytes !=
+                    (partner * ele_size) / lane_bytes) {
+                    crosses_lane = 1;
+                }
+            }
+            lane_crossing_stages += crosses_lane;
+        }
+    }
+
+    uint32_t rounded_n;
+    uint32_t depth;
+    uint32_t comparators;
+    uint32_t lane_crossing_stages;
+};
+
+}  // namespace internal
+}  // namespace network
+
+
+template<typename network>
+struct network_traits;
+
+// network is the type of a network alias, i.e vsort::bitonic<n>. Lane
+// dependent values are templated on the element type being sorted.
+template<uint32_t... e>
+struct network_traits<std::integer_sequence<uint32_t, e...>> {
+    using impl = network::internal::network_traits_impl<1, e...>;
+
+    template<typename T>
+    using typed_impl =
+        network::internal::network_traits_impl<sizeof(T), e...>;
+
+    // size of the vector the network is applied to (next_p2(n))
+    static constexpr uint32_t rounded_n = impl().rounded_n;
+
+    // number of compare_exchange stages
+    static constexpr uint32_t depth = impl().depth;
+
+    // number of min/max pairs across all stages
+    static constexpr uint32_t comparators = impl().comparators;
+
+    // stages whose permutation moves an element across a 16 byte lane
+    template<typename T>
+    static constexpr uint32_t lane_crossing_permutes =
+        typed_impl<T>().lane_crossing_stages;
+
+    // stages whose permutation stays within 16 byte lanes
+    template<typename T>
+    static constexpr uint32_t in_lane_permutes =
+        depth - lane_crossing_permutes<T>;
+
+    // Rough instruction count for vop::compare_exchange over the whole
+    // network with AVX2: each stage is a permute, min, max and blend. 1
+    // and 2 byte lane crossing permutes have no single AVX2 instruction
+    // and take permute4x64 + 2x shuffle_epi8 + or. Loads, stores and
+    // constant materialization are not counted.
+    template<typename T>
+    static constexpr uint32_t estimated_instructions =
+        3 * depth + in_lane_permutes<T> +
+        (sizeof(T) < sizeof(uint32_t) ? 4 : 1) * lane_crossing_permutes<T>;
+};
+
+}  // namespace vsort
+
+#endif
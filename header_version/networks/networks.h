@@ -7,6 +7,7 @@
 #include <networks/implementation/bosenelson.h>
 #include <networks/implementation/minimum.h>
 #include <networks/implementation/oddeven.h>
+#include <networks/network_traits.h>
 #include <networks/transformations.h>
 
 namespace vsort {
@@ -66,6 +67,21 @@ static_assert(std::is_same<bitonic<8>,
                                                  0,
                                                  1>>::value);
 
+static_assert(network_traits<bitonic<8>>::rounded_n == 8);
+static_assert(network_traits<bitonic<8>>::depth == 6);
+static_assert(network_traits<bitonic<8>>::comparators == 24);
+static_assert(network_traits<bitonic<8>>::lane_crossing_permutes<uint32_t> ==
+              1);
+static_assert(network_traits<bitonic<8>>::lane_crossing_permutes<uint8_t> ==
+              0);
+
+
+// merges a bitonic sequence of n (power of 2) elements, used to merge
+// sorted registers
+template<uint32_t n>
+using bitonic_merge = typename transform::
+    build<n, typename network::internal::bitonic_merge_network<n>::network>::
+        type;
 
 template<uint32_t n>
 using bosenelson = typename transform::
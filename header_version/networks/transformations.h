@@ -7,14 +7,16 @@ namespace vsort {
 namespace transform {
 namespace internal {
 
+// All transforms work on constexpr arrays. A network is only expanded back
+// into a std::integer_sequence once all transforms have been applied.
 
-template<uint32_t n, uint32_t size, uint32_t... pairs>
+template<uint32_t n, uint32_t size>
 struct permutation_transform_impl {
     static constexpr uint32_t rounded_n = next_p2(n);
     static constexpr uint32_t ngroups   = size / rounded_n;
-    constexpr permutation_transform_impl() : arr() {
-        constexpr uint32_t _pairs[size] = { static_cast<uint32_t>(pairs)... };
-
+    constexpr permutation_transform_impl(const uint32_t * _pairs,
+                                         uint32_t         in_size)
+        : arr() {
         static_assert(ngroups * rounded_n == size);
         for (uint32_t i = 0; i < ngroups; ++i) {
             for (uint32_t j = 0; j < rounded_n; ++j) {
@@ -25,7 +27,7 @@ struct permutation_transform_impl {
         uint64_t current_group = 0;
         uint32_t idx           = 0;
         for (uint32_t i = 0; i < ngroups; ++i) {
-            while (idx < size) {
+            while (idx < in_size) {
                 if ((current_group & ((1UL) << _pairs[idx])) ||
                     (current_group & ((1UL) << _pairs[idx + 1]))) {
                     current_group = 0;
@@ -47,17 +49,16 @@ struct permutation_transform_impl {
 };
 
 
-template<uint32_t n, uint32_t size, uint32_t... pairs>
+template<uint32_t n, uint32_t size>
 struct group_transform_impl {
 
-    constexpr group_transform_impl() : arr(), size_out() {
-        constexpr uint32_t _pairs[size] = { static_cast<uint32_t>(pairs)... };
-
-        uint32_t ngroups                    = 0;
+    constexpr group_transform_impl(const uint32_t * _pairs, uint32_t in_size)
+        : arr(), size_out() {
+        uint32_t ngroups                       = 0;
         uint32_t group_indexes[2 * next_p2(n)] = { 0 };
-        uint32_t tmp_arr[next_p2(n) * (n + 1)]       = { 0 };
+        uint32_t tmp_arr[next_p2(n) * (n + 1)] = { 0 };
 
-        for (uint32_t i = 0; i < size; i += 2) {
+        for (uint32_t i = 0; i < in_size; i += 2) {
             const uint32_t x_i = _pairs[i];
             const uint32_t y_i = _pairs[i + 1];
 
@@ -98,46 +99,48 @@ struct group_transform_impl {
     uint32_t arr[size];
 };
 
-template<uint32_t n, uint32_t... pairs>
-static constexpr uint32_t
-get_network_size(std::integer_sequence<uint32_t, pairs...> _pairs) {
-    group_transform_impl<n, get_size<uint32_t>(_pairs), pairs...> grouper =
-        group_transform_impl<n, get_size<uint32_t>(_pairs), pairs...>();
-    return grouper.size_out;
+// Orders every pair so that the min ends up at the lower index, renaming
+// wires in the following pairs to match.
+constexpr void
+make_unidirectional(uint32_t * arr, uint32_t size) {
+    for (uint32_t i = 0; i < size; i += 2) {
+
+        const uint32_t x_i = arr[i];
+        const uint32_t y_i = arr[i + 1];
+        if (x_i > y_i) {
+            for (uint32_t j = i + 2; j < size; j += 2) {
+                const uint32_t x_j = arr[j];
+                const uint32_t y_j = arr[j + 1];
+
+                if (x_i == x_j) {
+                    arr[j] = y_i;
+                }
+                if (x_i == y_j) {
+                    arr[j + 1] = y_i;
+                }
+                if (y_i == x_j) {
+                    arr[j] = x_i;
+                }
+                if (y_i == y_j) {
+                    arr[j + 1] = x_i;
+                }
+            }
+            arr[i]     = y_i;
+            arr[i + 1] = x_i;
+        }
+    }
 }
 
-template<uint32_t n, uint32_t size, uint32_t... pairs>
+template<uint32_t n, uint32_t size>
 struct unidirectional_transform_impl {
 
-    constexpr unidirectional_transform_impl()
-        : arr({ static_cast<uint32_t>(pairs)... }) {
-
-        for (uint32_t i = 0; i < size; i += 2) {
-
-            const uint32_t x_i = arr[i];
-            const uint32_t y_i = arr[i + 1];
-            if (x_i > y_i) {
-                for (uint32_t j = i + 2; j < size; j += 2) {
-                    const uint32_t x_j = arr[j];
-                    const uint32_t y_j = arr[j + 1];
-
-                    if (x_i == x_j) {
-                        arr[j] = y_i;
-                    }
-                    if (x_i == y_j) {
-                        arr[j + 1] = y_i;
-                    }
-                    if (y_i == x_j) {
-                        arr[j] = x_i;
-                    }
-                    if (y_i == y_j) {
-                        arr[j + 1] = x_i;
-                    }
-                }
-                arr[i]     = y_i;
-                arr[i + 1] = x_i;
-            }
+    constexpr unidirectional_transform_impl(const uint32_t * _pairs,
+                                            uint32_t         in_size)
+        : arr() {
+        for (uint32_t i = 0; i < in_size; ++i) {
+            arr[i] = _pairs[i];
         }
+        make_unidirectional(arr, in_size);
     }
     uint32_t arr[size];
 };
@@ -145,7 +148,7 @@ struct unidirectional_transform_impl {
 
 template<uint32_t n,
          uint32_t size,
-         template<uint32_t _n, uint32_t _size, uint32_t... pairs>
+         template<uint32_t _n, uint32_t _size>
          typename transform_impl>
 struct transformer {
 
@@ -159,9 +162,10 @@ struct transformer {
     static constexpr decltype(auto)
     transform_kernel(std::integer_sequence<uint32_t, pairs...> _pairs,
                      std::integer_sequence<uint32_t, seq...>   _seq) {
+        constexpr uint32_t in_arr[sizeof...(pairs)] = { pairs... };
 
-        constexpr transform_impl<n, size, pairs...> _transform =
-            transform_impl<n, size, pairs...>();
+        constexpr transform_impl<n, size> _transform =
+            transform_impl<n, size>(in_arr, sizeof...(pairs));
         return return_transform<_transform.arr[seq]...>();
     }
 
@@ -174,6 +178,44 @@ struct transformer {
     }
 };
 
+// Array view of a network. Networks from network_builder already carry
+// their pairs as a constexpr array, hand written ones (minimum) are
+// std::integer_sequence and are copied into one.
+template<typename network>
+struct network_array {
+    static constexpr uint32_t         size = network::size;
+    static constexpr const uint32_t * arr  = network::pairs.arr;
+};
+
+template<uint32_t... pairs>
+struct network_array<std::integer_sequence<uint32_t, pairs...>> {
+    static constexpr uint32_t size                = sizeof...(pairs);
+    static constexpr uint32_t arr[size ? size : 1] = { pairs... };
+};
+
+// group + permutation in one pass. The grouped network is kept as a
+// constexpr array so the pack is only expanded for the final result.
+template<uint32_t n, typename network>
+struct build_impl {
+    using in_t = network_array<network>;
+
+    static constexpr group_transform_impl<n, in_t::size> grouped =
+        group_transform_impl<n, in_t::size>(in_t::arr, in_t::size);
+
+    static constexpr uint32_t size_out = grouped.size_out;
+
+    static constexpr permutation_transform_impl<n, size_out> permuted =
+        permutation_transform_impl<n, size_out>(grouped.arr, in_t::size);
+
+    template<uint32_t... seq>
+    static constexpr decltype(auto)
+    expand(std::integer_sequence<uint32_t, seq...> _seq) {
+        return std::integer_sequence<uint32_t, permuted.arr[seq]...>{};
+    }
+
+    using type =
+        decltype(expand(std::make_integer_sequence<uint32_t, size_out>{}));
+};
 
 }  // namespace internal
 
@@ -207,10 +249,7 @@ struct unidirectional {
 
 template<uint32_t n, typename network>
 struct build {
-    using type =
-        typename permutation<n,
-                             typename group<n, network>::type,
-                             internal::get_network_size<n>(network{})>::type;
+    using type = typename internal::build_impl<n, network>::type;
 };
 
 }  // namespace transform
@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+#include <vec_sort/vec_sort.h>
+
+// Correctness test for BIAS_MIN_MAX_BLEND uint64_t sorts (xmm and ymm
+// registers) on every simd tier the target supports.
+//     g++ -O2 -std=c++17 -march=x86-64 -I.. bias_unsigned.cc
+//     g++ -O2 -std=c++17 -march=x86-64-v2 -I.. bias_unsigned.cc
+//     g++ -O2 -std=c++17 -march=sandybridge -I.. bias_unsigned.cc
+//     g++ -O2 -std=c++17 -march=native -I.. bias_unsigned.cc
+//
+// Keys have random sign bits, the sorted output must match std::sort
+// (unsigned order) and nothing past n may be written.
+
+static std::mt19937_64 rng(1);
+static int             failed = 0;
+
+template<vsort::simd_instructions simd_set, uint32_t n>
+void
+test_n() {
+    constexpr uint32_t guard = 8;
+    for (uint32_t iter = 0; iter < 1000; ++iter) {
+        uint64_t arr[n + guard];
+        uint64_t expec[n + guard];
+        for (uint32_t i = 0; i < n + guard; ++i) {
+            // small ranges too so duplicates and 0 / UINT64_MAX show up
+            arr[i] = (iter & 1) ? rng() : (rng() % 4) * ((1UL << 63) - 1);
+        }
+        memcpy(expec, arr, sizeof(arr));
+        std::sort(expec, expec + n);
+
+        vsort::sortu<uint64_t,
+                     n,
+                     vsort::bitonic,
+                     simd_set,
+                     vsort::vop::builtin_perm_default,
+                     vsort::BIAS_MIN_MAX_BLEND>(arr);
+        if (memcmp(arr, expec, sizeof(arr))) {
+            fprintf(stderr, "Failed: simd=%d, n=%u\n", simd_set, n);
+            failed = 1;
+            return;
+        }
+    }
+}
+
+template<vsort::simd_instructions simd_set>
+void
+test_simd() {
+    test_n<simd_set, 2>();
+    test_n<simd_set, 3>();
+    test_n<simd_set, 4>();
+}
+
+int
+main() {
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512BW__)
+    test_simd<vsort::AVX512>();
+#endif
+#ifdef __AVX2__
+    test_simd<vsort::AVX2>();
+#endif
+#ifdef __AVX__
+    test_simd<vsort::AVX>();
+#endif
+#ifdef __SSE4_1__
+    test_simd<vsort::SSE4_1>();
+#endif
+    test_simd<vsort::SSE2>();
+
+    fprintf(stderr, failed ? "Failed\n" : "Passed\n");
+    return failed;
+}
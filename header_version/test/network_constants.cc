@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+
+#include <vec_sort/vec_sort.h>
+
+// Test for the per network control vector tables (network_constants).
+//     g++ -O2 -std=c++17 -march=haswell -I.. network_constants.cc
+//     g++ -O2 -std=c++17 -march=native -I.. network_constants.cc
+//
+// Building it is most of the test: every control vector a stage loads
+// has to be in its network's table, otherwise control_offset
+// static_asserts. So it instantiates every element type, register size,
+// builtin_usage and cmp_exchange_usage with the bitonic / oddeven / best
+// networks on every simd tier the target has. The sorts are checked
+// against std::sort too.
+
+static std::mt19937_64 rng(1);
+static int             failed = 0;
+
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network,
+         vsort::simd_instructions  simd_set,
+         vsort::builtin_usage      builtin_perm,
+         vsort::cmp_exchange_usage cmp_exchange>
+void
+test_one() {
+    for (uint32_t iter = 0; iter < 100 && !failed; ++iter) {
+        T arr[n];
+        T expec[n];
+        for (uint32_t i = 0; i < n; ++i) {
+            arr[i] = static_cast<T>(rng());
+        }
+        memcpy(expec, arr, sizeof(arr));
+        std::sort(expec, expec + n);
+
+        vsort::sortu<T, n, network, simd_set, builtin_perm, cmp_exchange>(
+            arr);
+        if (memcmp(arr, expec, sizeof(arr))) {
+            fprintf(stderr,
+                    "Failed: sizeof(T)=%zu, n=%u, simd=%d, builtin=%d, "
+                    "cmp_exchange=%d\n",
+                    sizeof(T),
+                    n,
+                    simd_set,
+                    builtin_perm,
+                    cmp_exchange);
+            failed = 1;
+        }
+    }
+}
+
+template<typename T,
+         uint32_t                 n,
+         vsort::simd_instructions simd_set,
+         vsort::builtin_usage     builtin_perm>
+void
+test_networks() {
+    constexpr vsort::cmp_exchange_usage blend = vsort::MIN_MAX_BLEND;
+    constexpr vsort::cmp_exchange_usage mask  = vsort::MASK_MIN_MAX;
+
+    test_one<T, n, vsort::bitonic, simd_set, builtin_perm, blend>();
+    test_one<T, n, vsort::oddeven, simd_set, builtin_perm, blend>();
+    test_one<T, n, vsort::best, simd_set, builtin_perm, blend>();
+    test_one<T, n, vsort::best, simd_set, builtin_perm, mask>();
+}
+
+// full xmm / ymm / zmm registers and one that isn't a power of 2
+template<typename T, vsort::simd_instructions simd_set>
+void
+test_type() {
+    constexpr uint32_t xmm_n = sizeof(__m128i) / sizeof(T);
+    constexpr uint32_t ymm_n = sizeof(__m256i) / sizeof(T);
+    constexpr uint32_t zmm_n = sizeof(__m512i) / sizeof(T);
+
+    test_networks<T, xmm_n, simd_set, vsort::BUILTIN_FALLBACK>();
+    test_networks<T, xmm_n, simd_set, vsort::BUILTIN_NONE>();
+    test_networks<T, ymm_n, simd_set, vsort::BUILTIN_FIRST>();
+    test_networks<T, ymm_n, simd_set, vsort::BUILTIN_FALLBACK>();
+    test_networks<T, ymm_n, simd_set, vsort::BUILTIN_NONE>();
+    test_networks<T, ymm_n - 1, simd_set, vsort::BUILTIN_NONE>();
+    if constexpr (simd_set >= vsort::AVX512) {
+        test_networks<T, zmm_n, simd_set, vsort::BUILTIN_FALLBACK>();
+        test_networks<T, zmm_n, simd_set, vsort::BUILTIN_NONE>();
+    }
+}
+
+template<vsort::simd_instructions simd_set>
+void
+test_simd() {
+    test_type<uint8_t, simd_set>();
+    test_type<int8_t, simd_set>();
+    test_type<uint16_t, simd_set>();
+    test_type<int16_t, simd_set>();
+    test_type<uint32_t, simd_set>();
+    test_type<int32_t, simd_set>();
+    test_type<uint64_t, simd_set>();
+    test_type<int64_t, simd_set>();
+}
+
+int
+main() {
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512BW__)
+    test_simd<vsort::AVX512>();
+    test_simd<vsort::AVX512_YMM>();
+#endif
+#ifdef __AVX2__
+    test_simd<vsort::AVX2>();
+#endif
+#ifdef __SSE4_1__
+    test_simd<vsort::SSE4_1>();
+#endif
+
+    fprintf(stderr, failed ? "Failed\n" : "Passed\n");
+    return failed;
+}
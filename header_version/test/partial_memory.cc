@@ -0,0 +1,164 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <random>
+
+#include <vec_sort/vec_sort.h>
+
+// Correctness test for partial loads / stores (partial_memory_ops).
+//     g++ -O2 -std=c++17 -march=native -I.. partial_memory.cc
+//
+// Every partial_n of every register size is loaded / stored with arr
+// placed right after and right before an inaccessible page, so reading
+// before arr or past arr + partial_n faults. Loaded lanes past
+// partial_n must be get_max<T>() and stores must not write past
+// partial_n. This includes partial_n < 4 / sizeof(T) (no whole 4 byte
+// word in the array).
+
+static std::mt19937_64 rng(1);
+static int             failed = 0;
+
+// [guard page][page][guard page]
+static uint8_t * page_begin;
+static uint8_t * page_end;
+
+template<typename T,
+         vsort::simd_instructions simd_set,
+         uint32_t                 vec_size,
+         uint32_t                 partial_n,
+         uint32_t                 extra_memory>
+void
+test_one(T * const arr) {
+    using vec_ops = vsort::vop::internal::
+        select_vector_ops<T, simd_set, vsort::BUILTIN_FIRST, vec_size>;
+    constexpr uint32_t n = vec_size / sizeof(T);
+
+    for (uint32_t i = 0; i < partial_n; ++i) {
+        arr[i] = static_cast<T>(rng());
+    }
+
+    auto v = vec_ops::template vec_load<partial_n, 0, extra_memory>(arr);
+    T    lanes[n];
+    memcpy(lanes, &v, vec_size);
+    for (uint32_t i = 0; i < n; ++i) {
+        const T expec = i < partial_n ? arr[i] : get_max<T>();
+        if (lanes[i] != expec) {
+            fprintf(stderr,
+                    "Load Failed: sizeof(T)=%zu, simd=%d, vec_size=%u, "
+                    "partial_n=%u, extra_memory=%u, lane=%u\n",
+                    sizeof(T),
+                    simd_set,
+                    vec_size,
+                    partial_n,
+                    extra_memory,
+                    i);
+            failed = 1;
+            return;
+        }
+    }
+
+    T src[n];
+    for (uint32_t i = 0; i < n; ++i) {
+        src[i] = static_cast<T>(rng());
+    }
+    memcpy(&v, src, vec_size);
+    vec_ops::template vec_store<partial_n, 0, extra_memory>(arr, v);
+    if (memcmp(arr, src, partial_n * sizeof(T))) {
+        fprintf(stderr,
+                "Store Failed: sizeof(T)=%zu, simd=%d, vec_size=%u, "
+                "partial_n=%u, extra_memory=%u\n",
+                sizeof(T),
+                simd_set,
+                vec_size,
+                partial_n,
+                extra_memory);
+        failed = 1;
+    }
+}
+
+template<typename T,
+         vsort::simd_instructions simd_set,
+         uint32_t                 vec_size,
+         uint32_t                 partial_n = 1>
+void
+test_partial_n() {
+    if constexpr (partial_n < vec_size / sizeof(T)) {
+        // starts at the page, then ends at the page end
+        T * const arr_begin = reinterpret_cast<T *>(page_begin);
+        T * const arr_end =
+            reinterpret_cast<T *>(page_end - partial_n * sizeof(T));
+
+        test_one<T, simd_set, vec_size, partial_n, vsort::NO_EXTRA_MEMORY>(
+            arr_begin);
+        test_one<T, simd_set, vec_size, partial_n, vsort::NO_EXTRA_MEMORY>(
+            arr_end);
+        test_one<T, simd_set, vec_size, partial_n, vsort::PAGE_OVERREAD>(
+            arr_begin);
+        test_one<T, simd_set, vec_size, partial_n, vsort::PAGE_OVERREAD>(
+            arr_end);
+
+        test_partial_n<T, simd_set, vec_size, partial_n + 1>();
+    }
+}
+
+template<typename T, vsort::simd_instructions simd_set>
+void
+test_type() {
+    test_partial_n<T, simd_set, sizeof(__m128i)>();
+    if constexpr (simd_set >= vsort::AVX) {
+        test_partial_n<T, simd_set, sizeof(__m256i)>();
+    }
+    if constexpr (simd_set >= vsort::AVX512) {
+        test_partial_n<T, simd_set, sizeof(__m512i)>();
+    }
+}
+
+template<vsort::simd_instructions simd_set>
+void
+test_simd() {
+    test_type<uint8_t, simd_set>();
+    test_type<int8_t, simd_set>();
+    test_type<uint16_t, simd_set>();
+    test_type<int16_t, simd_set>();
+    test_type<uint32_t, simd_set>();
+    test_type<int32_t, simd_set>();
+    test_type<uint64_t, simd_set>();
+    test_type<int64_t, simd_set>();
+}
+
+int
+main() {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *    mem       = static_cast<uint8_t *>(mmap(nullptr,
+                                                3 * page_size,
+                                                PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS,
+                                                -1,
+                                                0));
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    mprotect(mem, page_size, PROT_NONE);
+    mprotect(mem + 2 * page_size, page_size, PROT_NONE);
+    page_begin = mem + page_size;
+    page_end   = mem + 2 * page_size;
+
+#if defined(__AVX512F__) && defined(__AVX512VL__) && defined(__AVX512BW__)
+    test_simd<vsort::AVX512>();
+#endif
+#ifdef __AVX2__
+    test_simd<vsort::AVX2>();
+#endif
+#ifdef __AVX__
+    test_simd<vsort::AVX>();
+#endif
+    test_simd<vsort::SSE4_1>();
+    test_simd<vsort::SSE2>();
+
+    fprintf(stderr, failed ? "Failed\n" : "Passed\n");
+    return failed;
+}
@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <timing/stats.h>
+#include <timing/timers.h>
+#include <util/cpp_attributes.h>
+
+// Benchmark driver used by timing/regress.py. Built once per kernel:
+//     -DBENCH_T=uint32_t -DBENCH_N=8
+// and either the header library
+//     -DBENCH_NETWORK=bitonic -DBENCH_SIMD=AVX2
+// or a kernel generated by export.py
+//     -DBENCH_EXPORT="<path>" -DBENCH_EXPORT_FUNC=<memory sort name>
+//
+// Each trial sorts BENCH_NARRAYS independent random arrays and records
+// the mean time per sort. Output is one stats::stats_out csv row.
+//
+// Usage: ./bench [trials]
+
+#if !defined(BENCH_T) || !defined(BENCH_N)
+#error "BENCH_T and BENCH_N must be defined"
+#endif
+
+#define BENCH_STR_IMPL(X) #X
+#define BENCH_STR(X)      BENCH_STR_IMPL(X)
+
+#ifdef BENCH_EXPORT
+#include BENCH_EXPORT
+#define BENCH_KERNEL(arr) BENCH_EXPORT_FUNC(arr)
+#define BENCH_KERNEL_NAME BENCH_STR(BENCH_EXPORT_FUNC)
+#define BENCH_ISA         "export"
+#else
+#include <vec_sort/vec_sort.h>
+#define BENCH_KERNEL(arr)                                                      \
+    vsort::sortu<BENCH_T,                                                      \
+                 BENCH_N,                                                      \
+                 vsort::BENCH_NETWORK,                                         \
+                 vsort::simd_instructions::BENCH_SIMD>(arr)
+#define BENCH_KERNEL_NAME BENCH_STR(BENCH_NETWORK)
+#define BENCH_ISA         BENCH_STR(BENCH_SIMD)
+#endif
+
+#if defined(__clang__)
+#define BENCH_COMPILER                                                         \
+    "clang-" BENCH_STR(__clang_major__) "." BENCH_STR(__clang_minor__)
+#elif defined(__GNUC__)
+#define BENCH_COMPILER "gcc-" BENCH_STR(__GNUC__) "." BENCH_STR(__GNUC_MINOR__)
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+static constexpr uint32_t BENCH_NARRAYS   = 512;
+static constexpr uint32_t BENCH_STRIDE    = 64 / sizeof(BENCH_T);
+static constexpr uint32_t BENCH_WARMUP    = 16;
+static constexpr uint32_t DEFAULT_TRIALS = 2000;
+
+static BENCH_T pristine[BENCH_NARRAYS * BENCH_STRIDE] ALIGN_ATTR(64);
+static BENCH_T arrays[BENCH_NARRAYS * BENCH_STRIDE] ALIGN_ATTR(64);
+
+static void
+randomize(BENCH_T * arr, uint32_t n) {
+    uint8_t * bytes = (uint8_t *)arr;
+    for (uint32_t i = 0; i < n * sizeof(BENCH_T); ++i) {
+        bytes[i] = rand();
+    }
+}
+
+static void
+verify() {
+    for (uint32_t i = 0; i < BENCH_NARRAYS; ++i) {
+        BENCH_T * arr = arrays + i * BENCH_STRIDE;
+        for (uint32_t j = 1; j < BENCH_N; ++j) {
+            if (arr[j] < arr[j - 1]) {
+                fprintf(stderr, "Error: %s did not sort\n", BENCH_KERNEL_NAME);
+                exit(-1);
+            }
+        }
+    }
+}
+
+static double NEVER_INLINE
+run_trial() {
+    memcpy(arrays, pristine, sizeof(arrays));
+    COMPILER_BARRIER();
+
+    uint64_t start = timers::get_ns();
+    for (uint32_t i = 0; i < BENCH_NARRAYS; ++i) {
+        BENCH_KERNEL(arrays + i * BENCH_STRIDE);
+    }
+    COMPILER_BARRIER();
+    uint64_t end = timers::get_ns();
+
+    return ((double)(end - start)) / ((double)BENCH_NARRAYS);
+}
+
+int
+main(int argc, char ** argv) {
+    uint32_t trials = DEFAULT_TRIALS;
+    if (argc > 1) {
+        trials = atoi(argv[1]);
+    }
+    if (trials < 2) {
+        fprintf(stderr, "Error: need at least 2 trials\n");
+        return -1;
+    }
+
+    srand(BENCH_N);
+    randomize(pristine, BENCH_NARRAYS * BENCH_STRIDE);
+
+    run_trial();
+    verify();
+
+    for (uint32_t i = 0; i < BENCH_WARMUP; ++i) {
+        run_trial();
+    }
+
+    std::vector<double> samples;
+    samples.reserve(trials);
+    for (uint32_t i = 0; i < trials; ++i) {
+        samples.push_back(run_trial());
+    }
+
+    stats::stats_out s;
+    s.get_stats(samples, timers::time_units::NSEC);
+
+    char fields[256];
+    snprintf(fields,
+             sizeof(fields),
+             "%s,%u,%s,%s,%s",
+             BENCH_STR(BENCH_T),
+             (uint32_t)BENCH_N,
+             BENCH_KERNEL_NAME,
+             BENCH_ISA,
+             BENCH_COMPILER);
+    s.print_csv(stdout, "T,size,kernel,isa,compiler", fields);
+    return 0;
+}
@@ -0,0 +1,246 @@
+#! /usr/bin/env python3
+
+# Static throughput report for header library instantiations. Mirrors
+# export.py's "--mca" mode: each vsort::sortv<T, n, network, simd_set>
+# is compiled on its own, the assembly is extracted and run through
+# llvm-mca for each -mcpu target. Output is a CSV table so two runs
+# can be diffed during review.
+
+import argparse
+import os
+import subprocess
+import sys
+
+parser = argparse.ArgumentParser(
+    description="llvm-mca static throughput report for vsort::sortv")
+
+parser.add_argument("-T",
+                    "--type",
+                    action="store",
+                    default="uint8_t,uint16_t,uint32_t,uint64_t",
+                    help="comma separated list of sort types")
+parser.add_argument(
+    "-N",
+    action="store",
+    default="",
+    help=
+    "comma separated list of sizes, ranges as \"lo-hi\". Default is every power of 2 that fits in 64 bytes"
+)
+parser.add_argument("-a",
+                    "--network",
+                    action="store",
+                    default="best",
+                    help="comma separated list of networks")
+parser.add_argument("--simd",
+                    action="store",
+                    default="AVX2,AVX512",
+                    help="comma separated list of simd_instructions values")
+parser.add_argument("--mcpu",
+                    action="store",
+                    default="skylake-avx512,icelake-server,znver3",
+                    help="comma separated list of -mcpu targets")
+parser.add_argument("--march",
+                    action="store",
+                    default="icelake-server",
+                    help="-march used to compile the instantiations")
+parser.add_argument("--compiler",
+                    action="store",
+                    default="g++",
+                    help="compiler executable")
+parser.add_argument("--llvm-mca",
+                    action="store",
+                    default="llvm-mca",
+                    help="llvm-mca executable")
+parser.add_argument("--outfile",
+                    action="store",
+                    default="",
+                    help="set output file. default is stdout")
+
+include_dir = os.path.dirname(
+    os.path.dirname(os.path.realpath(__file__)))
+kernel_name = "mca_kernel"
+
+# -mcpu targets without AVX512, AVX512 instantiations aren't analyzed
+# for them
+no_avx512_cpus = [
+    "haswell", "broadwell", "skylake", "alderlake", "znver1", "znver2",
+    "znver3"
+]
+
+sizes = {
+    "uint8_t": 1,
+    "int8_t": 1,
+    "uint16_t": 2,
+    "int16_t": 2,
+    "uint32_t": 4,
+    "int32_t": 4,
+    "uint64_t": 8,
+    "int64_t": 8
+}
+
+
+def run(cmd, input_str):
+    try:
+        sproc = subprocess.Popen(cmd,
+                                 stdin=subprocess.PIPE,
+                                 stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE)
+        stdout_data, stderr_data = sproc.communicate(
+            input=input_str.encode(), timeout=300)
+    except OSError:
+        return None, "unable to run {}".format(cmd[0])
+    except subprocess.TimeoutExpired:
+        sproc.kill()
+        return None, "{} timed out".format(cmd[0])
+
+    if sproc.returncode != 0:
+        return None, stderr_data.decode("utf-8", "ignore").strip().split(
+            "\n")[0]
+    return stdout_data.decode("utf-8", "ignore"), ""
+
+
+def parse_list(arg):
+    return [a.strip() for a in arg.split(",") if a.strip() != ""]
+
+
+def parse_sizes(arg):
+    out = []
+    for a in parse_list(arg):
+        if "-" in a:
+            lo, hi = a.split("-")
+            out += [str(i) for i in range(int(lo), int(hi) + 1)]
+        else:
+            out.append(a)
+    return out
+
+
+def compile_instantiation(args, T, n, network, simd):
+    source = "#include <vec_sort/vec_sort.h>\n"
+    source += "extern \"C\" vsort::vop::vec_t<{0}, {1}> {2}(vsort::vop::vec_t<{0}, {1}> v) {{ return vsort::sortv<{0}, {1}, vsort::{3}, vsort::simd_instructions::{4}>(v); }}\n".format(
+        T, n, kernel_name, network, simd)
+
+    cmd = [
+        args.compiler, "-x", "c++", "-std=c++17", "-O3", "-S", "-o", "-",
+        "-w", "-fno-asynchronous-unwind-tables", "-fno-exceptions",
+        "-march=" + args.march, "-I" + include_dir, "-"
+    ]
+    asm, err = run(cmd, source)
+    if asm is None:
+        return None, err
+
+    body = []
+    in_kernel = False
+    for line in asm.split("\n"):
+        if line.startswith(kernel_name + ":"):
+            in_kernel = True
+            continue
+        if in_kernel is False:
+            continue
+        line = line.strip()
+        if line.startswith(".size") or line.startswith(".cfi_endproc"):
+            break
+        if line == "" or line.startswith(".") or line.endswith(":"):
+            continue
+        if line.startswith("ret"):
+            continue
+        body.append(line)
+    if len(body) == 0:
+        return None, "no assembly for {}".format(kernel_name)
+    return "\n".join(body) + "\n", ""
+
+
+def parse_field(mca_out, field):
+    for line in mca_out.split("\n"):
+        if line.startswith(field + ":"):
+            return float(line.split(":")[1].strip())
+    return 0.0
+
+
+def parse_pressure(mca_out):
+    lines = mca_out.split("\n")
+    names = {}
+    for i in range(0, len(lines)):
+        if lines[i].startswith("Resources:"):
+            for j in range(i + 1, len(lines)):
+                parts = lines[j].split("-", 1)
+                if len(parts) != 2 or lines[j].strip().startswith(
+                        "[") is False:
+                    break
+                names[parts[0].strip()] = parts[1].strip()
+        if lines[i].startswith("Resource pressure per iteration:"):
+            idx = lines[i + 1].split()
+            vals = lines[i + 2].split()
+            max_idx = None
+            max_val = 0.0
+            for k in range(0, min(len(idx), len(vals))):
+                if vals[k] != "-" and float(vals[k]) > max_val:
+                    max_val = float(vals[k])
+                    max_idx = idx[k]
+            if max_idx is not None:
+                return "{} ({})".format(names.get(max_idx, max_idx), max_val)
+    return "None"
+
+
+def analyze(args, asm, cpu):
+    mca_out, err = run([args.llvm_mca, "-mtriple=x86_64", "-mcpu=" + cpu],
+                       asm)
+    if mca_out is None:
+        return [err]
+    iterations = parse_field(mca_out, "Iterations")
+    return [
+        "{:.2f}".format(parse_field(mca_out, "Total Cycles") / iterations),
+        "{:.2f}".format(parse_field(mca_out, "Block RThroughput")),
+        "{:g}".format(parse_field(mca_out, "Total uOps") / iterations),
+        parse_pressure(mca_out)
+    ]
+
+
+def main():
+    args = parser.parse_args()
+
+    types = parse_list(args.type)
+    networks = parse_list(args.network)
+    simds = parse_list(args.simd)
+    cpus = parse_list(args.mcpu)
+
+    out = open(args.outfile, "w+") if args.outfile != "" else sys.stdout
+    out.write(
+        "T,n,network,simd,cpu,instructions,cycles_per_iter,block_rthroughput,uops,max_pressure\n"
+    )
+    for T in types:
+        if T not in sizes:
+            print("Error: unknown type {}".format(T), file=sys.stderr)
+            sys.exit(-1)
+
+        ns = parse_sizes(args.N)
+        if len(ns) == 0:
+            n = 4
+            while n * sizes[T] <= 64:
+                ns.append(str(n))
+                n *= 2
+
+        for n in ns:
+            if int(n) * sizes[T] > 64:
+                continue
+            for network in networks:
+                for simd in simds:
+                    if simd != "AVX512" and int(n) * sizes[T] > 32:
+                        continue
+                    asm, err = compile_instantiation(args, T, n, network,
+                                                     simd)
+                    for cpu in cpus:
+                        if simd.startswith(
+                                "AVX512") and cpu in no_avx512_cpus:
+                            continue
+                        row = [T, n, network, simd, cpu]
+                        if asm is None:
+                            row += ["0", "error: " + err]
+                        else:
+                            row += [str(len(asm.strip().split("\n")))]
+                            row += analyze(args, asm, cpu)
+                        out.write(",".join(row) + "\n")
+                        out.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,271 @@
+#! /usr/bin/env python3
+
+# Performance regression harness. Builds timing/bench_sort.cc for each
+# kernel in the requested matrix (header library instantiations and/or
+# export.py output), runs it and either saves the results as a baseline
+# or compares them against one.
+#
+# Results are keyed by T / n / kernel / isa / compiler. A kernel is
+# flagged as a regression when it is both slower by more than
+# --min-slowdown percent and the difference in means is significant
+# under Welch's t-test (using the stddev and sample count reported by
+# stats::stats_out) beyond --threshold.
+#
+# Examples:
+#     ./regress.py -T uint32_t,uint8_t -N 8,16 --save baseline.json
+#     ./regress.py -T uint32_t,uint8_t -N 8,16 --compare baseline.json
+#     ./regress.py -T uint16_t -N 16 --export "" --export "-O uop" --save b.json
+
+import argparse
+import csv
+import io
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(
+    description="Benchmark sorting kernels and compare against a baseline")
+
+parser.add_argument("-T",
+                    "--type",
+                    action="store",
+                    default="uint8_t,uint16_t,uint32_t,uint64_t",
+                    help="comma separated list of sort types")
+parser.add_argument(
+    "-N",
+    action="store",
+    default="",
+    help=
+    "comma separated list of sizes, ranges as \"lo-hi\". Default is every power of 2 that fits in 32 bytes"
+)
+parser.add_argument("-a",
+                    "--network",
+                    action="store",
+                    default="best",
+                    help="comma separated list of networks / algorithms")
+parser.add_argument(
+    "--simd",
+    action="store",
+    default="AVX2",
+    help=
+    "comma separated list of simd_instructions values for header kernels. Set to \"\" to skip header kernels"
+)
+parser.add_argument(
+    "--export",
+    action="append",
+    default=[],
+    help=
+    "extra export.py flags (may be \"\"). Each occurrence adds export.py kernels built with those flags to the matrix"
+)
+parser.add_argument("--compiler",
+                    action="store",
+                    default="g++",
+                    help="compiler executable")
+parser.add_argument("--march",
+                    action="store",
+                    default="native",
+                    help="-march used to build the benchmarks")
+parser.add_argument("--trials",
+                    action="store",
+                    default="2000",
+                    help="number of timed trials per kernel")
+parser.add_argument("--save",
+                    action="store",
+                    default="",
+                    help="write results as a baseline to this file")
+parser.add_argument("--compare",
+                    action="store",
+                    default="",
+                    help="compare results against this baseline file")
+parser.add_argument(
+    "--threshold",
+    action="store",
+    default="4.0",
+    help="Welch t statistic above which a slowdown is significant")
+parser.add_argument(
+    "--min-slowdown",
+    action="store",
+    default="3.0",
+    help="percent slowdown below which differences are ignored")
+
+timing_dir = os.path.dirname(os.path.realpath(__file__))
+include_dir = os.path.dirname(timing_dir)
+exporter = os.path.join(os.path.dirname(include_dir), "export_version",
+                        "export.py")
+
+sizes = {
+    "uint8_t": 1,
+    "int8_t": 1,
+    "uint16_t": 2,
+    "int16_t": 2,
+    "uint32_t": 4,
+    "int32_t": 4,
+    "uint64_t": 8,
+    "int64_t": 8
+}
+
+
+def parse_list(arg):
+    return [a.strip() for a in arg.split(",") if a.strip() != ""]
+
+
+def parse_sizes(arg):
+    out = []
+    for a in parse_list(arg):
+        if "-" in a:
+            lo, hi = a.split("-")
+            out += [int(i) for i in range(int(lo), int(hi) + 1)]
+        else:
+            out.append(int(a))
+    return out
+
+
+def run(cmd):
+    proc = subprocess.run(cmd,
+                          stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE,
+                          universal_newlines=True)
+    if proc.returncode != 0:
+        print("Error running: {}\n{}".format(" ".join(cmd), proc.stderr),
+              file=sys.stderr)
+        sys.exit(-1)
+    return proc.stdout
+
+
+class Kernel():
+    def __init__(self, T, n, network, simd=None, export_flags=None):
+        self.T = T
+        self.n = n
+        self.network = network
+        self.simd = simd
+        self.export_flags = export_flags
+
+    def defines(self, tmp_dir):
+        defines = ["-DBENCH_T=" + self.T, "-DBENCH_N={}".format(self.n)]
+        if self.export_flags is None:
+            return defines + [
+                "-DBENCH_NETWORK=" + self.network, "-DBENCH_SIMD=" + self.simd
+            ]
+
+        kernel = os.path.join(tmp_dir, "kernel.h")
+        cmd = [
+            sys.executable, exporter, "-T", self.T, "-N",
+            str(self.n), "-a", self.network, "--name", "bench_kernel",
+            "--no-format", "--outfile", kernel
+        ] + self.export_flags.split()
+        run(cmd)
+        return defines + [
+            "-DBENCH_EXPORT=\"{}\"".format(kernel),
+            "-DBENCH_EXPORT_FUNC=bench_kernel"
+        ]
+
+    def bench(self, args):
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            exe = os.path.join(tmp_dir, "bench")
+            cmd = [
+                args.compiler, "-O3", "-std=c++17", "-w",
+                "-march=" + args.march, "-I" + include_dir
+            ] + self.defines(tmp_dir) + [
+                os.path.join(timing_dir, "bench_sort.cc"),
+                os.path.join(timing_dir, "stats.cc"), "-o", exe
+            ]
+            run(cmd)
+            out = run([exe, args.trials])
+
+        row = list(csv.DictReader(io.StringIO(out)))[0]
+        if self.export_flags is not None:
+            row["kernel"] = self.network
+            row["isa"] = "export[{}]".format(self.export_flags.strip())
+        return row
+
+
+def key(row):
+    return "/".join(
+        [row["T"], row["size"], row["kernel"], row["isa"], row["compiler"]])
+
+
+def build_matrix(args):
+    kernels = []
+    for T in parse_list(args.type):
+        if T not in sizes:
+            print("Error: unknown type {}".format(T), file=sys.stderr)
+            sys.exit(-1)
+        ns = parse_sizes(args.N)
+        if len(ns) == 0:
+            n = 4
+            while n * sizes[T] <= 32:
+                ns.append(n)
+                n *= 2
+        for n in ns:
+            for network in parse_list(args.network):
+                for simd in parse_list(args.simd):
+                    kernels.append(Kernel(T, n, network, simd=simd))
+                for flags in args.export:
+                    kernels.append(Kernel(T, n, network, export_flags=flags))
+    return kernels
+
+
+def welch_t(new, old):
+    var = float(new["variance"]) / float(new["n"]) + float(
+        old["variance"]) / float(old["n"])
+    if var == 0:
+        return 0.0
+    return (float(new["mean"]) - float(old["mean"])) / math.sqrt(var)
+
+
+def compare(results, baseline, threshold, min_slowdown):
+    regressions = 0
+    print("{:<48} {:>10} {:>10} {:>8} {:>8}".format("kernel", "base (ns)",
+                                                    "new (ns)", "change",
+                                                    "t"))
+    for k in sorted(results.keys()):
+        if k not in baseline:
+            print("{:<48} {:>10} {:>10.3f}".format(k, "-",
+                                                   float(results[k]["mean"])))
+            continue
+        new = results[k]
+        old = baseline[k]
+        change = 100.0 * (float(new["mean"]) / float(old["mean"]) - 1.0)
+        t = welch_t(new, old)
+        status = ""
+        if t > threshold and change > min_slowdown:
+            status = "REGRESSION"
+            regressions += 1
+        elif t < -threshold and change < -min_slowdown:
+            status = "improved"
+        print("{:<48} {:>10.3f} {:>10.3f} {:>7.1f}% {:>8.2f} {}".format(
+            k, float(old["mean"]), float(new["mean"]), change, t, status))
+    return regressions
+
+
+def main():
+    args = parser.parse_args()
+
+    results = {}
+    for kernel in build_matrix(args):
+        row = kernel.bench(args)
+        results[key(row)] = row
+        print("{:<48} {:>10.3f} ns".format(key(row), float(row["mean"])),
+              file=sys.stderr,
+              flush=True)
+
+    if args.save != "":
+        with open(args.save, "w+") as f:
+            json.dump(results, f, indent=4, sort_keys=True)
+            f.write("\n")
+
+    if args.compare != "":
+        with open(args.compare) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, float(args.threshold),
+                              float(args.min_slowdown))
+        if regressions != 0:
+            print("{} regression(s) found".format(regressions))
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
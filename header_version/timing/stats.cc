@@ -1,5 +1,7 @@
 #include <timing/stats.h>
 
+#include <math.h>
+
 #include <algorithm>
 #include <numeric>
 
@@ -31,11 +33,13 @@ stddev_and_variance(double   mean,
     for (uint32_t i = 0; i < n; ++i) {
         sum += (data[i] - mean) * (data[i] - mean);
     }
+    // sample variance, these are always a sample of runs
+    double variance = sum / ((double)(n - 1));
     if (stddev_out != NULL) {
-        *stddev_out = sum / ((double)(n - 1));
+        *stddev_out = sqrt(variance);
     }
     if (variance_out != NULL) {
-        *variance_out = sum / ((double)(n));
+        *variance_out = variance;
     }
 }
 
@@ -160,7 +164,7 @@ stats_out::sorted_array_to_stats(double *           data,
     else {
         N = n;
         median =
-            (n % 2) ? (data[n / 2]) : ((data[n / 2] + data[(n / 2) + 1]) / 2);
+            (n % 2) ? (data[n / 2]) : ((data[(n / 2) - 1] + data[n / 2]) / 2);
         mean = 0.0;
         for (uint32_t i = 0; i < n; ++i) {
             mean += data[i];
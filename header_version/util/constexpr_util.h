@@ -46,7 +46,7 @@ get_max() {
         return (T)(((1UL) << (8 * sizeof(T) - 1)) - 1);
     }
     else {
-        return (T)(((1UL) << (8 * sizeof(T))) - 1);
+        return (T)(~((T)0));
     }
 }
 
@@ -58,12 +58,20 @@
 
 #define COMPILER_BARRIER()    asm volatile("" : : : "memory");
 #define COMPILER_DO_NOT_OPTIMIZE_OUT(X) asm volatile("" : : "r,m"(X) : "memory")
-
-// to prep avx instruction path
+// hides the value of a vector register from constant folding. Not
+// volatile so identical ones (same input) are still merged
+#define COMPILER_OPAQUE_VEC(X) asm("" : "+v"(X))
+#define COMPILER_OPAQUE_PTR(X) asm("" : "+r"(X))
+
+// to prep avx instruction path (wakes the upper halves of the vector
+// units before a timed AVX region). This doesn't manage AVX / SSE
+// transitions, the compiler puts a vzeroupper before returning from
+// every function using ymm / zmm registers. Sort many arrays in one
+// call (vsort::sortu_batch ...) to pay it once
 #include <immintrin.h>
 void ALWAYS_INLINE
 prep_avx() {
-    asm volatile("vpor %%xmm0, %%xmm0, %%xmm0\n\t" : : :);
+    asm volatile("vpor %%xmm0, %%xmm0, %%xmm0\n\t" : : : "xmm0");
 }
 
 #endif
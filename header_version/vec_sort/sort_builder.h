@@ -5,18 +5,47 @@
 #include <util/constexpr_util.h>
 #include <util/cpp_attributes.h>
 
+// see instructions/vector_operations.h
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
 namespace vsort {
 namespace sortgen {
 namespace internal {
 
 template<typename T,
-         uint32_t          n,
-         simd_instructions simd_set,
-         builtin_usage     builtin_perm>
+         uint32_t           n,
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange>
 struct sort_builder {
 
+    template<uint32_t... group_idx, uint32_t... perm_indexes>
+    static constexpr decltype(auto)
+    network_controls(
+        std::integer_sequence<uint32_t, group_idx...> _group_idx,
+        std::integer_sequence<uint32_t, perm_indexes...> _perm_indexes) {
+        return vop::internal::concat_controls(
+            vop::compare_exchange_controls<T,
+                                           n,
+                                           simd_set,
+                                           builtin_perm,
+                                           cmp_exchange>(
+                slice<uint32_t, n * group_idx, n *(group_idx + 1)>(
+                    _perm_indexes))...);
+    }
 
-    template<uint32_t... perm_indexes_slice>
+    // One table with the control vectors of every stage of the network
+    template<typename network>
+    using network_constants = vop::internal::network_constants<
+        sizeof(vop::vec_t<T, n>),
+        decltype(network_controls(
+            std::make_integer_sequence<uint32_t, network::size() / n>{},
+            network{}))>;
+
+    template<typename constants, uint32_t... perm_indexes_slice>
     static constexpr vop::vec_t<T, n> ALWAYS_INLINE CONST_ATTR
     call_compare_exchange(vop::vec_t<T, n> v,
                           std::integer_sequence<uint32_t, perm_indexes_slice...>
@@ -25,10 +54,15 @@ struct sort_builder {
                                      n,
                                      simd_set,
                                      builtin_perm,
+                                     cmp_exchange,
+                                     constants,
                                      perm_indexes_slice...>(v);
     }
 
-    template<uint32_t group_idx, uint32_t ngroups, uint32_t... perm_indexes>
+    template<typename constants,
+             uint32_t group_idx,
+             uint32_t ngroups,
+             uint32_t... perm_indexes>
     static constexpr vop::vec_t<T, n> ALWAYS_INLINE CONST_ATTR
     build_kernel(
         vop::vec_t<T, n>                                 v,
@@ -37,8 +71,8 @@ struct sort_builder {
             return v;
         }
         else {
-            return build_kernel<group_idx + 1, ngroups>(
-                call_compare_exchange<>(
+            return build_kernel<constants, group_idx + 1, ngroups>(
+                call_compare_exchange<constants>(
                     v,
                     slice<uint32_t, n * group_idx, n *(group_idx + 1)>(
                         _perm_indexes)),
@@ -50,8 +84,11 @@ struct sort_builder {
     static constexpr vop::vec_t<T, n> ALWAYS_INLINE CONST_ATTR
     build(vop::vec_t<T, n>                                 v,
           std::integer_sequence<uint32_t, perm_indexes...> _perm_indexes) {
+        using perm_indexes_t = std::integer_sequence<uint32_t, perm_indexes...>;
         constexpr uint32_t ngroups = (sizeof...(perm_indexes)) / n;
-        return build_kernel<0, ngroups>(v, _perm_indexes);
+        return build_kernel<network_constants<perm_indexes_t>, 0, ngroups>(
+            v,
+            _perm_indexes);
     }
 };
 
@@ -60,17 +97,23 @@ struct sort_builder {
 template<typename T,
          uint32_t n,
          typename network,
-         simd_instructions simd_set,
-         builtin_usage     builtin_perm>
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange>
 vop::vec_t<T, n> ALWAYS_INLINE CONST_ATTR
 generate_sort(vop::vec_t<T, n> v) {
-    return internal::sort_builder<T, n, simd_set, builtin_perm>::build(
-        v,
-        network{});
+    return internal::
+        sort_builder<T, n, simd_set, builtin_perm, cmp_exchange>::build(
+            v,
+            network{});
 }
 
 
 }  // namespace sortgen
 }  // namespace vsort
 
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 #endif
@@ -1,11 +1,19 @@
 #ifndef _VEC_SORT_H_
 #define _VEC_SORT_H_
 
+#include <stddef.h>
+
 #include <instructions/vector_operations.h>
 #include <networks/networks.h>
 #include <util/constexpr_util.h>
 #include <vec_sort/sort_builder.h>
 
+// see instructions/vector_operations.h
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
 namespace vsort {
 
 #define CSWAP(X, Y)                                                            \
@@ -34,33 +42,124 @@ small_sort(T * const arr) {
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 constexpr vop::vec_t<T, n> ALWAYS_INLINE CONST_ATTR
 sortv(vop::vec_t<T, n> v) {
-    return sortgen::
-        generate_sort<T, next_p2(n), network<n>, simd_set, builtin_perm>(v);
+    if constexpr (cmp_exchange == cmp_exchange_usage::BIAS_MIN_MAX_BLEND &&
+                  vop::bias_unsigned<T, n, simd_set>) {
+        // the max fill of vec_load is INT64_MAX once biased
+        return vop::vec_flip_sign<T, n>(
+            sortgen::generate_sort<int64_t,
+                                   next_p2(n),
+                                   network<n>,
+                                   simd_set,
+                                   builtin_perm,
+                                   cmp_exchange_usage::MIN_MAX_BLEND>(
+                vop::vec_flip_sign<T, n>(v)));
+    }
+    else {
+        return sortgen::
+            generate_sort<T,
+                          next_p2(n),
+                          network<n>,
+                          simd_set,
+                          builtin_perm,
+                          cmp_exchange>(v);
+    }
+}
+
+// AVX512_YMM sorts that don't fit in a ymm register. Each half is sorted
+// in a ymm register (the second with the lanes past n max filled) and
+// the two are merged
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network,
+         uint32_t           aligned,
+         uint32_t           extra_memory,
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange>
+constexpr void ALWAYS_INLINE
+sort_ymm_pair(T * const arr) {
+    constexpr uint32_t half_n = sizeof(__m256i) / sizeof(T);
+    // the lanes past n are sorted with the rest so they must be max
+    constexpr uint32_t hi_extra_memory =
+        extra_memory == extra_memory_usage::EXTRA_MEMORY
+            ? extra_memory_usage::NO_EXTRA_MEMORY
+            : extra_memory;
+
+    vop::vec_t<T, half_n> lo =
+        vop::vec_load<T, half_n, aligned, NO_EXTRA_MEMORY, simd_set>(arr);
+    vop::vec_t<T, half_n> hi = vop::vec_load_partial<T,
+                                                     half_n,
+                                                     n - half_n,
+                                                     aligned,
+                                                     hi_extra_memory,
+                                                     simd_set>(arr + half_n);
+
+    lo = sortv<T, half_n, network, simd_set, builtin_perm, cmp_exchange>(lo);
+    hi = sortv<T, half_n, network, simd_set, builtin_perm, cmp_exchange>(hi);
+
+    vop::merge_exchange<T, half_n, simd_set, builtin_perm>(lo, hi);
+    lo = sortgen::generate_sort<T,
+                                half_n,
+                                bitonic_merge<half_n>,
+                                simd_set,
+                                builtin_perm,
+                                cmp_exchange>(lo);
+    hi = sortgen::generate_sort<T,
+                                half_n,
+                                bitonic_merge<half_n>,
+                                simd_set,
+                                builtin_perm,
+                                cmp_exchange>(hi);
+
+    vop::vec_store<T, half_n, aligned, NO_EXTRA_MEMORY, simd_set>(arr, lo);
+    vop::vec_store_partial<T,
+                           half_n,
+                           n - half_n,
+                           aligned,
+                           hi_extra_memory,
+                           simd_set>(arr + half_n, hi);
 }
 
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         uint32_t          aligned,
-         uint32_t          extra_memory,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         uint32_t           aligned,
+         uint32_t           extra_memory,
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 constexpr void ALWAYS_INLINE
 sort(T * const arr) {
     if constexpr (n < 4) {
         small_sort<T, n>(arr);
     }
+    else if constexpr (simd_set == simd_instructions::AVX512_YMM &&
+                       sizeof(vop::vec_t<T, n>) > sizeof(__m256i)) {
+        sort_ymm_pair<T,
+                      n,
+                      network,
+                      aligned,
+                      extra_memory,
+                      simd_set,
+                      builtin_perm,
+                      cmp_exchange>(arr);
+    }
     else {
+        // best for n > 32 sorts the lanes past n too, which extra memory
+        // would load unfilled. PAGE_OVERREAD fills them with max
         constexpr uint32_t use_extra_memory =
-            extra_memory &&
-            (!(std::is_same<network<4>, vsort::best<4>>::value && n > 32));
+            (extra_memory == extra_memory_usage::EXTRA_MEMORY &&
+             std::is_same<network<4>, vsort::best<4>>::value && n > 32)
+                ? extra_memory_usage::NO_EXTRA_MEMORY
+                : extra_memory;
         vop::vec_t<T, n> v =
             vop::vec_load<T, n, aligned, use_extra_memory, simd_set>(arr);
-        v = sortv<T, n, network, simd_set, builtin_perm>(v);
+        v = sortv<T, n, network, simd_set, builtin_perm, cmp_exchange>(v);
         vop::vec_store<T, n, aligned, use_extra_memory, simd_set>(arr, v);
     }
 }
@@ -68,43 +167,151 @@ sort(T * const arr) {
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 void
 sortu(T * const arr) {
-    sort<T, n, network, 1, 0, simd_set, builtin_perm>(arr);
+    sort<T, n, network, 0, 0, simd_set, builtin_perm, cmp_exchange>(arr);
 }
 
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 void
 sorta(T * const arr) {
-    sort<T, n, network, 1, 0, simd_set, builtin_perm>(arr);
+    sort<T, n, network, 1, 0, simd_set, builtin_perm, cmp_exchange>(arr);
 }
 
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 void
 sortue(T * const arr) {
-    sort<T, n, network, 1, 1, simd_set, builtin_perm>(arr);
+    sort<T, n, network, 0, 1, simd_set, builtin_perm, cmp_exchange>(arr);
 }
 
 template<typename T,
          uint32_t n,
          template<uint32_t _n> typename network = vsort::best,
-         simd_instructions simd_set     = vop::simd_instructions_default,
-         builtin_usage     builtin_perm = vop::builtin_perm_default>
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
 void
 sortae(T * const arr) {
-    sort<T, n, network, 1, 1, simd_set, builtin_perm>(arr);
+    sort<T, n, network, 1, 1, simd_set, builtin_perm, cmp_exchange>(arr);
+}
+
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network = vsort::best,
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
+void
+sortup(T * const arr) {
+    sort<T,
+         n,
+         network,
+         0,
+         extra_memory_usage::PAGE_OVERREAD,
+         simd_set,
+         builtin_perm,
+         cmp_exchange>(arr);
+}
+
+
+// Sorts count arrays of n, stride elements apart, in one call. The
+// network's constants are loaded and the vzeroupper the compiler puts
+// before returning from AVX code runs once per batch instead of once
+// per array. Arrays two ahead are prefetched.
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network,
+         uint32_t           aligned,
+         uint32_t           extra_memory,
+         simd_instructions  simd_set,
+         builtin_usage      builtin_perm,
+         cmp_exchange_usage cmp_exchange>
+constexpr void ALWAYS_INLINE
+sort_batch(T * const base, size_t count, size_t stride) {
+    for (size_t i = 0; i < count; ++i) {
+        PREFETCH_STD(base + (i + 2) * stride);
+        sort<T,
+             n,
+             network,
+             aligned,
+             extra_memory,
+             simd_set,
+             builtin_perm,
+             cmp_exchange>(base + i * stride);
+    }
+}
+
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network = vsort::best,
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
+void
+sortu_batch(T * const base, size_t count, size_t stride) {
+    sort_batch<T,
+               n,
+               network,
+               0,
+               0,
+               simd_set,
+               builtin_perm,
+               cmp_exchange>(base, count, stride);
+}
+
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network = vsort::best,
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
+void
+sorta_batch(T * const base, size_t count, size_t stride) {
+    sort_batch<T,
+               n,
+               network,
+               1,
+               0,
+               simd_set,
+               builtin_perm,
+               cmp_exchange>(base, count, stride);
+}
+
+template<typename T,
+         uint32_t n,
+         template<uint32_t _n> typename network = vsort::best,
+         simd_instructions  simd_set     = vop::simd_instructions_default,
+         builtin_usage      builtin_perm = vop::builtin_perm_default,
+         cmp_exchange_usage cmp_exchange = vop::cmp_exchange_default>
+void
+sortup_batch(T * const base, size_t count, size_t stride) {
+    sort_batch<T,
+               n,
+               network,
+               0,
+               extra_memory_usage::PAGE_OVERREAD,
+               simd_set,
+               builtin_perm,
+               cmp_exchange>(base, count, stride);
 }
 
 }  // namespace vsort
 
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
 #endif